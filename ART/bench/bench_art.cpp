@@ -20,6 +20,8 @@ static int kRunALM = 1;
 static int kRunEmail = 0;
 static int kRunWiki = 0;
 static int kRunUrl = 0;
+// keep short keys in ART leaves, for raw and compressed keys alike
+static bool kInlineLeafKeys = false;
 
 static const std::string file_load_email = "workloads/load_email";
 static const std::string file_load_wiki = "workloads/load_wiki";
@@ -128,8 +130,7 @@ void loadKeysFromFile(const std::string &file_name, const uint64_t num_records,
   std::ifstream infile(file_name);
   std::string key;
   uint64_t count = 0;
-  while (count < num_records && infile.good()) {
-    infile >> key;
+  while (count < num_records && infile >> key) {
     keys.push_back(key);
     count++;
   }
@@ -139,8 +140,7 @@ void loadLensInt(const std::string &file_name, const uint64_t num_records, std::
   std::ifstream infile(file_name);
   int key;
   uint64_t count = 0;
-  while (count < num_records && infile.good()) {
-    infile >> key;
+  while (count < num_records && infile >> key) {
     keys.push_back(key);
     count++;
   }
@@ -241,7 +241,7 @@ void exec(const int expt_id, const int wkld_id, const bool is_point, const bool
     enc_insert_keys.push_back(std::make_pair(insert_keys[i], encode_str));
   }
 
-  ART_ROWEX::Tree *art = new ART_ROWEX::Tree(loadKey);
+  ART_ROWEX::Tree *art = new ART_ROWEX::Tree(loadKey, kInlineLeafKeys);
   auto t = art->getThreadInfo();
   double insert_start_time = getNow();
   std::string enc_insert_str;
@@ -260,6 +260,25 @@ void exec(const int expt_id, const int wkld_id, const bool is_point, const bool
   double insert_time = end_time - insert_start_time;
   std::cout << "Build time = " << bt << std::endl;
 
+  // bulk load the same keys, sorted, into a second tree
+  std::vector<TID> sorted_tids;
+  for (int i = 0; i < (int)enc_insert_keys.size(); i++) sorted_tids.push_back((TID) & (enc_insert_keys[i].second));
+  std::sort(sorted_tids.begin(), sorted_tids.end(),
+            [](const TID a, const TID b) { return *(std::string *)a < *(std::string *)b; });
+  // bulk load keys must be unique and prefix-free, and padding may make
+  // encoded keys collide, so keys that prefix the next one are dropped
+  std::vector<TID> bulk_tids;
+  for (int i = 0; i < (int)sorted_tids.size(); i++) {
+    const std::string &cur = *(std::string *)sorted_tids[i];
+    if (i + 1 < (int)sorted_tids.size() && ((std::string *)sorted_tids[i + 1])->compare(0, cur.size(), cur) == 0)
+      continue;
+    bulk_tids.push_back(sorted_tids[i]);
+  }
+  double bulk_load_start_time = getNow();
+  ART_ROWEX::Tree *bulk_art = new ART_ROWEX::Tree(loadKey, bulk_tids.data(), bulk_tids.size(), kInlineLeafKeys);
+  std::cout << "Bulk load time = " << (getNow() - bulk_load_start_time) << std::endl;
+  delete bulk_art;
+
   // traverse ART to get stats ==================================
   double mem = 0;
   double art_mem = 0;
@@ -506,6 +525,7 @@ int main(int argc, char *argv[]) {
   kRunEmail = (int)atoi(argv[3]);
   kRunWiki = (int)atoi(argv[4]);
   kRunUrl = (int)atoi(argv[5]);
+  if (argc > 6) kInlineLeafKeys = (atoi(argv[6]) != 0);
 
   loadKey((TID) & (end_key_str), end_key);
 
@@ -0,0 +1,211 @@
+#include <sys/time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Tree.h"
+#include "encoder_factory.hpp"
+
+//-------------------------------------------------------------
+// Multi-threaded YCSB-style workloads on ART_ROWEX. Half of the
+// keys are loaded first; each operation then encodes its raw key
+// with the shared encoder and runs a lookup, an insert of a key
+// not loaded yet, or a scan of 1-100 keys. Every workload is run
+// with 1, 2, 4, ... threads on a freshly loaded tree
+//-------------------------------------------------------------
+static const uint64_t kNumRecords = 10000000;
+static const uint64_t kNumTxns = 10000000;
+static const int kMaxThreads = 8;
+static const int kDictSizeLimit = 65536;
+static const int kSamplePercent = 10;
+static const int kMaxScanLen = 100;
+
+struct Workload {
+  const char *name;
+  int read_percent;
+  int insert_percent;  // the rest are scans
+};
+
+static const Workload kWorkloads[] = {
+    {"read-only", 100, 0}, {"95/5 read/insert", 95, 5}, {"50/50 read/insert", 50, 50}, {"scan-heavy", 0, 5}};
+
+static const std::string end_key_str = std::string(255, char(255));
+
+double getNow() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+void loadKey(TID tid, Key &key) {
+  std::string *key_str = (std::string *)tid;
+  key.set(reinterpret_cast<const char *>(key_str->c_str()), key_str->length());
+}
+
+void loadKeysFromFile(const std::string &file_name, const uint64_t num_records, std::vector<std::string> &keys) {
+  std::ifstream infile(file_name);
+  std::string key;
+  uint64_t count = 0;
+  while (count < num_records && infile >> key) {
+    keys.push_back(key);
+    count++;
+  }
+}
+
+// Raw keys are copied as they are
+void encodeKey(const hope::Encoder *encoder, const std::string &key, uint8_t *buffer, std::string &enc_key) {
+  if (encoder == nullptr) {
+    enc_key = key;
+    return;
+  }
+  int enc_len = encoder->encode(key, buffer);
+  enc_key.assign((const char *)buffer, (enc_len + 7) >> 3);
+}
+
+void runWorkload(const Workload &workload, const int num_threads, const hope::Encoder *encoder,
+                 const bool inline_leaf_keys, const std::vector<std::string> &keys, const uint64_t num_txns) {
+  // encoded keys are stored here; their addresses serve as TIDs
+  std::vector<std::string> enc_keys(keys.size());
+  uint64_t num_loaded = keys.size() / 2;
+  ART_ROWEX::Tree *art = new ART_ROWEX::Tree(loadKey, inline_leaf_keys);
+  {
+    auto t = art->getThreadInfo();
+    uint8_t buffer[8192];
+    for (uint64_t i = 0; i < num_loaded; i++) {
+      encodeKey(encoder, keys[i], buffer, enc_keys[i]);
+      Key key;
+      loadKey((TID) & (enc_keys[i]), key);
+      art->insert(key, (TID) & (enc_keys[i]), t);
+    }
+  }
+  Key end_key;
+  loadKey((TID) & (end_key_str), end_key);
+
+  uint64_t ops_per_thread = num_txns / num_threads;
+  std::vector<std::thread> threads;
+  std::vector<double> thread_tput(num_threads, 0);
+  std::vector<uint64_t> thread_sum(num_threads, 0);
+  std::atomic<int> num_ready(0);
+  std::atomic<bool> start(false);
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.push_back(std::thread([&, tid]() {
+      auto t = art->getThreadInfo();
+      std::mt19937 gen(tid);
+      std::uniform_int_distribution<uint64_t> key_dist(0, num_loaded - 1);
+      std::uniform_int_distribution<int> op_dist(0, 99);
+      std::uniform_int_distribution<int> scan_len_dist(1, kMaxScanLen);
+      uint8_t buffer[8192];
+      std::string enc_key;
+      TID result[kMaxScanLen];
+      // each thread inserts its own share of the keys not loaded yet
+      uint64_t next_insert = num_loaded + tid;
+      uint64_t sum = 0;
+
+      num_ready++;
+      while (!start.load()) {
+      }
+      double start_time = getNow();
+      for (uint64_t i = 0; i < ops_per_thread; i++) {
+        int op = op_dist(gen);
+        if (op >= workload.read_percent && op < workload.read_percent + workload.insert_percent &&
+            next_insert < keys.size()) {
+          encodeKey(encoder, keys[next_insert], buffer, enc_keys[next_insert]);
+          Key key;
+          loadKey((TID) & (enc_keys[next_insert]), key);
+          art->insert(key, (TID) & (enc_keys[next_insert]), t);
+          next_insert += num_threads;
+          continue;
+        }
+        encodeKey(encoder, keys[key_dist(gen)], buffer, enc_key);
+        Key key;
+        loadKey((TID) & (enc_key), key);
+        // once a thread has inserted its share, its inserts become lookups
+        if (op < workload.read_percent + workload.insert_percent) {
+          sum += (art->lookup(key, t) != 0);
+        } else {
+          Key continue_key;
+          std::size_t results_found = 0;
+          art->lookupRange(key, end_key, continue_key, result, scan_len_dist(gen), results_found, t);
+          sum += results_found;
+        }
+      }
+      thread_tput[tid] = ops_per_thread / (getNow() - start_time) / 1000000;
+      thread_sum[tid] = sum;
+    }));
+  }
+  while (num_ready.load() < num_threads) {
+  }
+  double start_time = getNow();
+  start.store(true);
+  for (int tid = 0; tid < num_threads; tid++) threads[tid].join();
+  double tput = ops_per_thread * num_threads / (getNow() - start_time) / 1000000;
+
+  uint64_t sum = 0;
+  for (int tid = 0; tid < num_threads; tid++) sum += thread_sum[tid];
+  std::cout << workload.name << ": threads = " << num_threads << ", total = " << tput << " Mops/s, per thread =";
+  for (int tid = 0; tid < num_threads; tid++) std::cout << " " << thread_tput[tid];
+  std::cout << " Mops/s (results = " << sum << ")" << std::endl;
+  delete art;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cout << "Usage: " << argv[0]
+              << " <key file> [num keys] [encoder type, 0 = raw keys] [max threads] [inline leaf keys, 0 or 1]"
+              << std::endl;
+    return -1;
+  }
+  std::string file_name = argv[1];
+  uint64_t num_records = (argc > 2) ? atoll(argv[2]) : kNumRecords;
+  int encoder_type = (argc > 3) ? atoi(argv[3]) : 0;
+  int max_threads = (argc > 4) ? atoi(argv[4]) : kMaxThreads;
+  bool inline_leaf_keys = (argc > 5) ? (atoi(argv[5]) != 0) : false;
+
+  std::vector<std::string> keys;
+  loadKeysFromFile(file_name, num_records, keys);
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  // one encoder shared by all threads; encoding is const
+  hope::Encoder *encoder = nullptr;
+  if (encoder_type > 0) {
+    std::vector<std::string> sample_keys;
+    for (int i = 0; i < (int)keys.size(); i += 100 / kSamplePercent) sample_keys.push_back(keys[i]);
+    encoder = hope::EncoderFactory::createEncoder(encoder_type);
+    encoder->build(sample_keys, kDictSizeLimit);
+  }
+  // ART keys must be prefix-free, and padding may make encoded keys
+  // collide, so keys whose encoding prefixes the next one are dropped
+  std::vector<std::pair<std::string, std::string> > enc_pairs;
+  uint8_t buffer[8192];
+  for (int i = 0; i < (int)keys.size(); i++) {
+    std::string enc_key;
+    encodeKey(encoder, keys[i], buffer, enc_key);
+    enc_pairs.push_back(std::make_pair(enc_key, keys[i]));
+  }
+  std::sort(enc_pairs.begin(), enc_pairs.end());
+  keys.clear();
+  for (int i = 0; i < (int)enc_pairs.size(); i++) {
+    if (i + 1 < (int)enc_pairs.size() &&
+        enc_pairs[i + 1].first.compare(0, enc_pairs[i].first.size(), enc_pairs[i].first) == 0)
+      continue;
+    keys.push_back(enc_pairs[i].second);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(0));
+  uint64_t num_txns = std::min(kNumTxns, (uint64_t)keys.size());
+  std::cout << "keys = " << keys.size() << ", txns per run = " << num_txns << std::endl;
+
+  for (const Workload &workload : kWorkloads) {
+    for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+      runWorkload(workload, num_threads, encoder, inline_leaf_keys, keys, num_txns);
+    }
+  }
+  delete encoder;
+  return 0;
+}
@@ -3,6 +3,8 @@
 
 #include <atomic>
 #include <array>
+#include <limits>
+#include <mutex>
 #include "tbb/enumerable_thread_specific.h"
 #include "tbb/combinable.h"
 
@@ -12,6 +14,7 @@ namespace ART {
         std::array<void*, 32> nodes;
         uint64_t epoche;
         std::size_t nodesCount;
+        std::size_t bytes;
         LabelDelete *next;
     };
 
@@ -21,13 +24,19 @@ namespace ART {
         std::size_t deletitionListCount = 0;
 
     public:
-        std::atomic<uint64_t> localEpoche;
+        // max while the owning thread is outside of an epoche
+        std::atomic<uint64_t> localEpoche{std::numeric_limits<uint64_t>::max()};
         size_t thresholdCounter{0};
+        // bytes of the nodes in this list
+        std::atomic<std::size_t> pendingBytes{0};
+        // taken by the owning thread to add or free nodes, and by other
+        // threads helping to free them
+        std::mutex mutex;
 
         ~DeletionList();
         LabelDelete *head();
 
-        void add(void *n, uint64_t globalEpoch);
+        void add(void *n, std::size_t bytes, uint64_t globalEpoch);
 
         void remove(LabelDelete *label, LabelDelete *prev);
 
@@ -37,6 +46,19 @@ namespace ART {
         std::uint64_t added = 0;
     };
 
+    struct EpocheStats {
+        // bytes of replaced nodes not freed yet
+        std::size_t pendingBytes;
+        std::size_t peakPendingBytes;
+        // epoche advances and cleanups forced by memory pressure
+        uint64_t forcedAdvances;
+        // lists of other threads freed by a helping thread
+        uint64_t helpedCleanups;
+        // writers that gave up waiting for other threads to leave their
+        // epoche, leaving the ceiling exceeded
+        uint64_t stalls;
+    };
+
     class Epoche;
     class EpocheGuard;
 
@@ -68,18 +90,59 @@ namespace ART {
 
         size_t startGCThreshhold;
 
+        // a thread whose list holds more bytes cleans up at once
+        std::size_t listPendingBytesThreshold;
+        // ceiling on the bytes pending in all lists
+        std::atomic<std::size_t> maxPendingBytes;
+
+        std::atomic<std::size_t> pendingBytes{0};
+        std::atomic<std::size_t> peakPendingBytes{0};
+        std::atomic<uint64_t> forcedAdvances{0};
+        std::atomic<uint64_t> helpedCleanups{0};
+        std::atomic<uint64_t> stalls{0};
+
+        // cleanup attempts of a writer over the ceiling before it gives up
+        static constexpr int maxCleanupRetries = 64;
+
+        uint64_t oldestEpoche();
+
+        // frees the nodes of deletionList older than oldest; the caller
+        // holds the list's mutex
+        void cleanup(DeletionList &deletionList, uint64_t oldest);
+
+        void helpCleanup(DeletionList &own);
 
     public:
-        Epoche(size_t startGCThreshhold) : startGCThreshhold(startGCThreshhold) { }
+        static constexpr std::size_t defaultListPendingBytesThreshold = 1 << 20;
+        static constexpr std::size_t defaultMaxPendingBytes = 64 << 20;
+
+        Epoche(size_t startGCThreshhold, std::size_t listPendingBytesThreshold = defaultListPendingBytesThreshold,
+               std::size_t maxPendingBytes = defaultMaxPendingBytes)
+                : startGCThreshhold(startGCThreshhold), listPendingBytesThreshold(listPendingBytesThreshold),
+                  maxPendingBytes(maxPendingBytes) { }
 
         ~Epoche();
 
         void enterEpoche(ThreadInfo &epocheInfo);
 
-        void markNodeForDeletion(void *n, ThreadInfo &epocheInfo);
+        void markNodeForDeletion(void *n, std::size_t bytes, ThreadInfo &epocheInfo);
+
+        // leaves the epoche without freeing anything
+        void exitEpoche(ThreadInfo &epocheInfo);
 
+        /**
+         * leaves the epoche and frees old nodes of this thread. Beyond the
+         * list threshold the epoche is advanced at once; beyond the global
+         * ceiling this thread also frees other threads' lists and waits
+         * until its own list is empty or the ceiling is met again, for at
+         * most maxCleanupRetries attempts (a reader may never leave)
+         */
         void exitEpocheAndCleanup(ThreadInfo &info);
 
+        void setMaxPendingBytes(std::size_t bytes);
+
+        EpocheStats getStats() const;
+
         void showDeleteRatio();
 
     };
@@ -98,13 +161,15 @@ namespace ART {
     };
 
     class EpocheGuardReadonly {
+        ThreadInfo &threadEpocheInfo;
     public:
 
-        EpocheGuardReadonly(ThreadInfo &threadEpocheInfo) {
+        EpocheGuardReadonly(ThreadInfo &threadEpocheInfo) : threadEpocheInfo(threadEpocheInfo) {
             threadEpocheInfo.getEpoche().enterEpoche(threadEpocheInfo);
         }
 
         ~EpocheGuardReadonly() {
+            threadEpocheInfo.getEpoche().exitEpoche(threadEpocheInfo);
         }
     };
 
@@ -37,6 +37,17 @@ namespace ART_ROWEX {
     };
 //    static_assert(sizeof(Prefix) == 8, "Prefix should be 64 bit long");
 
+    static constexpr uint32_t maxInlineKeyLength = 15;
+    /*
+     * a leaf that keeps a copy of a short key next to its TID, so that
+     * lookups can check the key without calling loadKey
+     */
+    struct InlineLeaf {
+        TID tid;
+        uint8_t keyLen;
+        uint8_t key[maxInlineKeyLength];
+    };
+
     class N {
     protected:
         N(NTypes type, uint32_t level, const uint8_t *prefix, uint32_t prefixLength) : level(level) {
@@ -106,6 +117,12 @@ namespace ART_ROWEX {
 
         static void change(N *node, uint8_t key, N *val);
 
+        /**
+         * adds a child to a node that no other thread can see yet (bulk
+         * load); keys must be added in ascending order and fit the node type
+         */
+        static void appendChild(N *node, uint8_t key, N *val);
+
         static void removeAndUnlock(N *node, uint8_t key, N *parentNode, uint8_t keyParent, ThreadInfo &threadInfo, bool &needRestart);
 
         Prefix getPrefi() const;
@@ -118,8 +135,23 @@ namespace ART_ROWEX {
 
         static bool isLeaf(const N *n);
 
+        /**
+         * TIDs must fit in 62 bits: bit 62 marks an InlineLeaf, and every
+         * tree checks it when reading or deleting a leaf
+         */
         static N *setLeaf(TID tid);
 
+        /**
+         * an InlineLeaf if the key fits, a plain leaf otherwise
+         */
+        static N *setLeaf(TID tid, const uint8_t *key, uint32_t keyLen);
+
+        static bool isInlineLeaf(const N *n);
+
+        static InlineLeaf *getInlineLeaf(const N *n);
+
+        static const N *getAnyLeaf(const N *n);
+
         static N *getAnyChild(const N *n);
 
         static TID getAnyChildTid(const N *n);
@@ -128,6 +160,10 @@ namespace ART_ROWEX {
 
         static void deleteNode(N *node);
 
+        // allocation size of an inner node, used to account for nodes
+        // waiting in the epoche's deletion lists
+        static std::size_t getNodeSize(const N *node);
+
         static std::tuple<N *, uint8_t> getSecondChild(N *node, const uint8_t k);
 
         template<typename curN, typename biggerN>
@@ -4,6 +4,7 @@
 
 #ifndef ART_ROWEX_TREE_H
 #define ART_ROWEX_TREE_H
+#include <vector>
 #include "N.h"
 
 using namespace ART;
@@ -17,10 +18,34 @@ namespace ART_ROWEX {
     private:
         N *const root;
 
-        TID checkKey(const TID tid, const Key &k) const;
+        TID checkKey(const N *leaf, const Key &k) const;
+
+        N *newLeaf(TID tid, const Key &k) const;
+
+        // keys of a bulk load, loaded once and stored back to back
+        struct BulkLoadKeys {
+            std::vector<TID> tids;
+            bool inlineLeafKeys;
+            std::vector<uint8_t> bytes;
+            std::vector<std::size_t> offsets;
+
+            const uint8_t *key(std::size_t i) const { return bytes.data() + offsets[i]; }
+            uint32_t keyLen(std::size_t i) const { return offsets[i + 1] - offsets[i]; }
+        };
+
+        static N *bulkLoadNode(const BulkLoadKeys &keys, std::size_t begin, std::size_t end, uint32_t level);
+
+        static void bulkLoadChildren(N *node, const BulkLoadKeys &keys, std::size_t begin, std::size_t end,
+                                     uint32_t level);
 
         LoadKeyFunction loadKey;
 
+        // stores short keys in InlineLeafs
+        const bool inlineLeafKeys;
+
+        // keys the bulk load constructor dropped
+        std::size_t bulkLoadSkipped = 0;
+
         Epoche epoche{256};
 
     public:
@@ -59,18 +84,46 @@ namespace ART_ROWEX {
 
         static PCEqualsResults checkPrefixEquals(const N* n, uint32_t &level, const Key &start, const Key &end, LoadKeyFunction loadKey);
 
+        static void loadLeafKey(const N *leaf, Key &key, LoadKeyFunction loadKey);
+
     public:
 
-        Tree(LoadKeyFunction loadKey);
+        /**
+         * with inlineLeafKeys, leaves of keys up to maxInlineKeyLength bytes
+         * keep a copy of the key, and lookups of such keys do not call loadKey.
+         * TIDs must be below 2^62 whether or not the option is set
+         */
+        Tree(LoadKeyFunction loadKey, bool inlineLeafKeys = false);
+
+        /**
+         * bulk load: builds the tree bottom-up from tids, whose keys should be
+         * sorted and unique, none a prefix of another (as for insert). Empty
+         * keys, keys that do not sort after the previous kept key and keys
+         * that prefix the next one are dropped and counted in
+         * getBulkLoadSkipped(). Every node gets its final type and prefix;
+         * nothing is locked or grown.
+         */
+        Tree(LoadKeyFunction loadKey, const TID tids[], std::size_t count, bool inlineLeafKeys = false);
 
         Tree(const Tree &) = delete;
 
-        Tree(Tree &&t) : root(t.root), loadKey(t.loadKey) { }
+        Tree(Tree &&t) : root(t.root), loadKey(t.loadKey), inlineLeafKeys(t.inlineLeafKeys),
+                         bulkLoadSkipped(t.bulkLoadSkipped) { }
 
         ~Tree();
 
         ThreadInfo getThreadInfo();
 
+        // number of keys the bulk load constructor dropped, 0 for other trees
+        std::size_t getBulkLoadSkipped() const { return bulkLoadSkipped; }
+
+        // memory held by replaced nodes until no reader can see them
+        EpocheStats getEpocheStats() const;
+
+        // writers free nodes (and wait for readers if they must) to keep the
+        // replaced nodes below this many bytes
+        void setMaxPendingBytes(std::size_t bytes);
+
 	//huanchen
 	void traverse(double& mem, double& avg_height, int& cnt_N4, int& cnt_N16, int& cnt_N48, int& cnt_N256, uint64_t&  waste_child_mem, uint64_t& skip_prefix_mem, uint64_t& waste_prefix_mem) const;
 
@@ -6,6 +6,7 @@
 
 #include <assert.h>
 #include <iostream>
+#include <thread>
 #include "Epoche.h"
 using namespace ART;
 
@@ -32,13 +33,14 @@ inline void DeletionList::remove(LabelDelete *label, LabelDelete *prev) {
         prev->next = label->next;
     }
     deletitionListCount -= label->nodesCount;
+    pendingBytes.store(pendingBytes.load(std::memory_order_relaxed) - label->bytes, std::memory_order_relaxed);
 
     label->next = freeLabelDeletes;
     freeLabelDeletes = label;
     deleted += label->nodesCount;
 }
 
-inline void DeletionList::add(void *n, uint64_t globalEpoch) {
+inline void DeletionList::add(void *n, std::size_t bytes, uint64_t globalEpoch) {
     deletitionListCount++;
     LabelDelete *label;
     if (headDeletionList != nullptr && headDeletionList->nodesCount < headDeletionList->nodes.size()) {
@@ -51,12 +53,15 @@ inline void DeletionList::add(void *n, uint64_t globalEpoch) {
             label = new LabelDelete();
         }
         label->nodesCount = 0;
+        label->bytes = 0;
         label->next = headDeletionList;
         headDeletionList = label;
     }
     label->nodes[label->nodesCount] = n;
     label->nodesCount++;
+    label->bytes += bytes;
     label->epoche = globalEpoch;
+    pendingBytes.store(pendingBytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
 
     added++;
 }
@@ -67,66 +72,150 @@ inline LabelDelete *DeletionList::head() {
 
 inline void Epoche::enterEpoche(ThreadInfo &epocheInfo) {
     unsigned long curEpoche = currentEpoche.load(std::memory_order_relaxed);
-    epocheInfo.getDeletionList().localEpoche.store(curEpoche, std::memory_order_release);
+    // the store must be visible before the tree is read, otherwise a
+    // cleaning thread could miss this reader; a release store allows
+    // that reordering
+    epocheInfo.getDeletionList().localEpoche.store(curEpoche, std::memory_order_seq_cst);
 }
 
-inline void Epoche::markNodeForDeletion(void *n, ThreadInfo &epocheInfo) {
-    epocheInfo.getDeletionList().add(n, currentEpoche.load());
-    epocheInfo.getDeletionList().thresholdCounter++;
+inline void Epoche::markNodeForDeletion(void *n, std::size_t bytes, ThreadInfo &epocheInfo) {
+    DeletionList &deletionList = epocheInfo.getDeletionList();
+    {
+        std::lock_guard<std::mutex> lock(deletionList.mutex);
+        deletionList.add(n, bytes, currentEpoche.load());
+    }
+    deletionList.thresholdCounter++;
+
+    std::size_t pending = pendingBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    std::size_t peak = peakPendingBytes.load(std::memory_order_relaxed);
+    while (pending > peak && !peakPendingBytes.compare_exchange_weak(peak, pending, std::memory_order_relaxed)) {
+    }
+}
+
+inline void Epoche::exitEpoche(ThreadInfo &epocheInfo) {
+    epocheInfo.getDeletionList().localEpoche.store(std::numeric_limits<uint64_t>::max(), std::memory_order_release);
+}
+
+inline uint64_t Epoche::oldestEpoche() {
+    uint64_t oldestEpoche = std::numeric_limits<uint64_t>::max();
+    for (auto &epoche : deletionLists) {
+        auto e = epoche.localEpoche.load();
+        if (e < oldestEpoche) {
+            oldestEpoche = e;
+        }
+    }
+    return oldestEpoche;
+}
+
+inline void Epoche::cleanup(DeletionList &deletionList, uint64_t oldest) {
+    std::size_t freedBytes = 0;
+    LabelDelete *cur = deletionList.head(), *next, *prev = nullptr;
+    while (cur != nullptr) {
+        next = cur->next;
+
+        if (cur->epoche < oldest) {
+            for (std::size_t i = 0; i < cur->nodesCount; ++i) {
+                operator delete(cur->nodes[i]);
+            }
+            freedBytes += cur->bytes;
+            deletionList.remove(cur, prev);
+        } else {
+            prev = cur;
+        }
+        cur = next;
+    }
+    pendingBytes.fetch_sub(freedBytes, std::memory_order_relaxed);
+}
+
+inline void Epoche::helpCleanup(DeletionList &own) {
+    uint64_t oldest = oldestEpoche();
+    for (auto &d : deletionLists) {
+        if (&d == &own || d.pendingBytes.load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+        // a busy list is being filled or freed by its owner
+        std::unique_lock<std::mutex> lock(d.mutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            continue;
+        }
+        cleanup(d, oldest);
+        helpedCleanups++;
+    }
 }
 
 inline void Epoche::exitEpocheAndCleanup(ThreadInfo &epocheInfo) {
     DeletionList &deletionList = epocheInfo.getDeletionList();
+    // leave the epoche first, so that this thread never waits for itself
+    // and an idle thread does not hold back the others
+    deletionList.localEpoche.store(std::numeric_limits<uint64_t>::max());
     if ((deletionList.thresholdCounter & (64 - 1)) == 1) {
         currentEpoche++;
     }
-    if (deletionList.thresholdCounter > startGCThreshhold) {
-        if (deletionList.size() == 0) {
-            deletionList.thresholdCounter = 0;
-            return;
+    bool overList = deletionList.pendingBytes.load(std::memory_order_relaxed) > listPendingBytesThreshold;
+    std::size_t ceiling = maxPendingBytes.load(std::memory_order_relaxed);
+    bool overCeiling = pendingBytes.load(std::memory_order_relaxed) > ceiling;
+    if (deletionList.thresholdCounter <= startGCThreshhold && !overList && !overCeiling) {
+        return;
+    }
+    if (overList || overCeiling) {
+        // the nodes marked so far become older than every later reader
+        currentEpoche++;
+        forcedAdvances++;
+    }
+    deletionList.thresholdCounter = 0;
+    {
+        std::lock_guard<std::mutex> lock(deletionList.mutex);
+        if (deletionList.size() != 0) {
+            cleanup(deletionList, oldestEpoche());
         }
-        deletionList.localEpoche.store(std::numeric_limits<uint64_t>::max());
+    }
+    if (!overCeiling) {
+        return;
+    }
 
-        uint64_t oldestEpoche = std::numeric_limits<uint64_t>::max();
-        for (auto &epoche : deletionLists) {
-            auto e = epoche.localEpoche.load();
-            if (e < oldestEpoche) {
-                oldestEpoche = e;
+    helpCleanup(deletionList);
+    // the remaining nodes of this list wait for readers that entered before
+    // the advance. A stalled reader would hold them forever, so the wait is
+    // bounded and the nodes stay pending (over the ceiling) when it runs out
+    for (int retry = 0; pendingBytes.load(std::memory_order_relaxed) > ceiling; retry++) {
+        {
+            std::lock_guard<std::mutex> lock(deletionList.mutex);
+            if (deletionList.size() == 0) {
+                break;
             }
-        }
-
-        LabelDelete *cur = deletionList.head(), *next, *prev = nullptr;
-        while (cur != nullptr) {
-            next = cur->next;
-
-            if (cur->epoche < oldestEpoche) {
-                for (std::size_t i = 0; i < cur->nodesCount; ++i) {
-                    operator delete(cur->nodes[i]);
-                }
-                deletionList.remove(cur, prev);
-            } else {
-                prev = cur;
+            cleanup(deletionList, oldestEpoche());
+            if (deletionList.size() == 0) {
+                break;
             }
-            cur = next;
         }
-        deletionList.thresholdCounter = 0;
+        if (retry == maxCleanupRetries) {
+            stalls++;
+            break;
+        }
+        std::this_thread::yield();
     }
 }
 
+inline void Epoche::setMaxPendingBytes(std::size_t bytes) {
+    maxPendingBytes.store(bytes);
+}
+
+inline EpocheStats Epoche::getStats() const {
+    EpocheStats stats;
+    stats.pendingBytes = pendingBytes.load();
+    stats.peakPendingBytes = peakPendingBytes.load();
+    stats.forcedAdvances = forcedAdvances.load();
+    stats.helpedCleanups = helpedCleanups.load();
+    stats.stalls = stalls.load();
+    return stats;
+}
+
 inline Epoche::~Epoche() {
-    uint64_t oldestEpoche = std::numeric_limits<uint64_t>::max();
-    for (auto &epoche : deletionLists) {
-        auto e = epoche.localEpoche.load();
-        if (e < oldestEpoche) {
-            oldestEpoche = e;
-        }
-    }
     for (auto &d : deletionLists) {
         LabelDelete *cur = d.head(), *next, *prev = nullptr;
         while (cur != nullptr) {
             next = cur->next;
 
-            //assert(cur->epoche < oldestEpoche);
             for (std::size_t i = 0; i < cur->nodesCount; ++i) {
                 operator delete(cur->nodes[i]);
             }
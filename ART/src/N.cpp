@@ -78,6 +78,26 @@ namespace ART_ROWEX {
         __builtin_unreachable();
     }
 
+    void N::appendChild(N *node, uint8_t key, N *val) {
+        bool inserted = false;
+        switch (node->getType()) {
+            case NTypes::N4:
+                inserted = static_cast<N4 *>(node)->insert(key, val);
+                break;
+            case NTypes::N16:
+                inserted = static_cast<N16 *>(node)->insert(key, val);
+                break;
+            case NTypes::N48:
+                inserted = static_cast<N48 *>(node)->insert(key, val);
+                break;
+            case NTypes::N256:
+                inserted = static_cast<N256 *>(node)->insert(key, val);
+                break;
+        }
+        assert(inserted);
+        (void)inserted;
+    }
+
     void N::change(N *node, uint8_t key, N *val) {
         switch (node->getType()) {
             case NTypes::N4: {
@@ -126,7 +146,7 @@ namespace ART_ROWEX {
         parentNode->writeUnlock();
 
         n->writeUnlockObsolete();
-        threadInfo.getEpoche().markNodeForDeletion(n, threadInfo);
+        threadInfo.getEpoche().markNodeForDeletion(n, sizeof(curN), threadInfo);
     }
 
     template<typename curN>
@@ -146,7 +166,7 @@ namespace ART_ROWEX {
         parentNode->writeUnlock();
 
         n->writeUnlockObsolete();
-        threadInfo.getEpoche().markNodeForDeletion(n, threadInfo);
+        threadInfo.getEpoche().markNodeForDeletion(n, sizeof(curN), threadInfo);
     }
 
     void N::insertAndUnlock(N *node, N *parentNode, uint8_t keyParent, uint8_t key, N *val, ThreadInfo &threadInfo, bool &needRestart) {
@@ -262,7 +282,7 @@ namespace ART_ROWEX {
 
         parentNode->writeUnlock();
         n->writeUnlockObsolete();
-        threadInfo.getEpoche().markNodeForDeletion(n, threadInfo);
+        threadInfo.getEpoche().markNodeForDeletion(n, sizeof(curN), threadInfo);
     }
 
     void N::removeAndUnlock(N *node, uint8_t key, N *parentNode, uint8_t keyParent, ThreadInfo &threadInfo, bool &needRestart) {
@@ -345,16 +365,43 @@ namespace ART_ROWEX {
         this->prefix.store(p, std::memory_order_release);
     }
 
+    static constexpr uint64_t leafBit = static_cast<uint64_t>(1) << 63;
+    static constexpr uint64_t inlineLeafBit = static_cast<uint64_t>(1) << 62;
+
     bool N::isLeaf(const N *n) {
-        return (reinterpret_cast<uint64_t>(n) & (static_cast<uint64_t>(1) << 63)) == (static_cast<uint64_t>(1) << 63);
+        return (reinterpret_cast<uint64_t>(n) & leafBit) == leafBit;
     }
 
     N *N::setLeaf(TID tid) {
-        return reinterpret_cast<N *>(tid | (static_cast<uint64_t>(1) << 63));
+        assert(tid < inlineLeafBit);
+        return reinterpret_cast<N *>(tid | leafBit);
+    }
+
+    N *N::setLeaf(TID tid, const uint8_t *key, uint32_t keyLen) {
+        assert(tid < inlineLeafBit);
+        if (keyLen > maxInlineKeyLength) {
+            return setLeaf(tid);
+        }
+        InlineLeaf *leaf = new InlineLeaf;
+        leaf->tid = tid;
+        leaf->keyLen = keyLen;
+        memcpy(leaf->key, key, keyLen);
+        return reinterpret_cast<N *>(reinterpret_cast<uint64_t>(leaf) | leafBit | inlineLeafBit);
+    }
+
+    bool N::isInlineLeaf(const N *n) {
+        return (reinterpret_cast<uint64_t>(n) & (leafBit | inlineLeafBit)) == (leafBit | inlineLeafBit);
+    }
+
+    InlineLeaf *N::getInlineLeaf(const N *n) {
+        return reinterpret_cast<InlineLeaf *>(reinterpret_cast<uint64_t>(n) & (inlineLeafBit - 1));
     }
 
     TID N::getLeaf(const N *n) {
-        return (reinterpret_cast<uint64_t>(n) & ((static_cast<uint64_t>(1) << 63) - 1));
+        if (isInlineLeaf(n)) {
+            return getInlineLeaf(n)->tid;
+        }
+        return (reinterpret_cast<uint64_t>(n) & (leafBit - 1));
     }
 
     std::tuple<N *, uint8_t> N::getSecondChild(N *node, const uint8_t key) {
@@ -371,6 +418,10 @@ namespace ART_ROWEX {
     }
 
     void N::deleteNode(N *node) {
+        if (N::isInlineLeaf(node)) {
+            delete getInlineLeaf(node);
+            return;
+        }
         if (N::isLeaf(node)) {
             return;
         }
@@ -399,7 +450,25 @@ namespace ART_ROWEX {
         delete node;
     }
 
+    std::size_t N::getNodeSize(const N *node) {
+        switch (node->getType()) {
+            case NTypes::N4:
+                return sizeof(N4);
+            case NTypes::N16:
+                return sizeof(N16);
+            case NTypes::N48:
+                return sizeof(N48);
+            case NTypes::N256:
+                return sizeof(N256);
+        }
+        return sizeof(N);
+    }
+
     TID N::getAnyChildTid(const N *n) {
+        return getLeaf(getAnyLeaf(n));
+    }
+
+    const N *N::getAnyLeaf(const N *n) {
         const N *nextNode = n;
 
         while (true) {
@@ -408,7 +477,7 @@ namespace ART_ROWEX {
 
             assert(nextNode != nullptr);
             if (isLeaf(nextNode)) {
-                return getLeaf(nextNode);
+                return nextNode;
             }
         }
     }
@@ -10,7 +10,99 @@
 
 namespace ART_ROWEX {
 
-    Tree::Tree(LoadKeyFunction loadKey) : root(new N256(0, {})), loadKey(loadKey) {
+    Tree::Tree(LoadKeyFunction loadKey, bool inlineLeafKeys) : root(new N256(0, {})), loadKey(loadKey),
+                                                               inlineLeafKeys(inlineLeafKeys) {
+    }
+
+    Tree::Tree(LoadKeyFunction loadKey, const TID tids[], std::size_t count, bool inlineLeafKeys)
+            : root(new N256(0, {})), loadKey(loadKey), inlineLeafKeys(inlineLeafKeys) {
+        BulkLoadKeys keys;
+        keys.inlineLeafKeys = inlineLeafKeys;
+        keys.tids.reserve(count);
+        keys.offsets.reserve(count + 1);
+        keys.offsets.push_back(0);
+        Key key;
+        for (std::size_t i = 0; i < count; ++i) {
+            loadKey(tids[i], key);
+            uint32_t keyLen = key.getKeyLen();
+            if (keyLen == 0) {
+                bulkLoadSkipped++;
+                continue;
+            }
+            if (!keys.tids.empty()) {
+                // compare with the last kept key: a key that does not sort after
+                // it is dropped, and a kept key that prefixes this one is replaced
+                std::size_t last = keys.tids.size() - 1;
+                uint32_t lastLen = keys.keyLen(last);
+                int cmp = memcmp(keys.key(last), &key[0], std::min(lastLen, keyLen));
+                if (cmp > 0 || (cmp == 0 && lastLen >= keyLen)) {
+                    bulkLoadSkipped++;
+                    continue;
+                }
+                if (cmp == 0) {
+                    keys.tids.pop_back();
+                    keys.offsets.pop_back();
+                    keys.bytes.resize(keys.offsets.back());
+                    bulkLoadSkipped++;
+                }
+            }
+            keys.tids.push_back(tids[i]);
+            keys.bytes.insert(keys.bytes.end(), &key[0], &key[0] + keyLen);
+            keys.offsets.push_back(keys.bytes.size());
+        }
+        bulkLoadChildren(root, keys, 0, keys.tids.size(), 0);
+    }
+
+    N *Tree::bulkLoadNode(const BulkLoadKeys &keys, std::size_t begin, std::size_t end, uint32_t level) {
+        if (end - begin == 1) {
+            if (keys.inlineLeafKeys) {
+                return N::setLeaf(keys.tids[begin], keys.key(begin), keys.keyLen(begin));
+            }
+            return N::setLeaf(keys.tids[begin]);
+        }
+        // keys are sorted: the range shares the prefix of its first and last key
+        const uint8_t *first = keys.key(begin);
+        const uint8_t *last = keys.key(end - 1);
+        // the keys are prefix-free, so they differ before the shorter one ends
+        uint32_t minLen = std::min(keys.keyLen(begin), keys.keyLen(end - 1));
+        uint32_t prefixLength = 0;
+        while (level + prefixLength + 1 < minLen && first[level + prefixLength] == last[level + prefixLength]) {
+            prefixLength++;
+        }
+        uint32_t nodeLevel = level + prefixLength;
+
+        uint32_t childCount = 1;
+        for (std::size_t i = begin + 1; i < end; ++i) {
+            if (keys.key(i)[nodeLevel] != keys.key(i - 1)[nodeLevel]) {
+                childCount++;
+            }
+        }
+        N *node;
+        if (childCount <= 4) {
+            node = new N4(nodeLevel, &first[level], prefixLength);
+        } else if (childCount <= 16) {
+            node = new N16(nodeLevel, &first[level], prefixLength);
+        } else if (childCount <= 48) {
+            node = new N48(nodeLevel, &first[level], prefixLength);
+        } else {
+            node = new N256(nodeLevel, &first[level], prefixLength);
+        }
+        bulkLoadChildren(node, keys, begin, end, nodeLevel);
+        return node;
+    }
+
+    void Tree::bulkLoadChildren(N *node, const BulkLoadKeys &keys, std::size_t begin, std::size_t end,
+                                uint32_t level) {
+        std::size_t childBegin = begin;
+        while (childBegin < end) {
+            uint8_t childKey = keys.key(childBegin)[level];
+            std::size_t childEnd = childBegin + 1;
+            while (childEnd < end && keys.key(childEnd)[level] == childKey) {
+                childEnd++;
+            }
+            N::appendChild(node, childKey, bulkLoadNode(keys, childBegin, childEnd, level + 1));
+            childBegin = childEnd;
+        }
     }
 
     Tree::~Tree() {
@@ -22,6 +114,14 @@ namespace ART_ROWEX {
         return ThreadInfo(this->epoche);
     }
 
+    EpocheStats Tree::getEpocheStats() const {
+        return epoche.getStats();
+    }
+
+    void Tree::setMaxPendingBytes(std::size_t bytes) {
+        epoche.setMaxPendingBytes(bytes);
+    }
+
     //huanchen
     void Tree::traverse(double& memory, double& avg_height,
                         int& cnt_N4, int& cnt_N16,
@@ -79,6 +179,9 @@ namespace ART_ROWEX {
             N* n = std::get<1>(children[i]);
             if (N::isLeaf(n)) {
                 height_sum += height;
+                if (N::isInlineLeaf(n)) {
+                    mem += sizeof(InlineLeaf);
+                }
             } else {
                 node_queue.push(n);
                 node_count_next_level++;
@@ -100,7 +203,7 @@ namespace ART_ROWEX {
     }
 
     TID Tree::lookup(const Key &k, ThreadInfo &threadEpocheInfo) const {
-        //EpocheGuardReadonly epocheGuard(threadEpocheInfo);
+        EpocheGuardReadonly epocheGuard(threadEpocheInfo);
         N *node = root;
         uint32_t level = 0;
         bool optimisticPrefixMatch = false;
@@ -122,11 +225,10 @@ namespace ART_ROWEX {
                         return 0;
                     }
                     if (N::isLeaf(node)) {
-                        TID tid = N::getLeaf(node);
                         if (level < k.getKeyLen() - 1 || optimisticPrefixMatch) {
-                            return checkKey(tid, k);
+                            return checkKey(node, k);
                         } else {
-                            return tid;
+                            return N::getLeaf(node);
                         }
                     }
                 }
@@ -145,7 +247,7 @@ namespace ART_ROWEX {
                 break;
             }
         }
-       // EpocheGuard epocheGuard(threadEpocheInfo);
+        EpocheGuardReadonly epocheGuard(threadEpocheInfo);
         TID toContinue = 0;
         bool restart;
         std::function<void(const N *)> copy = [&result, &resultSize, &resultsFound, &toContinue, &copy](const N *node) {
@@ -318,7 +420,15 @@ namespace ART_ROWEX {
     }
 
 
-    TID Tree::checkKey(const TID tid, const Key &k) const {
+    TID Tree::checkKey(const N *leaf, const Key &k) const {
+        if (N::isInlineLeaf(leaf)) {
+            const InlineLeaf *inlineLeaf = N::getInlineLeaf(leaf);
+            if (inlineLeaf->keyLen == k.getKeyLen() && memcmp(inlineLeaf->key, &k[0], k.getKeyLen()) == 0) {
+                return inlineLeaf->tid;
+            }
+            return 0;
+        }
+        TID tid = N::getLeaf(leaf);
         Key kt;
         this->loadKey(tid, kt);
         if (k == kt) {
@@ -327,8 +437,24 @@ namespace ART_ROWEX {
         return 0;
     }
 
+    N *Tree::newLeaf(TID tid, const Key &k) const {
+        if (inlineLeafKeys) {
+            return N::setLeaf(tid, &k[0], k.getKeyLen());
+        }
+        return N::setLeaf(tid);
+    }
+
+    void Tree::loadLeafKey(const N *leaf, Key &key, LoadKeyFunction loadKey) {
+        if (N::isInlineLeaf(leaf)) {
+            const InlineLeaf *inlineLeaf = N::getInlineLeaf(leaf);
+            key.set(reinterpret_cast<const char *>(inlineLeaf->key), inlineLeaf->keyLen);
+            return;
+        }
+        loadKey(N::getLeaf(leaf), key);
+    }
+
     void Tree::insert(const Key &k, TID tid, ThreadInfo &epocheInfo) {
-//        EpocheGuard epocheGuard(epocheInfo);
+        EpocheGuard epocheGuard(epocheInfo);
         restart:
         bool needRestart = false;
 
@@ -363,7 +489,7 @@ namespace ART_ROWEX {
                     auto newNode = new N4(nextLevel, prefi);
 
                     // 2)  add node and (tid, *k) as children
-                    newNode->insert(k[nextLevel], N::setLeaf(tid));
+                    newNode->insert(k[nextLevel], newLeaf(tid, k));
                     newNode->insert(nonMatchingKey, node);
 
                     // 3) lockVersionOrRestart, update parentNode to point to the new node, unlock
@@ -395,7 +521,7 @@ namespace ART_ROWEX {
                 node->lockVersionOrRestart(v, needRestart);
                 if (needRestart) goto restart;
 
-                N::insertAndUnlock(node, parentNode, parentKey, nodeKey, N::setLeaf(tid), epocheInfo, needRestart);
+                N::insertAndUnlock(node, parentNode, parentKey, nodeKey, newLeaf(tid, k), epocheInfo, needRestart);
                 if (needRestart) goto restart;
                 return;
             }
@@ -404,7 +530,7 @@ namespace ART_ROWEX {
                 if (needRestart) goto restart;
 
                 Key key;
-                loadKey(N::getLeaf(nextNode), key);
+                loadLeafKey(nextNode, key, loadKey);
 
                 level++;
                 assert(level < key.getKeyLen()); //prevent inserting when prefix of key exists already
@@ -414,7 +540,7 @@ namespace ART_ROWEX {
                 }
 
                 auto n4 = new N4(level + prefixLength, &k[level], prefixLength);
-                n4->insert(k[level + prefixLength], N::setLeaf(tid));
+                n4->insert(k[level + prefixLength], newLeaf(tid, k));
                 n4->insert(key[level + prefixLength], nextNode);
                 N::change(node, k[level - 1], n4);
                 node->writeUnlock();
@@ -425,7 +551,7 @@ namespace ART_ROWEX {
     }
 
     void Tree::remove(const Key &k, TID tid, ThreadInfo &threadInfo) {
- //       EpocheGuard epocheGuard(threadInfo);
+        EpocheGuard epocheGuard(threadInfo);
         restart:
         bool needRestart = false;
 
@@ -486,7 +612,7 @@ namespace ART_ROWEX {
 
                                 parentNode->writeUnlock();
                                 node->writeUnlockObsolete();
-                                this->epoche.markNodeForDeletion(node, threadInfo);
+                                this->epoche.markNodeForDeletion(node, N::getNodeSize(node), threadInfo);
                             } else {
                                 uint64_t vChild = secondNodeN->getVersion();
                                 secondNodeN->lockVersionOrRestart(vChild, needRestart);
@@ -507,13 +633,16 @@ namespace ART_ROWEX {
 
                                 parentNode->writeUnlock();
                                 node->writeUnlockObsolete();
-                                this->epoche.markNodeForDeletion(node, threadInfo);
+                                this->epoche.markNodeForDeletion(node, N::getNodeSize(node), threadInfo);
                                 secondNodeN->writeUnlock();
                             }
                         } else {
                             N::removeAndUnlock(node, k[level], parentNode, parentKey, threadInfo, needRestart);
                             if (needRestart) goto restart;
                         }
+                        if (N::isInlineLeaf(nextNode)) {
+                            this->epoche.markNodeForDeletion(N::getInlineLeaf(nextNode), sizeof(InlineLeaf), threadInfo);
+                        }
                         return;
                     }
                     level++;
@@ -561,14 +690,14 @@ namespace ART_ROWEX {
             Key kt;
             for (uint32_t i = ((level + p.prefixCount) - n->getLevel()); i < p.prefixCount; ++i) {
                 if (i == maxStoredPrefixLength) {
-                    loadKey(N::getAnyChildTid(n), kt);
+                    loadLeafKey(N::getAnyLeaf(n), kt, loadKey);
                 }
                 uint8_t curKey = i >= maxStoredPrefixLength ? kt[level] : p.prefix[i];
                 if (curKey != k[level]) {
                     nonMatchingKey = curKey;
                     if (p.prefixCount > maxStoredPrefixLength) {
                         if (i < maxStoredPrefixLength) {
-                            loadKey(N::getAnyChildTid(n), kt);
+                            loadLeafKey(N::getAnyLeaf(n), kt, loadKey);
                         }
                         for (uint32_t j = 0; j < std::min((p.prefixCount - (level - prevLevel) - 1),
                                                           maxStoredPrefixLength); ++j) {
@@ -597,7 +726,7 @@ namespace ART_ROWEX {
             Key kt;
             for (uint32_t i = ((level + p.prefixCount) - n->getLevel()); i < p.prefixCount; ++i) {
                 if (i == maxStoredPrefixLength) {
-                    loadKey(N::getAnyChildTid(n), kt);
+                    loadLeafKey(N::getAnyLeaf(n), kt, loadKey);
                 }
                 uint8_t kLevel = (k.getKeyLen() > level) ? k[level] : 0;
 
@@ -633,7 +762,7 @@ namespace ART_ROWEX {
             Key kt;
             for (uint32_t i = ((level + p.prefixCount) - n->getLevel()); i < p.prefixCount; ++i) {
                 if (i == maxStoredPrefixLength) {
-                    loadKey(N::getAnyChildTid(n), kt);
+                    loadLeafKey(N::getAnyLeaf(n), kt, loadKey);
                 }
                 uint8_t startLevel = (start.getKeyLen() > level) ? start[level] : 0;
                 uint8_t endLevel = (end.getKeyLen() > level) ? end[level] : 0;
@@ -2,8 +2,10 @@
 
 #include <assert.h>
 
+#include <atomic>
 #include <fstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "Tree.h"
@@ -103,6 +105,236 @@ TEST_F(ARTUnitTest, opcLookupWordTest) {
   delete encoder_;
 }
 
+TEST_F(ARTUnitTest, bulkLoadWordTest) {
+  std::vector<TID> tids;
+  for (int i = 0; i < (int)words_.size(); i++) tids.push_back((TID) & (words_[i]));
+  art_ = new ART_ROWEX::Tree(loadKey, tids.data(), tids.size());
+  EXPECT_EQ(0u, art_->getBulkLoadSkipped());
+  auto t = art_->getThreadInfo();
+  for (int i = 0; i < (int)words_.size(); i++) {
+    Key key;
+    loadKey((TID) & (words_[i]), key);
+    ASSERT_EQ((TID) & (words_[i]), art_->lookup(key, t));
+  }
+  std::string absent_str = words_[0] + "\x01";
+  Key absent_key;
+  loadKey((TID)&absent_str, absent_key);
+  EXPECT_EQ(0u, art_->lookup(absent_key, t));
+
+  // the tree matches one built by inserts, node for node
+  ART_ROWEX::Tree *art_insert = new ART_ROWEX::Tree(loadKey);
+  auto t2 = art_insert->getThreadInfo();
+  for (int i = 0; i < (int)words_.size(); i++) {
+    Key key;
+    loadKey((TID) & (words_[i]), key);
+    art_insert->insert(key, (TID) & (words_[i]), t2);
+  }
+
+  Key start_key, end_key, continue_key;
+  loadKey((TID) & (words_[100]), start_key);
+  loadKey((TID) & (words_[200]), end_key);
+  TID results[2][200];
+  std::size_t result_count[2] = {0, 0};
+  art_->lookupRange(start_key, end_key, continue_key, results[0], 200, result_count[0], t);
+  art_insert->lookupRange(start_key, end_key, continue_key, results[1], 200, result_count[1], t2);
+  ASSERT_EQ(100u, result_count[0]);
+  ASSERT_EQ(result_count[1], result_count[0]);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ((TID) & (words_[100 + i]), results[0][i]);
+    EXPECT_EQ(results[1][i], results[0][i]);
+  }
+
+  double mem[2] = {0, 0}, height[2] = {0, 0};
+  int cnt_N4[2] = {0, 0}, cnt_N16[2] = {0, 0}, cnt_N48[2] = {0, 0}, cnt_N256[2] = {0, 0};
+  uint64_t waste_child_mem[2] = {0, 0}, skip_prefix_mem[2] = {0, 0}, waste_prefix_mem[2] = {0, 0};
+  art_->traverse(mem[0], height[0], cnt_N4[0], cnt_N16[0], cnt_N48[0], cnt_N256[0], waste_child_mem[0],
+                 skip_prefix_mem[0], waste_prefix_mem[0]);
+  art_insert->traverse(mem[1], height[1], cnt_N4[1], cnt_N16[1], cnt_N48[1], cnt_N256[1], waste_child_mem[1],
+                       skip_prefix_mem[1], waste_prefix_mem[1]);
+  EXPECT_EQ(cnt_N4[1], cnt_N4[0]);
+  EXPECT_EQ(cnt_N16[1], cnt_N16[0]);
+  EXPECT_EQ(cnt_N48[1], cnt_N48[0]);
+  EXPECT_EQ(cnt_N256[1], cnt_N256[0]);
+  EXPECT_EQ(skip_prefix_mem[1], skip_prefix_mem[0]);
+  EXPECT_DOUBLE_EQ(height[1], height[0]);
+  delete art_insert;
+  delete art_;
+}
+
+TEST_F(ARTUnitTest, bulkLoadInvalidKeysTest) {
+  // duplicates, prefixes of the next key, out-of-order and empty keys are
+  // dropped instead of read past their end
+  std::vector<std::string> keys = {"", "ab", "abc", "abc", "abd", "abcz", "b", "ba", "bb"};
+  std::vector<TID> tids;
+  for (int i = 0; i < (int)keys.size(); i++) tids.push_back((TID) & (keys[i]));
+  art_ = new ART_ROWEX::Tree(loadKey, tids.data(), tids.size());
+  EXPECT_EQ(5u, art_->getBulkLoadSkipped());
+  auto t = art_->getThreadInfo();
+  const int kept[] = {2, 4, 7, 8};
+  for (int i : kept) {
+    Key key;
+    loadKey((TID) & (keys[i]), key);
+    EXPECT_EQ((TID) & (keys[i]), art_->lookup(key, t));
+  }
+  delete art_;
+}
+
+TEST_F(ARTUnitTest, inlineLeafKeyTest) {
+  // words of up to maxInlineKeyLength bytes live in their leaves; longer
+  // ones are still loaded through loadKey
+  art_ = new ART_ROWEX::Tree(loadKey, true);
+  auto t = art_->getThreadInfo();
+  for (int i = 0; i < (int)words_.size(); i++) {
+    Key key;
+    loadKey((TID) & (words_[i]), key);
+    art_->insert(key, (TID) & (words_[i]), t);
+  }
+  for (int i = 0; i < (int)words_.size(); i++) {
+    std::string word_copy = words_[i];
+    Key key;
+    loadKey((TID)&word_copy, key);
+    ASSERT_EQ((TID) & (words_[i]), art_->lookup(key, t));
+  }
+  std::string absent_str = words_[0] + "\x01";
+  Key absent_key;
+  loadKey((TID)&absent_str, absent_key);
+  EXPECT_EQ(0u, art_->lookup(absent_key, t));
+
+  Key start_key, end_key, continue_key;
+  loadKey((TID) & (words_[100]), start_key);
+  loadKey((TID) & (words_[200]), end_key);
+  TID results[200];
+  std::size_t result_count = 0;
+  art_->lookupRange(start_key, end_key, continue_key, results, 200, result_count, t);
+  ASSERT_EQ(100u, result_count);
+  for (int i = 0; i < 100; i++) EXPECT_EQ((TID) & (words_[100 + i]), results[i]);
+
+  for (int i = 0; i < (int)words_.size(); i += 2) {
+    Key key;
+    loadKey((TID) & (words_[i]), key);
+    art_->remove(key, (TID) & (words_[i]), t);
+  }
+  for (int i = 0; i < (int)words_.size(); i++) {
+    Key key;
+    loadKey((TID) & (words_[i]), key);
+    ASSERT_EQ((i % 2 == 0) ? 0u : (TID) & (words_[i]), art_->lookup(key, t));
+  }
+  delete art_;
+
+  std::vector<TID> tids;
+  for (int i = 0; i < (int)words_.size(); i++) tids.push_back((TID) & (words_[i]));
+  art_ = new ART_ROWEX::Tree(loadKey, tids.data(), tids.size(), true);
+  auto t_bulk = art_->getThreadInfo();
+  for (int i = 0; i < (int)words_.size(); i++) {
+    Key key;
+    loadKey((TID) & (words_[i]), key);
+    ASSERT_EQ((TID) & (words_[i]), art_->lookup(key, t_bulk));
+  }
+  delete art_;
+}
+
+TEST_F(ARTUnitTest, epocheReclamationTest) {
+  // repeated inserts and removes replace nodes and inline leaves; with a
+  // small ceiling the replaced nodes must be freed while the tree is in
+  // use, even though another thread holds a ThreadInfo and stays idle
+  static const std::size_t kMaxPendingBytes = 8 << 10;
+  art_ = new ART_ROWEX::Tree(loadKey, true);
+  art_->setMaxPendingBytes(kMaxPendingBytes);
+
+  std::atomic<bool> idle_ready(false), done(false);
+  std::thread idle_thread([&]() {
+    auto t_idle = art_->getThreadInfo();
+    Key key;
+    loadKey((TID) & (words_[0]), key);
+    art_->lookup(key, t_idle);
+    idle_ready.store(true);
+    while (!done.load()) std::this_thread::yield();
+  });
+  while (!idle_ready.load()) std::this_thread::yield();
+
+  auto t = art_->getThreadInfo();
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < (int)words_.size(); i++) {
+      Key key;
+      loadKey((TID) & (words_[i]), key);
+      art_->insert(key, (TID) & (words_[i]), t);
+    }
+    for (int i = 0; i < (int)words_.size(); i++) {
+      Key key;
+      loadKey((TID) & (words_[i]), key);
+      art_->remove(key, (TID) & (words_[i]), t);
+    }
+  }
+  done.store(true);
+  idle_thread.join();
+
+  ART::EpocheStats stats = art_->getEpocheStats();
+  // a writer checks the ceiling after each operation, which replaces at
+  // most a few nodes
+  EXPECT_LT(stats.peakPendingBytes, kMaxPendingBytes + 4096);
+  EXPECT_LE(stats.pendingBytes, kMaxPendingBytes);
+  EXPECT_GT(stats.forcedAdvances, 0u);
+  for (int i = 0; i < (int)words_.size(); i++) {
+    Key key;
+    loadKey((TID) & (words_[i]), key);
+    ASSERT_EQ(0u, art_->lookup(key, t));
+  }
+  delete art_;
+}
+
+// loadKey of stalled_tid blocks while stall_armed is set, so that a
+// lookup of it stays in its epoche
+static std::atomic<TID> stalled_tid(0);
+static std::atomic<bool> stall_armed(false), stall_entered(false);
+
+void stallingLoadKey(TID tid, Key &key) {
+  if (tid == stalled_tid.load() && stall_armed.load()) {
+    stall_entered.store(true);
+    while (stall_armed.load()) std::this_thread::yield();
+  }
+  loadKey(tid, key);
+}
+
+TEST_F(ARTUnitTest, epocheStalledReaderTest) {
+  // a reader that stays in its epoche holds every replaced node back;
+  // writers over the ceiling must still make progress
+  static const std::size_t kMaxPendingBytes = 8 << 10;
+  static const int kNumKeys = 20000;
+  art_ = new ART_ROWEX::Tree(stallingLoadKey);
+  art_->setMaxPendingBytes(kMaxPendingBytes);
+  auto t = art_->getThreadInfo();
+
+  // words start with printable bytes, so no writer reaches this leaf
+  static const std::string stalled_key = std::string(1, char(1)) + "stalled";
+  stalled_tid.store((TID) & stalled_key);
+  Key key;
+  loadKey((TID) & stalled_key, key);
+  art_->insert(key, (TID) & stalled_key, t);
+  stall_armed.store(true);
+  std::thread reader_thread([&]() {
+    auto t_reader = art_->getThreadInfo();
+    Key reader_key;
+    loadKey((TID) & stalled_key, reader_key);
+    art_->lookup(reader_key, t_reader);
+  });
+  while (!stall_entered.load()) std::this_thread::yield();
+
+  for (int i = 0; i < kNumKeys; i++) {
+    loadKey((TID) & (words_[i]), key);
+    art_->insert(key, (TID) & (words_[i]), t);
+  }
+  for (int i = 0; i < kNumKeys; i++) {
+    loadKey((TID) & (words_[i]), key);
+    art_->remove(key, (TID) & (words_[i]), t);
+  }
+  ART::EpocheStats stats = art_->getEpocheStats();
+  EXPECT_GT(stats.pendingBytes, kMaxPendingBytes);
+  EXPECT_GT(stats.stalls, 0u);
+  stall_armed.store(false);
+  reader_thread.join();
+  delete art_;
+}
+
 void loadWordList() {
   std::ifstream infile(kFilePath);
   std::string key;
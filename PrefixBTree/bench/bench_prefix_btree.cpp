@@ -95,6 +95,14 @@ std::ofstream output_insertlat_url_btree_range;
 static const std::string file_mem_url_btree_range = output_dir_btree_range + "mem_url_btree_range.csv";
 std::ofstream output_mem_url_btree_range;
 
+//-------------------------------------------------------------
+// Expt ID = 2
+//-------------------------------------------------------------
+static const std::string output_dir_btree_fanout = "results/prefixbtree/fanout/";
+// wkld_id,inner fanout,leaf fanout,encoder_type,insert latency,lookup latency,mem
+static const std::string file_fanout_btree = output_dir_btree_fanout + "fanout_btree.csv";
+std::ofstream output_fanout_btree;
+
 double getNow() {
   struct timeval tv;
   gettimeofday(&tv, 0);
@@ -197,6 +205,7 @@ void loadWorkload(int wkld_id, std::vector<std::string> &insert_keys, std::vecto
   std::cout << "scan_key_lens size = " << scan_key_lens.size() << std::endl;
 }
 
+template <class Fanout = prefixbtreeolc::DefaultFanout>
 void exec(const int expt_id, const int wkld_id, const bool is_point, const bool is_compressed, const int encoder_type,
           const int64_t dict_size_id, const std::vector<std::string> &insert_keys,
           const std::vector<std::string> &insert_keys_sample, const std::vector<std::string> &txn_keys,
@@ -236,7 +245,7 @@ void exec(const int expt_id, const int wkld_id, const bool is_point, const bool
     enc_insert_keys.push_back(std::make_pair(insert_keys[i], encode_str));
   }
 
-  auto bt = new prefixbtreeolc::BTree<int64_t>();
+  auto bt = new prefixbtreeolc::BTree<int64_t, Fanout>();
   std::cout << enc_insert_keys.size() << "*" << std::endl;
   double insert_start_time = getNow();
   for (int i = 0; i < (int)enc_insert_keys.size(); i++) {
@@ -357,6 +366,9 @@ void exec(const int expt_id, const int wkld_id, const bool is_point, const bool
       output_insertlat_url_btree_range << insert_lat << "\n";
       output_mem_url_btree_range << mem << "\n";
     }
+  } else if (expt_id == 2) {
+    output_fanout_btree << wkld_id << "," << Fanout::MaxEntries << "," << Fanout::MaxLeafEntries << ","
+                        << encoder_type << "," << insert_lat << "," << lookup_lat << "," << mem << "\n";
   }
 }
 
@@ -468,6 +480,28 @@ void exec_group(const int expt_id, const bool is_point, int &expt_num, const int
   }
 }
 
+// Point queries on raw and on 3-Grams encoded keys, for each node size preset
+void exec_fanout(const int wkld_id, int &expt_num, const int total_num_expt, const std::vector<std::string> &insert_keys,
+                 const std::vector<std::string> &insert_keys_sample, const std::vector<std::string> &txn_keys,
+                 const std::vector<int> &scan_key_lens) {
+  for (int is_compressed = 0; is_compressed < 2; is_compressed++) {
+    int encoder_type = is_compressed ? 3 : 0;
+    int dict_size_id = is_compressed ? 6 : 0;
+    std::cout << "-------------" << expt_num++ << "/" << total_num_expt << "--------------" << std::endl;
+    exec<prefixbtreeolc::DefaultFanout>(2, wkld_id, true, is_compressed, encoder_type, dict_size_id, insert_keys,
+                                        insert_keys_sample, txn_keys, scan_key_lens);
+    std::cout << "-------------" << expt_num++ << "/" << total_num_expt << "--------------" << std::endl;
+    exec<prefixbtreeolc::Fanout256B>(2, wkld_id, true, is_compressed, encoder_type, dict_size_id, insert_keys,
+                                     insert_keys_sample, txn_keys, scan_key_lens);
+    std::cout << "-------------" << expt_num++ << "/" << total_num_expt << "--------------" << std::endl;
+    exec<prefixbtreeolc::Fanout1KB>(2, wkld_id, true, is_compressed, encoder_type, dict_size_id, insert_keys,
+                                    insert_keys_sample, txn_keys, scan_key_lens);
+    std::cout << "-------------" << expt_num++ << "/" << total_num_expt << "--------------" << std::endl;
+    exec<prefixbtreeolc::Fanout4KB>(2, wkld_id, true, is_compressed, encoder_type, dict_size_id, insert_keys,
+                                    insert_keys_sample, txn_keys, scan_key_lens);
+  }
+}
+
 int main(int argc, char *argv[]) {
   int expt_id = (int)atoi(argv[1]);
   kRunALM = (int)atoi(argv[2]);
@@ -627,6 +661,27 @@ int main(int argc, char *argv[]) {
       output_insertlat_url_btree_range.close();
       output_mem_url_btree_range.close();
     }
+  } else if (expt_id == 2) {
+    //-------------------------------------------------------------
+    // Node Fanout Sweep; Expt ID = 2
+    //-------------------------------------------------------------
+    std::cout << "====================================" << std::endl;
+    std::cout << "Node Fanout Sweep; Expt ID = 2" << std::endl;
+    std::cout << "====================================" << std::endl;
+
+    output_fanout_btree.open(file_fanout_btree, std::ofstream::app);
+    int expt_num = 1;
+    int total_num_expt = 24;
+    if (kRunEmail)
+      exec_fanout(kEmail, expt_num, total_num_expt, insert_emails, insert_emails_sample, txn_emails,
+                  upper_bound_emails);
+    if (kRunWiki)
+      exec_fanout(kWiki, expt_num, total_num_expt, insert_wikis, insert_wikis_sample, txn_wikis, upper_bound_wikis);
+    if (kRunUrl)
+      exec_fanout(kUrl, expt_num, total_num_expt, insert_urls, insert_urls_sample, txn_urls, upper_bound_urls);
+    output_fanout_btree << "-"
+                        << "\n";
+    output_fanout_btree.close();
   }
   return 0;
 }
@@ -0,0 +1,109 @@
+#include <sys/time.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "PrefixBtree.h"
+#include "encoder_factory.hpp"
+
+//-------------------------------------------------------------
+// Insert microbenchmark: the same key set is inserted in sorted,
+// reverse-sorted and random order. Random inserts keep shrinking leaf
+// prefixes, which is the expensive path for long keys such as URLs.
+// Bulk loading the sorted keys is timed for comparison.
+//-------------------------------------------------------------
+static const uint64_t kNumRecords = 10000000;
+static const int kDictSizeLimit = 65536;
+static const int kSamplePercent = 10;
+
+double getNow() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+void loadKeysFromFile(const std::string &file_name, const uint64_t num_records, std::vector<std::string> &keys) {
+  std::ifstream infile(file_name);
+  std::string key;
+  uint64_t count = 0;
+  while (count < num_records && infile >> key) {
+    keys.push_back(key);
+    count++;
+  }
+}
+
+void runInserts(const std::string &order, const std::vector<std::string> &keys) {
+  prefixbtreeolc::BTree<int64_t> *bt = new prefixbtreeolc::BTree<int64_t>();
+  double start_time = getNow();
+  for (int i = 0; i < (int)keys.size(); i++) {
+    prefixbtreeolc::Key key;
+    key.setKeyStr(keys[i].c_str(), keys[i].length());
+    bt->insert(key, (int64_t)i);
+  }
+  double insert_time = getNow() - start_time;
+
+  start_time = getNow();
+  int64_t found = 0;
+  for (int i = 0; i < (int)keys.size(); i++) {
+    prefixbtreeolc::Key key;
+    key.setKeyStr(keys[i].c_str(), keys[i].length());
+    int64_t re;
+    found += bt->lookup(key, re);
+  }
+  double lookup_time = getNow() - start_time;
+
+  std::cout << order << ": insert = " << insert_time * 1000000000 / keys.size() << " ns/op"
+            << ", lookup = " << lookup_time * 1000000000 / keys.size() << " ns/op"
+            << ", found = " << found << std::endl;
+  delete bt;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cout << "Usage: " << argv[0] << " <key file> [num keys] [encoder type, 0 = raw keys]" << std::endl;
+    return -1;
+  }
+  std::string file_name = argv[1];
+  uint64_t num_records = (argc > 2) ? atoll(argv[2]) : kNumRecords;
+  int encoder_type = (argc > 3) ? atoi(argv[3]) : 0;
+
+  std::vector<std::string> keys;
+  loadKeysFromFile(file_name, num_records, keys);
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  if (encoder_type > 0) {
+    std::vector<std::string> sample_keys;
+    for (int i = 0; i < (int)keys.size(); i += 100 / kSamplePercent) sample_keys.push_back(keys[i]);
+    hope::Encoder *encoder = hope::EncoderFactory::createEncoder(encoder_type);
+    encoder->build(sample_keys, kDictSizeLimit);
+    uint8_t buffer[8192];
+    for (int i = 0; i < (int)keys.size(); i++) {
+      int enc_len = encoder->encode(keys[i], buffer);
+      keys[i] = std::string((const char *)buffer, (enc_len + 7) >> 3);
+    }
+    delete encoder;
+    // encoding is order-preserving, but padding may merge keys
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  }
+  std::cout << "keys = " << keys.size() << std::endl;
+
+  std::vector<int64_t> values;
+  for (int i = 0; i < (int)keys.size(); i++) values.push_back(i);
+  prefixbtreeolc::BTree<int64_t> *bt = new prefixbtreeolc::BTree<int64_t>();
+  double start_time = getNow();
+  bt->bulkLoad(keys, values);
+  std::cout << "bulk load: " << (getNow() - start_time) * 1000000000 / keys.size() << " ns/key" << std::endl;
+  delete bt;
+
+  runInserts("sorted", keys);
+  std::reverse(keys.begin(), keys.end());
+  runInserts("reverse", keys);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(0));
+  runInserts("random", keys);
+  return 0;
+}
@@ -0,0 +1,185 @@
+#include <sys/time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PrefixBtree.h"
+#include "encoder_factory.hpp"
+
+//-------------------------------------------------------------
+// Multi-threaded YCSB-style workloads on the OLC prefix B+tree.
+// Half of the keys are loaded first; each operation then encodes
+// its raw key with the shared encoder and runs a lookup, an insert
+// of a key not loaded yet, or a scan of 1-100 keys. Every workload
+// is run with 1, 2, 4, ... threads on a freshly loaded tree
+//-------------------------------------------------------------
+static const uint64_t kNumRecords = 10000000;
+static const uint64_t kNumTxns = 10000000;
+static const int kMaxThreads = 8;
+static const int kDictSizeLimit = 65536;
+static const int kSamplePercent = 10;
+static const int kMaxScanLen = 100;
+
+struct Workload {
+  const char *name;
+  int read_percent;
+  int insert_percent;  // the rest are scans
+};
+
+static const Workload kWorkloads[] = {
+    {"read-only", 100, 0}, {"95/5 read/insert", 95, 5}, {"50/50 read/insert", 50, 50}, {"scan-heavy", 0, 5}};
+
+double getNow() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+void loadKeysFromFile(const std::string &file_name, const uint64_t num_records, std::vector<std::string> &keys) {
+  std::ifstream infile(file_name);
+  std::string key;
+  uint64_t count = 0;
+  while (count < num_records && infile >> key) {
+    keys.push_back(key);
+    count++;
+  }
+}
+
+// Raw keys are used as they are
+void encodeKey(const hope::Encoder *encoder, const std::string &key, uint8_t *buffer, prefixbtreeolc::Key &enc_key) {
+  if (encoder == nullptr) {
+    enc_key.setKeyStr(key.c_str(), key.length());
+    return;
+  }
+  int enc_len = encoder->encode(key, buffer);
+  enc_key.setKeyStr((const char *)buffer, (enc_len + 7) >> 3);
+}
+
+void runWorkload(const Workload &workload, const int num_threads, const hope::Encoder *encoder,
+                 const std::vector<std::string> &keys, const uint64_t num_txns) {
+  uint64_t num_loaded = keys.size() / 2;
+  prefixbtreeolc::BTree<int64_t> *bt = new prefixbtreeolc::BTree<int64_t>();
+  {
+    uint8_t buffer[8192];
+    for (uint64_t i = 0; i < num_loaded; i++) {
+      prefixbtreeolc::Key key;
+      encodeKey(encoder, keys[i], buffer, key);
+      bt->insert(key, (int64_t)i);
+    }
+  }
+
+  uint64_t ops_per_thread = num_txns / num_threads;
+  std::vector<std::thread> threads;
+  std::vector<double> thread_tput(num_threads, 0);
+  std::vector<uint64_t> thread_sum(num_threads, 0);
+  std::atomic<int> num_ready(0);
+  std::atomic<bool> start(false);
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.push_back(std::thread([&, tid]() {
+      std::mt19937 gen(tid);
+      std::uniform_int_distribution<uint64_t> key_dist(0, num_loaded - 1);
+      std::uniform_int_distribution<int> op_dist(0, 99);
+      std::uniform_int_distribution<int> scan_len_dist(1, kMaxScanLen);
+      uint8_t buffer[8192];
+      int64_t result[kMaxScanLen];
+      // each thread inserts its own share of the keys not loaded yet
+      uint64_t next_insert = num_loaded + tid;
+      uint64_t sum = 0;
+
+      num_ready++;
+      while (!start.load()) {
+      }
+      double start_time = getNow();
+      for (uint64_t i = 0; i < ops_per_thread; i++) {
+        int op = op_dist(gen);
+        prefixbtreeolc::Key key;
+        if (op >= workload.read_percent && op < workload.read_percent + workload.insert_percent &&
+            next_insert < keys.size()) {
+          encodeKey(encoder, keys[next_insert], buffer, key);
+          bt->insert(key, (int64_t)next_insert);
+          next_insert += num_threads;
+          continue;
+        }
+        encodeKey(encoder, keys[key_dist(gen)], buffer, key);
+        // once a thread has inserted its share, its inserts become lookups
+        if (op < workload.read_percent + workload.insert_percent) {
+          sum += (int)bt->lookup(key, result[0]);
+        } else {
+          sum += bt->scan(key, scan_len_dist(gen), result);
+        }
+      }
+      thread_tput[tid] = ops_per_thread / (getNow() - start_time) / 1000000;
+      thread_sum[tid] = sum;
+    }));
+  }
+  while (num_ready.load() < num_threads) {
+  }
+  double start_time = getNow();
+  start.store(true);
+  for (int tid = 0; tid < num_threads; tid++) threads[tid].join();
+  double tput = ops_per_thread * num_threads / (getNow() - start_time) / 1000000;
+
+  uint64_t sum = 0;
+  for (int tid = 0; tid < num_threads; tid++) sum += thread_sum[tid];
+  std::cout << workload.name << ": threads = " << num_threads << ", total = " << tput << " Mops/s, per thread =";
+  for (int tid = 0; tid < num_threads; tid++) std::cout << " " << thread_tput[tid];
+  std::cout << " Mops/s (results = " << sum << ")" << std::endl;
+  delete bt;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cout << "Usage: " << argv[0] << " <key file> [num keys] [encoder type, 0 = raw keys] [max threads]"
+              << std::endl;
+    return -1;
+  }
+  std::string file_name = argv[1];
+  uint64_t num_records = (argc > 2) ? atoll(argv[2]) : kNumRecords;
+  int encoder_type = (argc > 3) ? atoi(argv[3]) : 0;
+  int max_threads = (argc > 4) ? atoi(argv[4]) : kMaxThreads;
+
+  std::vector<std::string> keys;
+  loadKeysFromFile(file_name, num_records, keys);
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  // one encoder shared by all threads; encoding is const
+  hope::Encoder *encoder = nullptr;
+  if (encoder_type > 0) {
+    std::vector<std::string> sample_keys;
+    for (int i = 0; i < (int)keys.size(); i += 100 / kSamplePercent) sample_keys.push_back(keys[i]);
+    encoder = hope::EncoderFactory::createEncoder(encoder_type);
+    encoder->build(sample_keys, kDictSizeLimit);
+
+    // padding may make encoded keys collide; keep one raw key per encoding
+    std::vector<std::pair<std::string, std::string> > enc_pairs;
+    uint8_t buffer[8192];
+    for (int i = 0; i < (int)keys.size(); i++) {
+      int enc_len = encoder->encode(keys[i], buffer);
+      enc_pairs.push_back(std::make_pair(std::string((const char *)buffer, (enc_len + 7) >> 3), keys[i]));
+    }
+    std::sort(enc_pairs.begin(), enc_pairs.end());
+    keys.clear();
+    for (int i = 0; i < (int)enc_pairs.size(); i++) {
+      if (i > 0 && enc_pairs[i].first == enc_pairs[i - 1].first) continue;
+      keys.push_back(enc_pairs[i].second);
+    }
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(0));
+  uint64_t num_txns = std::min(kNumTxns, (uint64_t)keys.size());
+  std::cout << "keys = " << keys.size() << ", txns per run = " << num_txns << std::endl;
+
+  for (const Workload &workload : kWorkloads) {
+    for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+      runWorkload(workload, num_threads, encoder, keys, num_txns);
+    }
+  }
+  delete encoder;
+  return 0;
+}
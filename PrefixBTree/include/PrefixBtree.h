@@ -5,11 +5,14 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <cstring>
+#include <mutex>
 #include <queue>
 #include <stack>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace prefixbtreeolc {
 
@@ -20,6 +23,19 @@ static const int MaxEntries = 8;
 static const int MaxLeafEntries = 8;
 static int64_t leaf_waste_byte = 0;
 
+// Maximum entries per inner and leaf node
+template <int InnerEntries, int LeafEntries>
+struct NodeFanout {
+  static const int MaxEntries = InnerEntries;
+  static const int MaxLeafEntries = LeafEntries;
+};
+
+typedef NodeFanout<MaxEntries, MaxLeafEntries> DefaultFanout;
+// Nodes of about 256 B, 1 KB and 4 KB with 8-byte payloads
+typedef NodeFanout<12, 9> Fanout256B;
+typedef NodeFanout<55, 44> Fanout1KB;
+typedef NodeFanout<226, 184> Fanout4KB;
+
 struct OptLock {
   std::atomic<uint64_t> typeVersionLockObsolete{0b100};
 
@@ -75,13 +91,184 @@ struct BTreeLeafBase : public NodeBase {
   static const PageType typeMarker = PageType::BTreeLeaf;
 };
 
+// Epoch-based reclamation of leaf key areas and key buffers. Optimistic
+// readers may still read through a key area pointer after a writer
+// replaced it, so replaced areas are retired here instead of freed. Every tree operation announces
+// the global epoch in its thread's slot while it runs; an area is freed
+// once every running operation announced a later epoch than the one the
+// area was retired in.
+class KeyAreaEpoch {
+ public:
+  static const int MaxThreads = 1024;
+  // retired areas are scanned for freeing in batches of this size
+  static const size_t RetireBatch = 64;
+
+  static KeyAreaEpoch &instance() {
+    static KeyAreaEpoch epoch;
+    return epoch;
+  }
+
+  // scope of one tree operation; may nest
+  class Guard {
+   public:
+    Guard() { instance().enter(); }
+    ~Guard() { instance().exit(); }
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+  };
+
+  void retire(char *area) {
+    // the replacing pointer is visible before the slots are read
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::lock_guard<std::mutex> lock(mutex_);
+    retired_.emplace_back(global_epoch_.load(), area);
+    if (retired_.size() < RetireBatch) return;
+    global_epoch_.fetch_add(1);
+    uint64_t min_epoch = UINT64_MAX;
+    int num_slots = num_slots_.load();
+    for (int i = 0; i < num_slots; i++) {
+      uint64_t epoch = slots_[i].epoch.load();
+      if (epoch != 0 && epoch < min_epoch) min_epoch = epoch;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < retired_.size(); i++) {
+      if (retired_[i].first < min_epoch)
+        delete[] retired_[i].second;
+      else
+        retired_[kept++] = retired_[i];
+    }
+    retired_.resize(kept);
+  }
+
+  ~KeyAreaEpoch() {
+    for (size_t i = 0; i < retired_.size(); i++) delete[] retired_[i].second;
+  }
+
+ private:
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> epoch{0};  // 0 while the thread is outside the trees
+    std::atomic<bool> used{false};
+  };
+
+  // a thread's slot, released when the thread exits
+  struct ThreadSlot {
+    int index = -1;
+    int depth = 0;
+    ~ThreadSlot() {
+      if (index >= 0) instance().slots_[index].used.store(false);
+    }
+  };
+
+  static ThreadSlot &threadSlot() {
+    static thread_local ThreadSlot slot;
+    return slot;
+  }
+
+  void enter() {
+    ThreadSlot &t = threadSlot();
+    if (t.depth++ > 0) return;
+    if (t.index < 0) t.index = acquireSlot();
+    slots_[t.index].epoch.store(global_epoch_.load());
+    // the announcement is visible before any key area pointer is read
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  void exit() {
+    ThreadSlot &t = threadSlot();
+    if (--t.depth == 0) slots_[t.index].epoch.store(0, std::memory_order_release);
+  }
+
+  int acquireSlot() {
+    while (true) {
+      for (int i = 0; i < MaxThreads; i++) {
+        bool expected = false;
+        if (!slots_[i].used.load() && slots_[i].used.compare_exchange_strong(expected, true)) {
+          int num_slots = num_slots_.load();
+          while (num_slots < i + 1 && !num_slots_.compare_exchange_weak(num_slots, i + 1)) {
+          }
+          return i;
+        }
+      }
+      sched_yield();
+    }
+  }
+
+  Slot slots_[MaxThreads];
+  // slots [0, num_slots_) have been used
+  std::atomic<int> num_slots_{0};
+  std::atomic<uint64_t> global_epoch_{1};
+  std::mutex mutex_;
+  std::vector<std::pair<uint64_t, char *>> retired_;
+};
+
+// A key part borrowed from a node
+struct KeyView {
+  const char *str;
+  uint16_t len;
+};
+
+
+// Keys are read by optimistic readers while a writer changes them. Once a
+// key has moved to a heap buffer it stays there, and a buffer is only
+// replaced by a larger one, which is published before the new length; a
+// reader that loads the length first (view()) never reads past the
+// buffer it then sees. Replaced buffers are retired through KeyAreaEpoch.
 class Key {
  private:
+  static const uint16_t OverFlowFlag = 1 << 15;
+  // a heap buffer starts with its capacity, like a leaf's heap key area
+  static const uint32_t OverFlowHeader = sizeof(uint32_t);
+
   // if prefix is too long
   // key stores the pointer to the prefix
-  char key[POINTER_SIZE];
+  alignas(POINTER_SIZE) char key[POINTER_SIZE];
+  // length, and OverFlowFlag while key holds a heap buffer
   uint16_t part_len_;
 
+  uint16_t loadPartLen() const { return __atomic_load_n(&part_len_, __ATOMIC_ACQUIRE); }
+
+  void storePartLen(uint16_t part_len) { __atomic_store_n(&part_len_, part_len, __ATOMIC_RELEASE); }
+
+  static char *newOverFlowStr(uint32_t cap) {
+    char *str = new char[OverFlowHeader + cap] + OverFlowHeader;
+    memcpy(str - OverFlowHeader, &cap, sizeof(uint32_t));
+    return str;
+  }
+
+  static uint32_t overFlowCapacity(const char *str) {
+    uint32_t cap;
+    memcpy(&cap, str - OverFlowHeader, sizeof(uint32_t));
+    return cap;
+  }
+
+  // Sets the key to head[0, head_len) + its own bytes [keep_from,
+  // keep_from + keep_len) + tail[0, tail_len), in place when that fits.
+  // head and tail must not point into this key.
+  void splice(const char *head, uint16_t head_len, uint16_t keep_from, uint16_t keep_len, const char *tail,
+              uint16_t tail_len) {
+    uint16_t new_len = head_len + keep_len + tail_len;
+    assert(new_len < OverFlowFlag);
+    uint16_t flag = part_len_ & OverFlowFlag;
+    char *bytes = flag ? const_cast<char *>(getOverFlowStr()) : key;
+    uint32_t cap = flag ? overFlowCapacity(bytes) : POINTER_SIZE;
+    if (new_len <= cap) {
+      // readers may see torn bytes, which fail their validation, but never
+      // a length beyond this buffer
+      memmove(bytes + head_len, bytes + keep_from, keep_len);
+      memcpy(bytes, head, head_len);
+      memcpy(bytes + head_len + keep_len, tail, tail_len);
+      storePartLen(new_len | flag);
+      return;
+    }
+    char *str = newOverFlowStr(new_len);
+    memcpy(str, head, head_len);
+    memcpy(str + head_len, bytes + keep_from, keep_len);
+    memcpy(str + head_len + keep_len, tail, tail_len);
+    __atomic_store_n(reinterpret_cast<char **>(key), str, __ATOMIC_RELEASE);
+    storePartLen(new_len | OverFlowFlag);
+    if (flag) KeyAreaEpoch::instance().retire(bytes - OverFlowHeader);
+  }
+
  public:
   Key() {
     part_len_ = 0;
@@ -95,14 +282,24 @@ class Key {
     setKeyStr(right.getKeyStr(), right.getLen());
   }
 
+  // Copies into this key's own storage. A key in a node keeps its buffer
+  // for readers, so there is no move assignment.
   Key &operator=(const Key &right) {
-    setKeyStr(right.getKeyStr(), right.getLen());
+    if (this != &right) setKeyStr(right.getKeyStr(), right.getLen());
     return *this;
   }
 
+  // a new key takes over the overflow buffer, leaving right empty
+  Key(Key &&right) {
+    memcpy(key, right.key, POINTER_SIZE);
+    part_len_ = right.part_len_;
+    right.part_len_ = 0;
+  }
+
+  // keys are only destroyed with their node, or are private to a thread
   ~Key() {
-    if (part_len_ > POINTER_SIZE) {
-      delete[](getOverFlowStr());
+    if (isOverFlow()) {
+      delete[](getOverFlowStr() - OverFlowHeader);
       part_len_ = 0;
     }
   }
@@ -116,27 +313,13 @@ class Key {
     }
   }
 
-  void setOverFlow() {
-    uint16_t mask = 1 << (sizeof(uint16_t) * 8 - 1);
-    part_len_ |= mask;
-  }
-
-  void clearOverFlow() {
-    uint16_t mask = (1 << (sizeof(uint16_t) * 8 - 1)) - 1;
-    part_len_ &= mask;
-  }
+  bool isOverFlow() const { return (loadPartLen() & OverFlowFlag) > 0; }
 
-  bool isOverFlow() const {
-    uint16_t mask = 1 << (sizeof(uint16_t) * 8 - 1);
-    return (part_len_ & mask) > 0;
+  const char *getOverFlowStr() const {
+    return __atomic_load_n(reinterpret_cast<char *const *>(key), __ATOMIC_ACQUIRE);
   }
 
-  const char *getOverFlowStr() const { return *reinterpret_cast<const char *const *>(key); }
-
-  uint16_t getLen() const {
-    uint16_t mask = (1 << (sizeof(uint16_t) * 8 - 1)) - 1;
-    return part_len_ & mask;
-  }
+  uint16_t getLen() const { return loadPartLen() & ~OverFlowFlag; }
 
   Key concate(Key &right) {
     Key new_key;
@@ -153,58 +336,31 @@ class Key {
     return new_key;
   }
 
-  void setLen(uint16_t new_len) {
-    part_len_ = new_len;
-    if (new_len > POINTER_SIZE) setOverFlow();
-  }
-
   int64_t getSize() {  // in bytes
     int64_t re = POINTER_SIZE + sizeof(uint16_t);
-    if (isOverFlow()) re += getLen();
+    if (isOverFlow()) re += OverFlowHeader + overFlowCapacity(getOverFlowStr());
     return re;
   }
 
   void chunkToLength(uint16_t new_len) {
-    if (getLen() > POINTER_SIZE && new_len <= POINTER_SIZE) {
-      const char *overflow_str = getOverFlowStr();
-      memcpy(key, overflow_str, new_len);
-      delete[] overflow_str;
-    }
-    setLen(new_len);
+    assert(new_len <= getLen());
+    splice("", 0, 0, new_len, "", 0);
   }
 
-  void setKeyStr(const char *str, uint16_t len) {
-    assert(getLen() < (1 << 15));
-    if (isOverFlow()) {
-      delete[](getOverFlowStr());
-      part_len_ = 0;
-    }
+  void setKeyStr(const char *str, uint16_t len) { splice(str, len, 0, 0, "", 0); }
 
-    if (len > POINTER_SIZE) {
-      char *overflow_key = new char[len];
-      memcpy(overflow_key, str, len);
-      memcpy(key, &overflow_key, POINTER_SIZE);
-    } else {
-      memcpy(key, str, len);
-    }
-    setLen(len);
-  }
+  const char *getKeyStr() const { return isOverFlow() ? getOverFlowStr() : key; }
 
-  const char *getKeyStr() const {
-    if (getLen() > POINTER_SIZE) {
-      return getOverFlowStr();
-    }
-    return key;
+  // the length, then the bytes, as one consistent pair for readers
+  KeyView view() const {
+    uint16_t len = getLen();
+    return KeyView{getKeyStr(), len};
   }
 
-  int charStrCmp(const char *s1, int len1, const char *s2, int len2) {
+  static int charStrCmp(const char *s1, int len1, const char *s2, int len2) {
     int len = std::min(len1, len2);
-    for (int i = 0; i < len; i++) {
-      uint8_t c1 = static_cast<uint8_t>(s1[i]);
-      uint8_t c2 = static_cast<uint8_t>(s2[i]);
-      if (c1 < c2) return -1;
-      if (c1 > c2) return 1;
-    }
+    int cmp = memcmp(s1, s2, len);
+    if (cmp != 0) return (cmp < 0) ? -1 : 1;
     if (len1 < len2)
       return -1;
     else if (len1 == len2)
@@ -213,30 +369,34 @@ class Key {
       return 1;
   }
 
-  int compare(Key &right, Key &prefix) {
-    uint16_t mylen = getLen();
-    uint16_t prefix_len = prefix.getLen();
-    const char *cur_str = getKeyStr();
-    const char *prefix_str = prefix.getKeyStr();
-
-    if (mylen < prefix_len) {
-      return charStrCmp(cur_str, mylen, prefix_str, prefix_len);
-    } else if (mylen == prefix_len) {
-      int cmp = charStrCmp(cur_str, mylen, prefix_str, prefix_len);
+  // Compares a full key str[0, len) against the node key prefix + part,
+  // working on borrowed bytes only
+  static int compare(const char *str, uint16_t len, const char *part, uint16_t part_len, const char *prefix,
+                     uint16_t prefix_len) {
+    if (len < prefix_len) {
+      return charStrCmp(str, len, prefix, prefix_len);
+    } else if (len == prefix_len) {
+      int cmp = charStrCmp(str, len, prefix, prefix_len);
       if (cmp != 0) return cmp;
-      if (right.getLen() == 0) return 0;
+      if (part_len == 0) return 0;
       return -1;
-    } else {  // mylen > prefix_len
-      int cmp = charStrCmp(cur_str, prefix_len, prefix_str, prefix_len);
+    } else {  // len > prefix_len
+      int cmp = charStrCmp(str, prefix_len, prefix, prefix_len);
       if (cmp == 0) {
-        int right_len = right.getLen();
-        return charStrCmp(cur_str + prefix_len, mylen - prefix_len, right.getKeyStr(), right_len);
+        return charStrCmp(str + prefix_len, len - prefix_len, part, part_len);
       } else
         return cmp;
     }
   }
 
-  uint16_t commonPrefix(Key &right) {
+  int compare(const Key &right, const Key &prefix) const {
+    KeyView my_view = view();
+    KeyView right_view = right.view();
+    KeyView prefix_view = prefix.view();
+    return compare(my_view.str, my_view.len, right_view.str, right_view.len, prefix_view.str, prefix_view.len);
+  }
+
+  uint16_t commonPrefix(const Key &right) const {
     uint16_t len = std::min(getLen(), right.getLen());
     const char *my_str = getKeyStr();
     const char *right_str = right.getKeyStr();
@@ -250,52 +410,11 @@ class Key {
     return i;
   }
 
-  void addTailChar(const char &new_c) {
-    uint16_t cur_len = getLen();
-    // already overflow
-    if (cur_len > POINTER_SIZE) {
-      char *overflow_key = *reinterpret_cast<char **>(key);
-      char *new_overflow_key = new char[cur_len + 1];
-      memcpy(new_overflow_key, overflow_key, cur_len);
-      new_overflow_key[cur_len] = new_c;
-      memcpy(key, &new_overflow_key, POINTER_SIZE);
-      delete[] overflow_key;
-    } else if (cur_len == POINTER_SIZE) {
-      // overflow
-      char *overflow_key = new char[POINTER_SIZE + 1];
-      overflow_key[cur_len] = new_c;
-      memcpy(overflow_key, key, POINTER_SIZE);
-      memcpy(key, &overflow_key, POINTER_SIZE);
-    } else {
-      // no overflow
-      key[cur_len] = new_c;
-    }
-    setLen(cur_len + 1);
-  }
-
-  void addHeadChar(const char &new_c) {
-    uint16_t cur_len = getLen();
-    // already overflow
-    if (cur_len > POINTER_SIZE) {
-      char *overflow_key = *reinterpret_cast<char **>(key);
-      char *new_overflow_key = new char[cur_len + 1];
-      memcpy(new_overflow_key + 1, overflow_key, cur_len);
-      new_overflow_key[0] = new_c;
-      delete[] overflow_key;
-      memcpy(key, &new_overflow_key, POINTER_SIZE);
-    } else if (cur_len == POINTER_SIZE) {
-      // overflow
-      char *overflow_key = new char[POINTER_SIZE + 1];
-      overflow_key[0] = new_c;
-      memcpy(overflow_key + 1, key, POINTER_SIZE);
-      memcpy(key, &overflow_key, POINTER_SIZE);
-    } else {
-      // no overflow
-      memmove(key + 1, key, cur_len);
-      key[0] = new_c;
-    }
-    setLen(cur_len + 1);
-  }
+  void addTail(const char *str, uint16_t len) { splice("", 0, 0, getLen(), str, len); }
+
+  void addTailChar(const char &new_c) { addTail(&new_c, 1); }
+
+  void addHeadChar(const char &new_c) { addHead(&new_c, 1); }
 
   void addHead(const Key &prefix) {
     uint16_t prefix_key_len = prefix.getLen();
@@ -303,66 +422,170 @@ class Key {
     addHeadChar(new_head_char);
   }
 
-  void removeHead() {
-    uint16_t key_len = getLen();
-    assert(key_len > 0);
-    if (key_len > POINTER_SIZE + 1) {
-      char *overflow_key = *reinterpret_cast<char **>(key);
-      memmove(overflow_key, overflow_key + 1, key_len - 1);
-    } else if (key_len == POINTER_SIZE + 1) {
-      char *overflow_key = *reinterpret_cast<char **>(key);
-      memcpy(key, overflow_key + 1, POINTER_SIZE);
-      delete[] overflow_key;
-    } else {
-      memmove(key, key + 1, key_len - 1);
-      key[key_len - 1] = '\0';
-    }
-    setLen(key_len - 1);
-  }
+  void removeHead() { chunkBeginning(1); }
+
+  // prepend str[0, len), with at most one allocation
+  void addHead(const char *str, uint16_t len) { splice(str, len, 0, getLen(), "", 0); }
 
   // remove the head number of bytes
   void chunkBeginning(uint16_t cnt) {
     uint16_t key_len = getLen();
     assert(cnt <= key_len);
-    for (int i = 0; i < cnt; i++) {
-      removeHead();
-    }
+    if (cnt == 0) return;
+    splice("", 0, cnt, key_len - cnt, "", 0);
   }
 };
 
-template <class Payload>
+// A short separator s with left <= s < right: right cut one byte past the
+// common prefix, or left itself when that cut is not shorter than both keys
+inline std::string shortestSeparator(const std::string &left, const std::string &right) {
+  unsigned prefix_len = 0;
+  while (prefix_len < left.size() && prefix_len < right.size() && left[prefix_len] == right[prefix_len])
+    prefix_len++;
+  if (prefix_len + 1 >= left.size() || prefix_len + 1 >= right.size()) return left;
+  return right.substr(0, prefix_len + 1);
+}
+
+template <class Payload, class Fanout = DefaultFanout>
 struct BTreeLeaf : public BTreeLeafBase {
+  static const int MaxLeafEntries = Fanout::MaxLeafEntries;
+  // Key suffixes are packed into this node-local area, and only move to
+  // a heap buffer when they outgrow it
+  static const uint32_t InlineKeyBytes = POINTER_SIZE * MaxLeafEntries;
+  // a heap key area starts with its capacity, so that a reader's single
+  // load of key_bytes_ also tells it how many bytes it may read
+  static const uint32_t KeyAreaHeader = sizeof(uint32_t);
+
   Key prefix_key_;
-  Key keys[MaxLeafEntries];
+  uint32_t key_offsets_[MaxLeafEntries];
+  uint16_t key_lens_[MaxLeafEntries];
   Payload payloads[MaxLeafEntries];
-
-  BTreeLeaf() {
+  uint32_t key_bytes_used_;
+  uint32_t key_bytes_cap_;
+  char *key_bytes_;
+  // right sibling, set by split
+  BTreeLeaf *next_;
+  char inline_key_bytes_[InlineKeyBytes];
+
+  BTreeLeaf() : key_bytes_used_(0), key_bytes_cap_(InlineKeyBytes), key_bytes_(inline_key_bytes_), next_(nullptr) {
     count = 0;
     type = typeMarker;
-    memset(keys, 0, sizeof(Key) * MaxEntries);
+    // searches in an empty leaf still read slot 0
+    key_offsets_[0] = 0;
+    key_lens_[0] = 0;
+  }
+
+  // leaves are only destroyed with the tree (or by bulkLoad), when no
+  // reader can see them, so the key area is freed right away
+  ~BTreeLeaf() {
+    if (key_bytes_ != inline_key_bytes_) delete[](key_bytes_ - KeyAreaHeader);
   }
 
   bool isFull() { return count == MaxLeafEntries; };
 
   int64_t getSize() {
     int64_t prefix_size = prefix_key_.getSize();
-    int64_t key_size = 0;
-    int64_t normal_key_size = POINTER_SIZE + sizeof(uint16_t);
+    int64_t slot_size = sizeof(uint32_t) + sizeof(uint16_t);
+    int64_t key_size = MaxLeafEntries * slot_size + InlineKeyBytes;
+    if (key_bytes_ != inline_key_bytes_) key_size += key_bytes_cap_;
+    leaf_waste_byte += (MaxLeafEntries - count) * slot_size + (key_bytes_cap_ - key_bytes_used_);
+    return key_size + sizeof(std::string) * MaxLeafEntries + prefix_size;
+  }
+
+  // capacity of bytes, this leaf's inline area or a heap key area
+  uint32_t keyAreaCapacity(const char *bytes) const {
+    if (bytes == inline_key_bytes_) return InlineKeyBytes;
+    uint32_t cap;
+    memcpy(&cap, bytes - KeyAreaHeader, sizeof(uint32_t));
+    return cap;
+  }
+
+  // one load of key_bytes_, for readers racing with repackKeys
+  const char *loadKeyBytes() const { return __atomic_load_n(&key_bytes_, __ATOMIC_ACQUIRE); }
+
+  // suffix of the key at pos, after prefix_key_
+  KeyView keyAt(unsigned pos) const { return KeyView{key_bytes_ + key_offsets_[pos], key_lens_[pos]}; }
+
+  std::string fullKey(unsigned pos) const {
+    std::string full_key(prefix_key_.getKeyStr(), prefix_key_.getLen());
+    full_key.append(key_bytes_ + key_offsets_[pos], key_lens_[pos]);
+    return full_key;
+  }
+
+  // Compares the full key str[0, len) against keys[pos]. An optimistic
+  // reader may see offsets that repackKeys already rewrote for another
+  // area, so the suffix is clamped to the area it loaded.
+  int compareAt(const char *str, uint16_t len, unsigned pos) const {
+    const char *bytes = loadKeyBytes();
+    uint32_t cap = keyAreaCapacity(bytes);
+    uint32_t offset = std::min(key_offsets_[pos], cap);
+    uint16_t part_len = std::min<uint32_t>(key_lens_[pos], cap - offset);
+    KeyView prefix = prefix_key_.view();
+    return Key::compare(str, len, bytes + offset, part_len, prefix.str, prefix.len);
+  }
+
+  // common prefix length of the (sorted) suffixes in [begin, end)
+  uint16_t commonPrefix(unsigned begin, unsigned end) const {
+    KeyView first = keyAt(begin);
+    KeyView last = keyAt(end - 1);
+    uint16_t len = std::min(first.len, last.len);
+    uint16_t i = 0;
+    while (i < len && first.str[i] == last.str[i]) i++;
+    return i;
+  }
+
+  // Rewrites the suffixes of keys [0, count) contiguously, each with
+  // head[0, head_len) prepended and its first skip bytes dropped, leaving
+  // room for extra more bytes
+  void repackKeys(const char *head, uint16_t head_len, uint16_t skip, uint32_t extra) {
+    uint32_t needed = 0;
+    for (int i = 0; i < count; i++) needed += head_len + key_lens_[i] - skip;
+    char stack_bytes[InlineKeyBytes];
+    bool fits_inline = (needed + extra <= InlineKeyBytes);
+    uint32_t cap = fits_inline ? InlineKeyBytes : 2 * (needed + extra);
+    char *bytes = stack_bytes;
+    if (!fits_inline) {
+      bytes = new char[KeyAreaHeader + cap] + KeyAreaHeader;
+      memcpy(bytes - KeyAreaHeader, &cap, sizeof(uint32_t));
+    }
+    uint32_t offset = 0;
     for (int i = 0; i < count; i++) {
-      key_size += keys[i].getSize();
+      uint16_t len = key_lens_[i] - skip;
+      if (head_len > 0) memcpy(bytes + offset, head, head_len);
+      memcpy(bytes + offset + head_len, key_bytes_ + key_offsets_[i] + skip, len);
+      key_offsets_[i] = offset;
+      key_lens_[i] = head_len + len;
+      offset += key_lens_[i];
     }
-    key_size += (MaxLeafEntries - count) * normal_key_size;
-    leaf_waste_byte += (MaxLeafEntries - count) * normal_key_size;
-    return key_size + sizeof(std::string) * MaxLeafEntries + prefix_size;
+    // optimistic readers may still read the old area
+    if (key_bytes_ != inline_key_bytes_) KeyAreaEpoch::instance().retire(key_bytes_ - KeyAreaHeader);
+    if (fits_inline) {
+      memcpy(inline_key_bytes_, stack_bytes, needed);
+      __atomic_store_n(&key_bytes_, static_cast<char *>(inline_key_bytes_), __ATOMIC_RELEASE);
+    } else {
+      __atomic_store_n(&key_bytes_, bytes, __ATOMIC_RELEASE);
+    }
+    key_bytes_cap_ = cap;
+    key_bytes_used_ = needed;
   }
 
-  unsigned insertBound(Key &k) {
+  // copies a suffix into the key area and returns its offset
+  uint32_t appendKeyBytes(const char *str, uint16_t len) {
+    if (key_bytes_used_ + len > key_bytes_cap_) repackKeys("", 0, 0, len);
+    uint32_t offset = key_bytes_used_;
+    memcpy(key_bytes_ + offset, str, len);
+    key_bytes_used_ += len;
+    return offset;
+  }
+
+  unsigned insertBound(const Key &k) const {
+    const char *str = k.getKeyStr();
+    uint16_t len = k.getLen();
     unsigned lower = 0;
     unsigned upper = count;
     do {
       unsigned mid = ((upper - lower) / 2) + lower;
-      Key mid_key = keys[mid];
-      int cmp = k.compare(mid_key, prefix_key_);
+      int cmp = compareAt(str, len, mid);
       if (cmp < 0) {
         upper = mid;
       } else if (cmp > 0) {
@@ -375,13 +598,14 @@ struct BTreeLeaf : public BTreeLeafBase {
   }
 
   // first index >= k
-  unsigned lowerBound(Key &k) {
+  unsigned lowerBound(const Key &k) const {
+    const char *str = k.getKeyStr();
+    uint16_t len = k.getLen();
     unsigned lower = 0;
     unsigned upper = count;
     do {
       unsigned mid = ((upper - lower) / 2) + lower;
-      Key mid_key = keys[mid];
-      int cmp = k.compare(mid_key, prefix_key_);
+      int cmp = compareAt(str, len, mid);
       if (cmp < 0) {
         upper = mid;
       } else if (cmp > 0) {
@@ -393,17 +617,18 @@ struct BTreeLeaf : public BTreeLeafBase {
     return lower;
   }
 
-  void insert(Key &k, Payload &p) {
+  void insert(const Key &k, const Payload &p) {
     assert(count + 1 <= MaxLeafEntries);
+    unsigned pos = 0;
+    uint16_t new_prefix_len = k.getLen();
     if (count) {
-      unsigned pos = insertBound(k);
+      pos = insertBound(k);
 
-      Key tmp_key = k;
       int cmp = 0;
-      if (pos >= count || tmp_key.getLen() < prefix_key_.getLen()) {
+      if (pos >= count || k.getLen() < prefix_key_.getLen()) {
         cmp = -1;
       } else {
-        cmp = tmp_key.compare(keys[pos], prefix_key_);
+        cmp = compareAt(k.getKeyStr(), k.getLen(), pos);
       }
       // only support one key one value, does not support one key multiple values
       // same value will overwrite the previous value with the same key
@@ -412,91 +637,78 @@ struct BTreeLeaf : public BTreeLeafBase {
         return;
       }
 
-      for (int i = count; i > (int)pos; i--) {
-        keys[i] = keys[i - 1];
-        payloads[i] = payloads[i - 1];
-      }
-
       // get common prefix of key and other keys
-      uint16_t new_prefix_len = k.commonPrefix(prefix_key_);
-      k.chunkBeginning(new_prefix_len);
-      keys[pos] = k;
-      payloads[pos] = p;
-      count++;
-      // decide if we need to modify all the other keys
-      if (new_prefix_len == prefix_key_.getLen()) {
-        // insert directly
-      } else {
-        // modify all the keys, add the last several bytes of prefix to those keys
-        assert(new_prefix_len < prefix_key_.getLen());
-        uint16_t prefix_len = prefix_key_.getLen();
-        for (int i = new_prefix_len; i < prefix_len; i++) {
-          for (int j = 0; j < count; j++) {
-            if (j == (int)pos) continue;
-            keys[j].addHead(prefix_key_);
-          }
-          prefix_key_.chunkToLength(prefix_key_.getLen() - 1);
-        }
+      new_prefix_len = k.commonPrefix(prefix_key_);
+      uint16_t prefix_len = prefix_key_.getLen();
+      if (new_prefix_len < prefix_len) {
+        // move the cut-off bytes of the prefix into every suffix
+        repackKeys(prefix_key_.getKeyStr() + new_prefix_len, prefix_len - new_prefix_len, 0,
+                   k.getLen() - new_prefix_len);
+        prefix_key_.chunkToLength(new_prefix_len);
       }
     } else {
       prefix_key_.setKeyStr(k.getKeyStr(), k.getLen());
-      k.setKeyStr("", 0);
-      keys[0] = k;
-      payloads[0] = p;
-      count++;
     }
+
+    uint16_t len = k.getLen() - new_prefix_len;
+    uint32_t offset = appendKeyBytes(k.getKeyStr() + new_prefix_len, len);
+    memmove(key_offsets_ + pos + 1, key_offsets_ + pos, sizeof(uint32_t) * (count - pos));
+    memmove(key_lens_ + pos + 1, key_lens_ + pos, sizeof(uint16_t) * (count - pos));
+    for (int i = count; i > (int)pos; i--) {
+      payloads[i] = payloads[i - 1];
+    }
+    key_offsets_[pos] = offset;
+    key_lens_[pos] = len;
+    payloads[pos] = p;
+    count++;
   }
 
   BTreeLeaf *split(Key &sep) {
     BTreeLeaf *newLeaf = new BTreeLeaf();
-    newLeaf->count = count - (count / 2);
-    count = count - newLeaf->count;
-    newLeaf->prefix_key_ = prefix_key_;
+    newLeaf->next_ = next_;
+    next_ = newLeaf;
+    uint16_t new_count = count - (count / 2);
+    count = count - new_count;
 
-    for (int i = 0; i < newLeaf->count; i++) {
-      newLeaf->keys[i] = keys[i + count];
-      keys[i + count] = Key();
-      newLeaf->payloads[i] = payloads[i + count];
+    // both halves extend the prefix by the common prefix of their suffixes
+    uint16_t nl_new_prefix_len = commonPrefix(count, count + new_count);
+    newLeaf->prefix_key_ = prefix_key_;
+    newLeaf->prefix_key_.addTail(keyAt(count).str, nl_new_prefix_len);
+    for (int i = 0; i < new_count; i++) {
+      KeyView suffix = keyAt(count + i);
+      uint16_t len = suffix.len - nl_new_prefix_len;
+      newLeaf->key_offsets_[i] = newLeaf->appendKeyBytes(suffix.str + nl_new_prefix_len, len);
+      newLeaf->key_lens_[i] = len;
+      newLeaf->payloads[i] = payloads[count + i];
+      newLeaf->count++;
     }
 
-    // update common prefix
     assert(count > 0);
-    Key tmp = keys[0];
-    for (int i = 1; i < count; i++) {
-      tmp.chunkToLength(tmp.commonPrefix(keys[i]));
-    }
-
-    uint16_t new_prefix_len = tmp.getLen();
-    for (int i = 0; i < new_prefix_len; i++) {
-      prefix_key_.addTailChar(keys[0].getKeyStr()[0]);
-      for (int j = 0; j < count; j++) keys[j].removeHead();
-    }
+    uint16_t new_prefix_len = commonPrefix(0, count);
+    prefix_key_.addTail(keyAt(0).str, new_prefix_len);
+    repackKeys("", 0, new_prefix_len, 0);
 
-    assert(newLeaf->count > 0);
-    // Set common prefix
-    Key tmp2 = newLeaf->keys[0];
-    for (int i = 1; i < newLeaf->count; i++) {
-      tmp2.chunkToLength(tmp2.commonPrefix(newLeaf->keys[i]));
-    }
-
-    uint16_t nl_new_prefix_len = tmp2.getLen();
-    for (int i = 0; i < nl_new_prefix_len; i++) {
-      newLeaf->prefix_key_.addTailChar(newLeaf->keys[0].getKeyStr()[0]);
-      for (int j = 0; j < newLeaf->count; j++) newLeaf->keys[j].removeHead();
-    }
-
-    Key &left = keys[count - 1];
-    // Concatenate to get the full key
-    sep = prefix_key_.concate(left);
-    Key right = newLeaf->prefix_key_.concate(newLeaf->keys[0]);
-    int prefix_len = sep.commonPrefix(right);
+    // Concatenate to get the full keys
+    std::string sep_str = shortestSeparator(fullKey(count - 1), newLeaf->fullKey(0));
+    sep.setKeyStr(sep_str.data(), sep_str.length());
+    return newLeaf;
+  }
 
-    if (prefix_len + 1 >= sep.getLen() || prefix_len + 1 >= right.getLen()) {
-      return newLeaf;
+  // fills an empty leaf with the sorted keys [begin, end)
+  void bulkLoad(const std::vector<std::string> &keys, const std::vector<Payload> &values, size_t begin, size_t end) {
+    const std::string &first = keys[begin];
+    const std::string &last = keys[end - 1];
+    uint16_t prefix_len = 0;
+    while (prefix_len < first.size() && prefix_len < last.size() && first[prefix_len] == last[prefix_len])
+      prefix_len++;
+    prefix_key_.setKeyStr(first.data(), prefix_len);
+    for (size_t i = begin; i < end; i++) {
+      uint16_t len = keys[i].size() - prefix_len;
+      key_offsets_[count] = appendKeyBytes(keys[i].data() + prefix_len, len);
+      key_lens_[count] = len;
+      payloads[count] = values[i];
+      count++;
     }
-    right.chunkToLength(prefix_len + 1);
-    sep = right;
-    return newLeaf;
   }
 };
 
@@ -504,19 +716,18 @@ struct BTreeInnerBase : public NodeBase {
   static const PageType typeMarker = PageType::BTreeInner;
 };
 
-template <class Payload>
+template <class Payload, class Fanout = DefaultFanout>
 struct BTreeInner : public BTreeInnerBase {
+  static const int MaxEntries = Fanout::MaxEntries;
+
   Key prefix_key_;
   NodeBase *children[MaxEntries];
-  Key *keys = new Key[MaxEntries];
+  Key keys[MaxEntries];
 
   BTreeInner() {
     count = 0;
     type = typeMarker;
     memset(children, 0, sizeof(NodeBase *) * MaxEntries);
-    for (int i = 0; i < MaxEntries;i++) {
-      keys[i] = Key();
-    }
   }
 
   ~BTreeInner() {
@@ -524,10 +735,9 @@ struct BTreeInner : public BTreeInnerBase {
       if (children[i]->type == PageType::BTreeInner) {
         delete reinterpret_cast<BTreeInner *>(children[i]);
       } else {
-        delete reinterpret_cast<BTreeLeaf<Payload> *>(children[i]);
+        delete reinterpret_cast<BTreeLeaf<Payload, Fanout> *>(children[i]);
       }
     }
-    delete[] keys;
   }
 
   int64_t getSize() {
@@ -541,13 +751,16 @@ struct BTreeInner : public BTreeInnerBase {
 
   bool isFull() { return count == (MaxEntries - 1); };
 
-  unsigned insertBound(Key &k) {
+  unsigned insertBound(const Key &k) const {
+    const char *str = k.getKeyStr();
+    uint16_t len = k.getLen();
     unsigned lower = 0;
     unsigned upper = count;
     do {
       unsigned mid = ((upper - lower) / 2) + lower;
-      Key &mid_key = keys[mid];
-      int cmp = k.compare(mid_key, prefix_key_);
+      KeyView part = keys[mid].view();
+      KeyView prefix = prefix_key_.view();
+      int cmp = Key::compare(str, len, part.str, part.len, prefix.str, prefix.len);
       if (cmp < 0) {
         upper = mid;
       } else if (cmp > 0) {
@@ -559,13 +772,16 @@ struct BTreeInner : public BTreeInnerBase {
     return lower;
   }
 
-  unsigned lowerBound(Key &k) {
+  unsigned lowerBound(const Key &k) const {
+    const char *str = k.getKeyStr();
+    uint16_t len = k.getLen();
     unsigned lower = 0;
     unsigned upper = count;
     do {
       unsigned mid = ((upper - lower) / 2) + lower;
-      Key &mid_key = keys[mid];
-      int cmp = k.compare(mid_key, prefix_key_);
+      KeyView part = keys[mid].view();
+      KeyView prefix = prefix_key_.view();
+      int cmp = Key::compare(str, len, part.str, part.len, prefix.str, prefix.len);
       if (cmp < 0) {
         upper = mid;
       } else if (cmp > 0) {
@@ -587,47 +803,51 @@ struct BTreeInner : public BTreeInnerBase {
     sep = prefix_key_.concate(right);
 
     for (int i = 0; i < (int)newInner->count; i++) {
-      newInner->keys[i] = keys[count + 1 + i];
-      keys[count + 1 + i] = Key();
+      newInner->keys[i] = std::move(keys[count + 1 + i]);
     }
 
     memcpy(newInner->children, children + count + 1, sizeof(NodeBase *) * (newInner->count + 1));
     newInner->prefix_key_ = prefix_key_;
 
-    // update common prefix
+    // update common prefix; keys are sorted, so the first and the last
+    // key bound it
     assert(count > 0);
-    Key tmp = keys[0];
-    for (int i = 1; i < count; i++) {
-      tmp.chunkToLength(tmp.commonPrefix(keys[i]));
-    }
-
-    uint16_t new_prefix_len = tmp.getLen();
-    for (int i = 0; i < new_prefix_len; i++) {
-      prefix_key_.addTailChar(keys[0].getKeyStr()[0]);
-      for (int j = 0; j < count; j++) keys[j].removeHead();
-    }
+    uint16_t new_prefix_len = keys[0].commonPrefix(keys[count - 1]);
+    prefix_key_.addTail(keys[0].getKeyStr(), new_prefix_len);
+    for (int j = 0; j < count; j++) keys[j].chunkBeginning(new_prefix_len);
 
     assert(newInner->count > 0);
     // Set common prefix
-    Key tmp2 = newInner->keys[0];
-    for (int i = 1; i < newInner->count; i++) {
-      tmp2.chunkToLength(tmp2.commonPrefix(newInner->keys[i]));
-    }
-
-    uint16_t nl_new_prefix_len = tmp2.getLen();
-    for (int i = 0; i < nl_new_prefix_len; i++) {
-      newInner->prefix_key_.addTailChar(newInner->keys[0].getKeyStr()[0]);
-      for (int j = 0; j < newInner->count; j++) newInner->keys[j].removeHead();
-    }
+    uint16_t nl_new_prefix_len = newInner->keys[0].commonPrefix(newInner->keys[newInner->count - 1]);
+    newInner->prefix_key_.addTail(newInner->keys[0].getKeyStr(), nl_new_prefix_len);
+    for (int j = 0; j < newInner->count; j++) newInner->keys[j].chunkBeginning(nl_new_prefix_len);
 
     return newInner;
   }
 
+  // fills an empty node with children [begin, end); seps[i] separates
+  // children[i] and children[i + 1]
+  void bulkLoad(const std::vector<NodeBase *> &nodes, const std::vector<std::string> &seps, size_t begin,
+                size_t end) {
+    const std::string &first = seps[begin];
+    const std::string &last = seps[end - 2];
+    uint16_t prefix_len = 0;
+    while (prefix_len < first.size() && prefix_len < last.size() && first[prefix_len] == last[prefix_len])
+      prefix_len++;
+    prefix_key_.setKeyStr(first.data(), prefix_len);
+    for (size_t i = begin; i + 1 < end; i++) {
+      keys[count].setKeyStr(seps[i].data() + prefix_len, seps[i].size() - prefix_len);
+      children[count] = nodes[i];
+      count++;
+    }
+    children[count] = nodes[end - 1];
+  }
+
   void insert(Key k, NodeBase *child) {
     assert(count <= MaxEntries - 1);
     unsigned pos = insertBound(k);
     for (int i = count; i > (int)pos; i--) {
-      keys[i] = keys[i - 1];
+      keys[i] = std::move(keys[i - 1]);
     }
 
     memmove(children + pos + 1, children + pos, sizeof(NodeBase *) * (count - pos + 1));
@@ -635,53 +855,52 @@ struct BTreeInner : public BTreeInnerBase {
     // get common prefix of key and other keys
     uint16_t new_prefix_len = k.commonPrefix(prefix_key_);
     k.chunkBeginning(new_prefix_len);
-    keys[pos] = k;
+    keys[pos] = std::move(k);
     children[pos] = child;
     count++;
     // decide if we need to modify all the other keys
     if (new_prefix_len == prefix_key_.getLen()) {
       // insert directly
     } else {
-      // modify all the keys, add the last several bytes of prefix to those keys
+      // modify all the keys, add the cut-off bytes of prefix to those keys
       assert(new_prefix_len < prefix_key_.getLen());
       uint16_t prefix_len = prefix_key_.getLen();
-      for (int i = new_prefix_len; i < prefix_len; i++) {
-        for (int j = 0; j < count; j++) {
-          if (j == (int)pos) continue;
-          keys[j].addHead(prefix_key_);
-        }
-        prefix_key_.chunkToLength(prefix_key_.getLen() - 1);
+      const char *segment = prefix_key_.getKeyStr() + new_prefix_len;
+      for (int j = 0; j < count; j++) {
+        if (j == (int)pos) continue;
+        keys[j].addHead(segment, prefix_len - new_prefix_len);
       }
+      prefix_key_.chunkToLength(new_prefix_len);
     }
     std::swap(children[pos], children[pos + 1]);
   }
 };
 
-template <class Payload>
+template <class Payload, class Fanout = DefaultFanout>
 class BTreeIterator {
  private:
   std::stack<std::pair<NodeBase *, uint16_t>> s_;
-  BTreeLeaf<Payload> *pushAll(NodeBase *node) {
+  BTreeLeaf<Payload, Fanout> *pushAll(NodeBase *node) {
     while (true) {
       s_.push(std::make_pair(node, 0));
       if (node->type == PageType::BTreeLeaf) {
-        return reinterpret_cast<BTreeLeaf<Payload> *>(node);
+        return reinterpret_cast<BTreeLeaf<Payload, Fanout> *>(node);
       }
-      auto inner = reinterpret_cast<BTreeInner<Payload> *>(node);
+      auto inner = reinterpret_cast<BTreeInner<Payload, Fanout> *>(node);
       node = inner->children[0];
     }
   }
 
  public:
-  BTreeIterator(NodeBase *root, Key k) {
+  BTreeIterator(NodeBase *root, const Key &k) {
     NodeBase *node = root;
     while (node->type == PageType::BTreeInner) {
-      auto inner = static_cast<BTreeInner<Payload> *>(node);
+      auto inner = static_cast<BTreeInner<Payload, Fanout> *>(node);
       uint16_t id = inner->lowerBound(k);
       s_.push(std::make_pair(node, id));
       node = inner->children[id];
     };
-    auto leaf = static_cast<BTreeLeaf<Payload> *>(node);
+    auto leaf = static_cast<BTreeLeaf<Payload, Fanout> *>(node);
     unsigned pos = leaf->lowerBound(k);
     s_.push(std::make_pair(leaf, pos));
   }
@@ -693,7 +912,7 @@ class BTreeIterator {
   Payload *next() {
     std::pair<NodeBase *, uint16_t> p = s_.top();
     s_.pop();
-    auto leaf = reinterpret_cast<BTreeLeaf<Payload> *>(p.first);
+    auto leaf = reinterpret_cast<BTreeLeaf<Payload, Fanout> *>(p.first);
     int cur_idx = p.second;
     if (cur_idx < p.first->count) {
       s_.push(std::make_pair(leaf, cur_idx + 1));
@@ -704,7 +923,7 @@ class BTreeIterator {
       std::pair<NodeBase *, uint16_t> parent_p = s_.top();
       s_.pop();
       if (parent_p.second < parent_p.first->count) {
-        BTreeInner<Payload> *parent = reinterpret_cast<BTreeInner<Payload> *>(parent_p.first);
+        BTreeInner<Payload, Fanout> *parent = reinterpret_cast<BTreeInner<Payload, Fanout> *>(parent_p.first);
         NodeBase *next = parent->children[parent_p.second + 1];
         s_.push(std::make_pair(parent, parent_p.second + 1));
         pushAll(next);
@@ -715,25 +934,221 @@ class BTreeIterator {
   }
 };
 
-template <class Payload>
+// Forward iterator that tolerates concurrent inserts. Each leaf is copied
+// under an optimistic read and then validated; leaves are reached through
+// their sibling pointers. If a leaf changes while it is copied, the
+// iterator descends again from the root to the first key after the last
+// one it returned. Full keys are only assembled by key().
+template <class Payload, class Fanout = DefaultFanout>
+class BTreeOLCIterator {
+ private:
+  typedef BTreeLeaf<Payload, Fanout> Leaf;
+  typedef BTreeInner<Payload, Fanout> Inner;
+
+  // a validated copy of one leaf
+  struct LeafCopy {
+    std::string prefix;
+    std::string key_bytes;
+    uint16_t count = 0;
+    uint32_t key_offsets[Leaf::MaxLeafEntries];
+    uint16_t key_lens[Leaf::MaxLeafEntries];
+    Payload payloads[Leaf::MaxLeafEntries];
+    Leaf *next = nullptr;
+
+    std::string fullKey(unsigned pos) const {
+      std::string full_key = prefix;
+      full_key.append(key_bytes, key_offsets[pos], key_lens[pos]);
+      return full_key;
+    }
+  };
+
+  std::atomic<NodeBase *> &root_;
+  LeafCopy cur_;
+  LeafCopy next_;
+  unsigned pos_;
+  // first position of cur_ at or after the seek key
+  unsigned start_pos_;
+  Key seek_key_;
+  bool seek_inclusive_;
+
+  // false if the leaf is being modified
+  // The key area is read through one snapshot of its pointer, bounded by
+  // that area's own capacity; offsets are checked against the copied
+  // bytes before fullKey can use them
+  static bool copyLeaf(const Leaf *leaf, LeafCopy &copy) {
+    uint16_t count = leaf->count;
+    const char *bytes = leaf->loadKeyBytes();
+    uint32_t used = leaf->key_bytes_used_;
+    if (count > Leaf::MaxLeafEntries || used > leaf->keyAreaCapacity(bytes)) return false;
+    copy.count = count;
+    KeyView prefix = leaf->prefix_key_.view();
+    copy.prefix.assign(prefix.str, prefix.len);
+    copy.key_bytes.assign(bytes, used);
+    memcpy(copy.key_offsets, leaf->key_offsets_, sizeof(uint32_t) * count);
+    memcpy(copy.key_lens, leaf->key_lens_, sizeof(uint16_t) * count);
+    for (int i = 0; i < count; i++) {
+      if ((uint64_t)copy.key_offsets[i] + copy.key_lens[i] > used) return false;
+    }
+    for (int i = 0; i < count; i++) copy.payloads[i] = leaf->payloads[i];
+    copy.next = leaf->next_;
+    return true;
+  }
+
+  void seek(const Key &k, bool inclusive) {
+    KeyAreaEpoch::Guard guard;
+    seek_key_ = k;
+    seek_inclusive_ = inclusive;
+    int restartCount = 0;
+  restart:
+    if (restartCount++) {
+      if (restartCount > 3)
+        sched_yield();
+      else
+        _mm_pause();
+    }
+    bool needRestart = false;
+
+    NodeBase *node = root_;
+    uint64_t versionNode = node->readLockOrRestart(needRestart);
+    if (needRestart || (node != root_)) goto restart;
+
+    while (node->type == PageType::BTreeInner) {
+      auto inner = static_cast<Inner *>(node);
+      node = inner->children[inner->lowerBound(k)];
+      inner->checkOrRestart(versionNode, needRestart);
+      if (needRestart) goto restart;
+      versionNode = node->readLockOrRestart(needRestart);
+      if (needRestart) goto restart;
+    }
+
+    auto leaf = static_cast<Leaf *>(node);
+    unsigned pos = inclusive ? leaf->lowerBound(k) : leaf->insertBound(k);
+    if (!copyLeaf(leaf, cur_)) goto restart;
+    node->readUnlockOrRestart(versionNode, needRestart);
+    if (needRestart) goto restart;
+
+    pos_ = start_pos_ = std::min(pos, (unsigned)cur_.count);
+    if (pos_ == cur_.count) nextLeaf();
+  }
+
+  void nextLeaf() {
+    KeyAreaEpoch::Guard guard;
+    while (cur_.next != nullptr) {
+      Leaf *leaf = cur_.next;
+      bool needRestart = false;
+      uint64_t version = leaf->readLockOrRestart(needRestart);
+      if (!needRestart && copyLeaf(leaf, next_)) leaf->readUnlockOrRestart(version, needRestart);
+      else needRestart = true;
+      if (needRestart) {
+        // resume after the last returned key
+        if (cur_.count > start_pos_) {
+          std::string last_key = cur_.fullKey(cur_.count - 1);
+          Key k;
+          k.setKeyStr(last_key.data(), last_key.length());
+          seek(k, false);
+        } else {
+          Key k = std::move(seek_key_);
+          seek(k, seek_inclusive_);
+        }
+        return;
+      }
+      std::swap(cur_, next_);
+      pos_ = start_pos_ = 0;
+      if (cur_.count > 0) return;
+    }
+    cur_.count = 0;
+    pos_ = start_pos_ = 0;
+  }
+
+ public:
+  BTreeOLCIterator(std::atomic<NodeBase *> &root, const Key &start, bool inclusive = true) : root_(root) {
+    seek(start, inclusive);
+  }
+
+  bool valid() const { return pos_ < cur_.count; }
+
+  const Payload &payload() const { return cur_.payloads[pos_]; }
+
+  std::string key() const { return cur_.fullKey(pos_); }
+
+  void next() {
+    pos_++;
+    if (pos_ == cur_.count) nextLeaf();
+  }
+};
+
+template <class Payload, class Fanout = DefaultFanout>
 class BTree {
  public:
   std::atomic<NodeBase *> root;
 
-  BTree() { root = new BTreeLeaf<Payload>(); }
+  BTree() { root = new BTreeLeaf<Payload, Fanout>(); }
 
   ~BTree() {
     if (root.load()->type == PageType::BTreeInner) {
-      auto inner = reinterpret_cast<BTreeInner<Payload> *>(root.load());
+      auto inner = reinterpret_cast<BTreeInner<Payload, Fanout> *>(root.load());
       delete inner;
     } else {
-      auto leaf = reinterpret_cast<BTreeLeaf<Payload> *>(root.load());
+      auto leaf = reinterpret_cast<BTreeLeaf<Payload, Fanout> *>(root.load());
       delete leaf;
     }
   }
 
+  // Builds the tree bottom-up from SORTED, unique keys. The tree must be
+  // empty. Nodes are filled to about fill_factor, and each node's prefix
+  // comes from its first and last key. No locks are taken, so no other
+  // thread may use the tree until bulkLoad returns.
+  void bulkLoad(const std::vector<std::string> &keys, const std::vector<Payload> &values, double fill_factor = 0.9) {
+    assert(root.load()->type == PageType::BTreeLeaf && root.load()->count == 0);
+    assert(keys.size() == values.size());
+    if (keys.empty()) return;
+
+    std::vector<NodeBase *> nodes;
+    // seps[i] separates nodes[i] and nodes[i + 1]
+    std::vector<std::string> seps;
+    std::vector<size_t> bounds = bulkLoadGroups(keys.size(), BTreeLeaf<Payload, Fanout>::MaxLeafEntries, fill_factor, 1);
+    BTreeLeaf<Payload, Fanout> *prev = nullptr;
+    for (size_t g = 0; g + 1 < bounds.size(); g++) {
+      auto leaf = new BTreeLeaf<Payload, Fanout>();
+      leaf->bulkLoad(keys, values, bounds[g], bounds[g + 1]);
+      if (prev) {
+        prev->next_ = leaf;
+        seps.push_back(shortestSeparator(keys[bounds[g] - 1], keys[bounds[g]]));
+      }
+      nodes.push_back(leaf);
+      prev = leaf;
+    }
+
+    while (nodes.size() > 1) {
+      std::vector<NodeBase *> upper_nodes;
+      std::vector<std::string> upper_seps;
+      bounds = bulkLoadGroups(nodes.size(), BTreeInner<Payload, Fanout>::MaxEntries, fill_factor, 3);
+      for (size_t g = 0; g + 1 < bounds.size(); g++) {
+        auto inner = new BTreeInner<Payload, Fanout>();
+        inner->bulkLoad(nodes, seps, bounds[g], bounds[g + 1]);
+        if (g > 0) upper_seps.push_back(seps[bounds[g] - 1]);
+        upper_nodes.push_back(inner);
+      }
+      nodes.swap(upper_nodes);
+      seps.swap(upper_seps);
+    }
+
+    delete reinterpret_cast<BTreeLeaf<Payload, Fanout> *>(root.load());
+    root = nodes[0];
+  }
+
+  // Boundaries of n entries split into balanced groups of at most
+  // fill_factor * max_entries, and at least min_entries, entries each
+  static std::vector<size_t> bulkLoadGroups(size_t n, int max_entries, double fill_factor, int min_entries) {
+    size_t target = std::max(min_entries, std::min(max_entries, (int)(max_entries * fill_factor)));
+    size_t groups = (n + target - 1) / target;
+    std::vector<size_t> bounds;
+    for (size_t g = 0; g <= groups; g++) bounds.push_back(n * g / groups);
+    return bounds;
+  }
+
   void makeRoot(Key k, NodeBase *leftChild, NodeBase *rightChild) {
-    auto inner = new BTreeInner<Payload>();
+    auto inner = new BTreeInner<Payload, Fanout>();
     inner->count = 1;
     inner->keys[0] = k;
     inner->children[0] = leftChild;
@@ -749,6 +1164,7 @@ class BTree {
   }
 
   void insert(Key k, Payload v) {
+    KeyAreaEpoch::Guard guard;
     int restartCount = 0;
   restart:
     if (restartCount++) yield(restartCount);
@@ -760,11 +1176,11 @@ class BTree {
     if (needRestart || (node != root)) goto restart;
 
     // Parent of current node
-    BTreeInner<Payload> *parent = nullptr;
-    uint64_t versionParent;
+    BTreeInner<Payload, Fanout> *parent = nullptr;
+    uint64_t versionParent = 0;
 
     while (node->type == PageType::BTreeInner) {
-      auto inner = static_cast<BTreeInner<Payload> *>(node);
+      auto inner = static_cast<BTreeInner<Payload, Fanout> *>(node);
 
       // Split eagerly if full
       if (inner->isFull()) {
@@ -784,7 +1200,7 @@ class BTree {
         }
         // Split
         Key sep;
-        BTreeInner<Payload> *newInner = inner->split(sep);
+        BTreeInner<Payload, Fanout> *newInner = inner->split(sep);
         if (parent)
           parent->insert(sep, newInner);
         else
@@ -810,10 +1226,10 @@ class BTree {
       if (needRestart) goto restart;
     }
 
-    auto leaf = static_cast<BTreeLeaf<Payload> *>(node);
+    auto leaf = static_cast<BTreeLeaf<Payload, Fanout> *>(node);
 
     // Split leaf if full
-    if (leaf->count == MaxLeafEntries) {
+    if (leaf->isFull()) {
       // Lock
       if (parent) {
         parent->upgradeToWriteLockOrRestart(versionParent, needRestart);
@@ -830,7 +1246,7 @@ class BTree {
       }
       // Split
       Key sep;
-      BTreeLeaf<Payload> *newLeaf = leaf->split(sep);
+      BTreeLeaf<Payload, Fanout> *newLeaf = leaf->split(sep);
       if (parent)
         parent->insert(sep, newLeaf);
       else
@@ -856,7 +1272,8 @@ class BTree {
     }
   }
 
-  bool lookup(Key k, Payload &result) {
+  bool lookup(const Key &k, Payload &result) {
+    KeyAreaEpoch::Guard guard;
     int restartCount = 0;
   restart:
     if (restartCount++) yield(restartCount);
@@ -867,11 +1284,11 @@ class BTree {
     if (needRestart || (node != root)) goto restart;
 
     // Parent of current node
-    BTreeInner<Payload> *parent = nullptr;
+    BTreeInner<Payload, Fanout> *parent = nullptr;
     uint64_t versionParent = 0;
 
     while (node->type == PageType::BTreeInner) {
-      auto inner = static_cast<BTreeInner<Payload> *>(node);
+      auto inner = static_cast<BTreeInner<Payload, Fanout> *>(node);
 
       if (parent) {
         parent->readUnlockOrRestart(versionParent, needRestart);
@@ -888,12 +1305,10 @@ class BTree {
       if (needRestart) goto restart;
     }
 
-    BTreeLeaf<Payload> *leaf = static_cast<BTreeLeaf<Payload> *>(node);
+    BTreeLeaf<Payload, Fanout> *leaf = static_cast<BTreeLeaf<Payload, Fanout> *>(node);
     unsigned pos = leaf->lowerBound(k);
     bool success = false;
-    assert(pos != leaf->count);
-    int cmp = k.compare(leaf->keys[pos], leaf->prefix_key_);
-    if ((pos < leaf->count) && (cmp == 0)) {
+    if ((pos < leaf->count) && (leaf->compareAt(k.getKeyStr(), k.getLen(), pos) == 0)) {
       success = true;
       result = leaf->payloads[pos];
     }
@@ -907,65 +1322,18 @@ class BTree {
     return success;
   }
 
-  uint16_t rangeScan(Key k, int range, Payload *output) {
-    auto it = new BTreeIterator<Payload>(root, k);
-    uint16_t cnt = 0;
-    while (cnt < range) {
-      Payload *v = it->next();
-      if (v == NULL) break;
-      output[cnt++] = *v;
-    }
-    delete it;
-    return cnt;
-  }
-
-  uint64_t scan(Key k, int range, std::string *output) {
-    int restartCount = 0;
-  restart:
-    if (restartCount++) yield(restartCount);
-    bool needRestart = false;
-
-    NodeBase *node = root;
-    uint64_t versionNode = node->readLockOrRestart(needRestart);
-    if (needRestart || (node != root)) goto restart;
-
-    // Parent of current node
-    BTreeInner<Payload> *parent = nullptr;
-    uint64_t versionParent;
-
-    while (node->type == PageType::BTreeInner) {
-      auto inner = static_cast<BTreeInner<Payload> *>(node);
-
-      if (parent) {
-        parent->readUnlockOrRestart(versionParent, needRestart);
-        if (needRestart) goto restart;
-      }
-
-      parent = inner;
-      versionParent = versionNode;
-
-      node = inner->children[inner->lowerBound(k)];
-      inner->checkOrRestart(versionNode, needRestart);
-      if (needRestart) goto restart;
-      versionNode = node->readLockOrRestart(needRestart);
-      if (needRestart) goto restart;
-    }
+  uint16_t rangeScan(const Key &k, int range, Payload *output) { return scan(k, range, output); }
 
-    BTreeLeaf<Payload> *leaf = static_cast<BTreeLeaf<Payload> *>(node);
-    unsigned pos = leaf->lowerBound(k);
+  // Copies the payloads of up to range keys >= k; safe with concurrent inserts
+  uint64_t scan(const Key &k, int range, Payload *output) {
     int count = 0;
-    for (unsigned i = pos; i < leaf->count; i++) {
+    if (range <= 0) return count;
+    BTreeOLCIterator<Payload, Fanout> it(root, k);
+    while (it.valid()) {
+      output[count++] = it.payload();
       if (count == range) break;
-      output[count++] = leaf->payloads[i];
+      it.next();
     }
-
-    if (parent) {
-      parent->readUnlockOrRestart(versionParent, needRestart);
-      if (needRestart) goto restart;
-    }
-    node->readUnlockOrRestart(versionNode, needRestart);
-    if (needRestart) goto restart;
-
     return count;
   }
 
@@ -994,7 +1362,7 @@ class BTree {
       max_hei = std::max(h, max_hei);
 
       if (top->type == PageType::BTreeInner) {
-        auto node = reinterpret_cast<BTreeInner<Payload> *>(top);
+        auto node = reinterpret_cast<BTreeInner<Payload, Fanout> *>(top);
         size += node->getSize();
         internal_node_size += node->getSize();
         avg_internal_prefix += node->prefix_key_.getLen();
@@ -1009,7 +1377,7 @@ class BTree {
           node_cnt++;
         }
       } else {
-        auto node = reinterpret_cast<BTreeLeaf<Payload> *>(top);
+        auto node = reinterpret_cast<BTreeLeaf<Payload, Fanout> *>(top);
         prefix_size += node->prefix_key_.getSize();
 
         prefix_byte_size += node->prefix_key_.getLen() * node->count;
@@ -1019,7 +1387,7 @@ class BTree {
         leaf_key_num += node->count;
         max_prefix_len = std::max((int)node->prefix_key_.getLen(), max_prefix_len);
         for (int i = 0; i < node->count; i++) {
-          leaf_key_size += node->keys[i].getSize();
+          leaf_key_size += sizeof(uint32_t) + sizeof(uint16_t) + node->keyAt(i).len;
         }
       }
       q.pop();
@@ -1049,7 +1417,7 @@ class BTree {
     while (!q.empty()) {
       NodeBase *top = q.front();
       if (top->type == PageType::BTreeInner) {
-        auto inner = reinterpret_cast<BTreeInner<Payload> *>(top);
+        auto inner = reinterpret_cast<BTreeInner<Payload, Fanout> *>(top);
         for (int i = 0; i <= (int)inner->count; i++) {
           q.push(inner->children[i]);
         }
@@ -1061,12 +1429,13 @@ class BTree {
           substrings.emplace_back(inner->keys[i].getKeyStr(), inner->keys[i].getLen());
         }
       } else {
-        auto leaf = reinterpret_cast<BTreeLeaf<Payload> *>(top);
+        auto leaf = reinterpret_cast<BTreeLeaf<Payload, Fanout> *>(top);
         if (leaf->prefix_key_.getLen() > 0) {
           substrings.emplace_back(leaf->prefix_key_.getKeyStr(), leaf->prefix_key_.getLen());
         }
         for (int i = 0; i < (int)leaf->count; i++) {
-          substrings.emplace_back(leaf->keys[i].getKeyStr(), leaf->keys[i].getLen());
+          KeyView suffix = leaf->keyAt(i);
+          substrings.emplace_back(suffix.str, suffix.len);
         }
       }
       q.pop();
@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 #include <random>
+#include <thread>
 
 #include "PrefixBtree.h"
 
@@ -215,6 +216,295 @@ TEST_F(PrefixBtreeUnitTest, rangeScanIntTest) {
   delete bt_;
 }
 
+TEST_F(PrefixBtreeUnitTest, lookupAbsentKeyTest) {
+  // long keys are stored out of line; half of them are never inserted
+  std::vector<std::string> long_words;
+  for (int i = 0; i < (int)words.size(); i++) {
+    long_words.push_back("prefix/" + words[i] + "/suffix");
+  }
+  bt_ = new prefixbtreeolc::BTree<int64_t>();
+  for (int i = 0; i < (int)long_words.size(); i += 2) {
+    prefixbtreeolc::Key key;
+    key.setKeyStr(long_words[i].c_str(), long_words[i].length());
+    bt_->insert(key, reinterpret_cast<int64_t>(&long_words[i]));
+  }
+
+  for (int i = 0; i < (int)long_words.size(); i++) {
+    prefixbtreeolc::Key key;
+    key.setKeyStr(long_words[i].c_str(), long_words[i].length());
+    int64_t re = 0;
+    bool find = bt_->lookup(key, re);
+    if (i % 2 == 0) {
+      ASSERT_TRUE(find);
+      EXPECT_EQ(reinterpret_cast<int64_t>(&(long_words[i])), re);
+    } else {
+      EXPECT_FALSE(find);
+    }
+  }
+
+  prefixbtreeolc::Key key;
+  std::string max_str(20, '\xff');
+  key.setKeyStr(max_str.c_str(), max_str.length());
+  int64_t re = 0;
+  EXPECT_FALSE(bt_->lookup(key, re));
+  delete bt_;
+}
+
+TEST_F(PrefixBtreeUnitTest, longKeyTest) {
+  // suffixes this long no longer fit in a leaf's inline key area
+  std::vector<std::string> long_words;
+  for (int i = 0; i < (int)words.size(); i++) {
+    long_words.push_back(words[i] + std::string(64, '/') + words[(i * 7) % words.size()]);
+  }
+  std::vector<std::string> sorted_words = long_words;
+  std::sort(sorted_words.begin(), sorted_words.end());
+  std::shuffle(long_words.begin(), long_words.end(), std::mt19937(0));
+
+  bt_ = new prefixbtreeolc::BTree<int64_t>();
+  for (int i = 0; i < (int)long_words.size(); i++) {
+    prefixbtreeolc::Key key;
+    key.setKeyStr(long_words[i].c_str(), long_words[i].length());
+    bt_->insert(key, reinterpret_cast<int64_t>(&long_words[i]));
+  }
+
+  for (int i = 0; i < (int)long_words.size(); i++) {
+    prefixbtreeolc::Key key;
+    key.setKeyStr(long_words[i].c_str(), long_words[i].length());
+    int64_t re;
+    ASSERT_TRUE(bt_->lookup(key, re));
+    EXPECT_EQ(reinterpret_cast<int64_t>(&(long_words[i])), re);
+  }
+
+  int scanlen = 1000;
+  std::vector<int64_t> re(scanlen);
+  prefixbtreeolc::Key key;
+  key.setKeyStr(sorted_words[0].c_str(), sorted_words[0].length());
+  int cnt = bt_->rangeScan(key, scanlen, re.data());
+  ASSERT_EQ(scanlen, cnt);
+  for (int j = 0; j < cnt; j++) {
+    EXPECT_EQ(sorted_words[j], *reinterpret_cast<std::string *>(re[j]));
+  }
+  delete bt_;
+}
+
+template <class Fanout>
+void checkFanout(const std::vector<std::string> &keys) {
+  prefixbtreeolc::BTree<int64_t, Fanout> *bt = new prefixbtreeolc::BTree<int64_t, Fanout>();
+  for (int i = 0; i < (int)keys.size(); i++) {
+    prefixbtreeolc::Key key;
+    key.setKeyStr(keys[i].c_str(), keys[i].length());
+    bt->insert(key, reinterpret_cast<int64_t>(&keys[i]));
+  }
+  for (int i = 0; i < (int)keys.size(); i++) {
+    prefixbtreeolc::Key key;
+    key.setKeyStr(keys[i].c_str(), keys[i].length());
+    int64_t re;
+    ASSERT_TRUE(bt->lookup(key, re));
+    EXPECT_EQ(reinterpret_cast<int64_t>(&(keys[i])), re);
+  }
+
+  std::vector<std::string> sorted_keys = keys;
+  std::sort(sorted_keys.begin(), sorted_keys.end());
+  int scanlen = 1000;
+  std::vector<int64_t> re(scanlen);
+  prefixbtreeolc::Key key;
+  key.setKeyStr(sorted_keys[0].c_str(), sorted_keys[0].length());
+  int cnt = bt->rangeScan(key, scanlen, re.data());
+  ASSERT_EQ(scanlen, cnt);
+  for (int j = 0; j < cnt; j++) {
+    EXPECT_EQ(sorted_keys[j], *reinterpret_cast<std::string *>(re[j]));
+  }
+  delete bt;
+}
+
+TEST_F(PrefixBtreeUnitTest, fanoutTest) {
+  checkFanout<prefixbtreeolc::Fanout256B>(words);
+  checkFanout<prefixbtreeolc::Fanout1KB>(words);
+  checkFanout<prefixbtreeolc::Fanout4KB>(words);
+  checkFanout<prefixbtreeolc::Fanout4KB>(integers);
+}
+
+void checkScanIterator(const std::vector<std::string> &keys) {
+  std::vector<std::string> sorted_words = keys;
+  std::sort(sorted_words.begin(), sorted_words.end());
+  sorted_words.erase(std::unique(sorted_words.begin(), sorted_words.end()), sorted_words.end());
+  std::vector<std::string> shuffled_words = sorted_words;
+  std::shuffle(shuffled_words.begin(), shuffled_words.end(), std::mt19937(0));
+
+  // scans run while the second half of the keys is being inserted
+  prefixbtreeolc::BTree<int64_t> *bt = new prefixbtreeolc::BTree<int64_t>();
+  int half = (int)shuffled_words.size() / 2;
+  for (int i = 0; i < half; i++) {
+    prefixbtreeolc::Key key;
+    key.setKeyStr(shuffled_words[i].c_str(), shuffled_words[i].length());
+    bt->insert(key, i);
+  }
+  std::thread writer([&]() {
+    for (int i = half; i < (int)shuffled_words.size(); i++) {
+      prefixbtreeolc::Key key;
+      key.setKeyStr(shuffled_words[i].c_str(), shuffled_words[i].length());
+      bt->insert(key, i);
+    }
+  });
+  for (int i = 0; i < 20000; i++) {
+    const std::string &start = shuffled_words[i % half];
+    prefixbtreeolc::Key key;
+    key.setKeyStr(start.c_str(), start.length());
+    prefixbtreeolc::BTreeOLCIterator<int64_t> it(bt->root, key);
+    std::string prev_key = start;
+    for (int j = 0; j < 50 && it.valid(); j++, it.next()) {
+      std::string cur_key = it.key();
+      if (j == 0)
+        ASSERT_EQ(start, cur_key);
+      else
+        ASSERT_LT(prev_key, cur_key);
+      ASSERT_EQ(shuffled_words[it.payload()], cur_key);
+      prev_key = cur_key;
+    }
+  }
+  writer.join();
+
+  prefixbtreeolc::Key key;
+  key.setKeyStr(sorted_words[0].c_str(), sorted_words[0].length());
+  prefixbtreeolc::BTreeOLCIterator<int64_t> it(bt->root, key);
+  int cnt = 0;
+  for (; it.valid(); it.next(), cnt++) {
+    ASSERT_EQ(sorted_words[cnt], it.key());
+  }
+  EXPECT_EQ((int)sorted_words.size(), cnt);
+
+  // exclusive start
+  key.setKeyStr(sorted_words[10].c_str(), sorted_words[10].length());
+  prefixbtreeolc::BTreeOLCIterator<int64_t> it_excl(bt->root, key, false);
+  ASSERT_TRUE(it_excl.valid());
+  EXPECT_EQ(sorted_words[11], it_excl.key());
+
+  // past the last key
+  std::string max_str(20, '\xff');
+  key.setKeyStr(max_str.c_str(), max_str.length());
+  prefixbtreeolc::BTreeOLCIterator<int64_t> it_end(bt->root, key);
+  EXPECT_FALSE(it_end.valid());
+  delete bt;
+}
+
+TEST_F(PrefixBtreeUnitTest, scanIteratorTest) { checkScanIterator(words); }
+
+TEST_F(PrefixBtreeUnitTest, scanIteratorLongPrefixTest) {
+  // URL-style keys share a prefix longer than the inline key bytes
+  std::vector<std::string> urls;
+  for (int i = 0; i < (int)words.size(); i++) urls.push_back("http://www.example.com/wiki/" + words[i]);
+  checkScanIterator(urls);
+}
+
+TEST_F(PrefixBtreeUnitTest, concurrentLongPrefixTest) {
+  // URL-style keys: node prefixes outgrow the inline key bytes and are
+  // rewritten by splits while readers use them
+  std::vector<std::string> urls;
+  for (int i = 0; i < (int)words.size(); i++) urls.push_back("http://www.example.com/wiki/" + words[i] + ".html");
+  std::sort(urls.begin(), urls.end());
+  urls.erase(std::unique(urls.begin(), urls.end()), urls.end());
+  std::vector<std::string> shuffled_urls = urls;
+  std::shuffle(shuffled_urls.begin(), shuffled_urls.end(), std::mt19937(0));
+
+  bt_ = new prefixbtreeolc::BTree<int64_t>();
+  const int kNumWriters = 4;
+  const int kNumReaders = 4;
+  std::atomic<int> writers_done(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumWriters; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = t; i < (int)shuffled_urls.size(); i += kNumWriters) {
+        prefixbtreeolc::Key key;
+        key.setKeyStr(shuffled_urls[i].c_str(), shuffled_urls[i].length());
+        bt_->insert(key, i);
+      }
+      writers_done++;
+    });
+  }
+  std::atomic<bool> failed(false);
+  for (int t = 0; t < kNumReaders; t++) {
+    threads.emplace_back([&, t]() {
+      std::mt19937 gen(t);
+      while (writers_done.load() < kNumWriters) {
+        int i = gen() % shuffled_urls.size();
+        prefixbtreeolc::Key key;
+        key.setKeyStr(shuffled_urls[i].c_str(), shuffled_urls[i].length());
+        int64_t re;
+        if (bt_->lookup(key, re) && re != i) failed = true;
+        prefixbtreeolc::BTreeOLCIterator<int64_t> it(bt_->root, key);
+        std::string prev_key;
+        for (int j = 0; j < 20 && it.valid(); j++, it.next()) {
+          std::string cur_key = it.key();
+          if ((j > 0 && !(prev_key < cur_key)) || shuffled_urls[it.payload()] != cur_key) failed = true;
+          prev_key = cur_key;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) thread.join();
+  EXPECT_FALSE(failed.load());
+
+  for (int i = 0; i < (int)shuffled_urls.size(); i++) {
+    prefixbtreeolc::Key key;
+    key.setKeyStr(shuffled_urls[i].c_str(), shuffled_urls[i].length());
+    int64_t re;
+    ASSERT_TRUE(bt_->lookup(key, re));
+    ASSERT_EQ(i, re);
+  }
+  delete bt_;
+}
+
+template <class Fanout>
+void checkBulkLoad(const std::vector<std::string> &keys, double fill_factor) {
+  std::vector<std::string> sorted_keys = keys;
+  std::sort(sorted_keys.begin(), sorted_keys.end());
+  sorted_keys.erase(std::unique(sorted_keys.begin(), sorted_keys.end()), sorted_keys.end());
+  // every other key is bulk loaded, the rest is inserted afterwards
+  std::vector<std::string> load_keys;
+  std::vector<int64_t> load_values;
+  for (int i = 0; i < (int)sorted_keys.size(); i += 2) {
+    load_keys.push_back(sorted_keys[i]);
+    load_values.push_back(i);
+  }
+  prefixbtreeolc::BTree<int64_t, Fanout> *bt = new prefixbtreeolc::BTree<int64_t, Fanout>();
+  bt->bulkLoad(load_keys, load_values, fill_factor);
+
+  for (int i = 0; i < (int)sorted_keys.size(); i++) {
+    prefixbtreeolc::Key key;
+    key.setKeyStr(sorted_keys[i].c_str(), sorted_keys[i].length());
+    int64_t re = -1;
+    bool find = bt->lookup(key, re);
+    ASSERT_EQ(i % 2 == 0, find);
+    if (find) {
+      ASSERT_EQ(i, re);
+    }
+  }
+
+  for (int i = 1; i < (int)sorted_keys.size(); i += 2) {
+    prefixbtreeolc::Key key;
+    key.setKeyStr(sorted_keys[i].c_str(), sorted_keys[i].length());
+    bt->insert(key, i);
+  }
+  prefixbtreeolc::Key key;
+  key.setKeyStr(sorted_keys[0].c_str(), sorted_keys[0].length());
+  prefixbtreeolc::BTreeOLCIterator<int64_t, Fanout> it(bt->root, key);
+  int cnt = 0;
+  for (; it.valid(); it.next(), cnt++) {
+    ASSERT_EQ(sorted_keys[cnt], it.key());
+    ASSERT_EQ(cnt, it.payload());
+  }
+  EXPECT_EQ((int)sorted_keys.size(), cnt);
+  delete bt;
+}
+
+TEST_F(PrefixBtreeUnitTest, bulkLoadTest) {
+  checkBulkLoad<prefixbtreeolc::DefaultFanout>(words, 0.9);
+  checkBulkLoad<prefixbtreeolc::DefaultFanout>(words, 1.0);
+  checkBulkLoad<prefixbtreeolc::Fanout1KB>(words, 0.7);
+  checkBulkLoad<prefixbtreeolc::Fanout4KB>(integers, 1.0);
+  checkBulkLoad<prefixbtreeolc::DefaultFanout>(std::vector<std::string>(1, "single"), 0.9);
+}
+
 std::string Uint64ToString(uint64_t key) {
   uint64_t endian_swapped_key = __builtin_bswap64(key);
   return std::string(reinterpret_cast<const char *>(&endian_swapped_key), 8);
@@ -0,0 +1,102 @@
+#include <sys/time.h>
+#include <time.h>
+
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "popcount.h"
+#include "select.hpp"
+#include "surf_builder.hpp"
+
+//-------------------------------------------------------------
+// Select microbenchmark on the LOUDS-Sparse bits of a SuRF built
+// from a key file: in-word select variants, and BitvectorSelect
+// with different sample intervals
+//-------------------------------------------------------------
+static const uint64_t kNumRecords = 10000000;
+static const int kNumQueries = 10000000;
+static const surf::position_t kSampleIntervals[] = {64, 32, 16, 8};
+
+double getNow() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+void loadKeysFromFile(const std::string &file_name, const uint64_t num_records, std::vector<std::string> &keys) {
+  std::ifstream infile(file_name);
+  std::string key;
+  uint64_t count = 0;
+  while (count < num_records && infile.good()) {
+    infile >> key;
+    keys.push_back(key);
+    count++;
+  }
+}
+
+template <typename Select64>
+void benchSelect64(const char *name, const std::vector<uint64_t> &words, const std::vector<int> &ranks,
+                   Select64 select64_fn) {
+  int64_t sum = 0;
+  double start_time = getNow();
+  for (int i = 0; i < (int)words.size(); i++) sum += select64_fn(words[i], ranks[i]);
+  double end_time = getNow();
+  std::cout << name << ": " << (end_time - start_time) * 1000000000 / words.size() << " ns/op"
+            << " (checksum " << sum << ")" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cout << "Usage: " << argv[0] << " <sorted key file>" << std::endl;
+    return -1;
+  }
+  std::vector<std::string> keys;
+  loadKeysFromFile(argv[1], kNumRecords, keys);
+
+  std::mt19937_64 gen(0);
+
+  // in-word select on random non-zero words
+  std::vector<uint64_t> words;
+  std::vector<int> ranks;
+  for (int i = 0; i < kNumQueries; i++) {
+    uint64_t word = gen() | 1;
+    words.push_back(word);
+    ranks.push_back(1 + gen() % popcount(word));
+  }
+  benchSelect64("select64_popcount_search", words, ranks, surf::select64_popcount_search);
+#ifdef __BMI2__
+  benchSelect64("select64_pdep", words, ranks, surf::select64_pdep);
+#endif
+
+  surf::SuRFBuilder *builder = new surf::SuRFBuilder(surf::kIncludeDense, surf::kSparseDenseRatio, surf::kNone, 0, 0);
+  builder->build(keys);
+  surf::level_t start_level = builder->getSparseStartLevel();
+  surf::level_t height = builder->getLabels().size();
+  std::vector<surf::position_t> num_items_per_level;
+  for (surf::level_t level = 0; level < height; level++)
+    num_items_per_level.push_back(builder->getLabels()[level].size());
+
+  for (surf::position_t sample_interval : kSampleIntervals) {
+    surf::BitvectorSelect *louds_bits = new surf::BitvectorSelect(sample_interval, builder->getLoudsBits(),
+                                                                  num_items_per_level, start_level, height);
+    std::uniform_int_distribution<surf::position_t> dist(1, louds_bits->numOnes());
+    std::vector<surf::position_t> select_ranks;
+    for (int i = 0; i < kNumQueries; i++) select_ranks.push_back(dist(gen));
+
+    uint64_t sum = 0;
+    double start_time = getNow();
+    for (int i = 0; i < kNumQueries; i++) sum += louds_bits->select(select_ranks[i]);
+    double end_time = getNow();
+    std::cout << "BitvectorSelect interval " << sample_interval << ": "
+              << (end_time - start_time) * 1000000000 / kNumQueries << " ns/op, lut "
+              << louds_bits->selectLutSize() << " of " << louds_bits->size() << " bytes"
+              << " (checksum " << sum << ")" << std::endl;
+    louds_bits->destroy();
+    delete louds_bits;
+  }
+  delete builder;
+  return 0;
+}
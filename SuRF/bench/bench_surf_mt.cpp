@@ -0,0 +1,105 @@
+#include <sys/time.h>
+#include <time.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "surf.hpp"
+
+//-------------------------------------------------------------
+// Multi-threaded SuRF probes: all threads share one filter and
+// run point (lookupKey) or range (lookupRange) queries on it
+//-------------------------------------------------------------
+static const uint64_t kNumRecords = 10000000;
+static const uint64_t kNumTxns = 10000000;
+static const int kMaxThreads = 8;
+
+double getNow() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+void loadKeysFromFile(const std::string &file_name, const uint64_t num_records, std::vector<std::string> &keys) {
+  std::ifstream infile(file_name);
+  std::string key;
+  uint64_t count = 0;
+  while (count < num_records && infile >> key) {
+    keys.push_back(key);
+    count++;
+  }
+}
+
+// Returns the throughput in Mops/s
+double runProbes(const surf::SuRF *filter, const std::vector<std::string> &txn_keys,
+                 const std::vector<std::string> &upper_bound_keys, const int num_threads, const bool range) {
+  std::vector<std::thread> threads;
+  std::vector<int64_t> positives(num_threads, 0);
+  double start_time = getNow();
+  for (int t = 0; t < num_threads; t++) {
+    threads.push_back(std::thread([&, t]() {
+      int64_t count = 0;
+      for (int i = t; i < (int)txn_keys.size(); i += num_threads) {
+        if (range)
+          count += (int)filter->lookupRange(txn_keys[i], true, upper_bound_keys[i], true);
+        else
+          count += (int)filter->lookupKey(txn_keys[i]);
+      }
+      positives[t] = count;
+    }));
+  }
+  for (int t = 0; t < num_threads; t++) threads[t].join();
+  double end_time = getNow();
+  int64_t total_positives = 0;
+  for (int t = 0; t < num_threads; t++) total_positives += positives[t];
+  std::cout << "positives = " << total_positives << std::endl;
+  return txn_keys.size() / (end_time - start_time) / 1000000;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cout << "Usage: " << argv[0] << " <key file> [max threads] [suffix len]" << std::endl;
+    return -1;
+  }
+  std::string file_name = argv[1];
+  int max_threads = (argc > 2) ? atoi(argv[2]) : kMaxThreads;
+  surf::level_t suffix_len = (argc > 3) ? (surf::level_t)atoi(argv[3]) : 8;
+
+  std::vector<std::string> keys;
+  loadKeysFromFile(file_name, kNumRecords, keys);
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  // every other key is inserted; probes draw from all keys
+  std::vector<std::string> insert_keys;
+  for (int i = 0; i < (int)keys.size(); i += 2) insert_keys.push_back(keys[i]);
+
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int> dist(0, (int)keys.size() - 2);
+  std::vector<std::string> txn_keys, upper_bound_keys;
+  for (uint64_t i = 0; i < std::min(kNumTxns, (uint64_t)keys.size()); i++) {
+    int idx = dist(gen);
+    txn_keys.push_back(keys[idx]);
+    upper_bound_keys.push_back(keys[idx + 1]);
+  }
+
+  surf::SuRF *filter = new surf::SuRF(insert_keys, surf::kIncludeDense, surf::kSparseDenseRatio,
+                                      surf::kReal, 0, suffix_len);
+  std::cout << "keys = " << insert_keys.size() << ", mem = " << filter->getMemoryUsage() << " bytes" << std::endl;
+
+  for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+    double point_tput = runProbes(filter, txn_keys, upper_bound_keys, num_threads, false);
+    double range_tput = runProbes(filter, txn_keys, upper_bound_keys, num_threads, true);
+    std::cout << "threads = " << num_threads << ", point = " << point_tput << " Mops/s"
+              << ", range = " << range_tput << " Mops/s" << std::endl;
+  }
+
+  filter->destroy();
+  delete filter;
+  return 0;
+}
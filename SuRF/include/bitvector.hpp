@@ -50,6 +50,10 @@ public:
 
     bool readBit(const position_t pos) const;
 
+    void prefetch(const position_t pos) const {
+	__builtin_prefetch(bits_ + (pos / kWordSize));
+    }
+
     position_t distanceToNextSetBit(const position_t pos) const;
     position_t distanceToPrevSetBit(const position_t pos) const;
 
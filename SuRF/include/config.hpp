@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <string>
+
 namespace surf {
 
 #define PRINT_TRIE_HEIGHT 1
@@ -13,6 +15,10 @@ using position_t = uint32_t;
 
 using label_t = uint8_t;
 static const position_t kFanout = 256;
+// Label widths: one byte per trie level, or one nibble per level for
+// keys that are already bit streams (e.g., HOPE-encoded keys)
+static const level_t kByteLabelBits = 8;
+static const level_t kNibbleLabelBits = 4;
 
 using word_t = uint64_t;
 static const unsigned kWordSize = 64;
@@ -35,6 +41,34 @@ enum SuffixType {
     kMixed = 3
 };
 
+// A point lookup in flight in SuRF::lookupKeys. Each step advances the
+// probe by one trie level and prefetches what the next step reads.
+struct LookupProbe {
+    enum Stage {
+	kDense = 0,        // pos in LOUDS-Dense is prefetched
+	kSparseNode = 1,   // select lookup table slot for node_num is prefetched
+	kSparseSelect = 2, // select bits for node_num are prefetched
+	kSparseLabel = 3,  // labels of the node at pos are prefetched
+	kDone = 4
+    };
+
+    const std::string* key;
+    level_t level;
+    position_t node_num;
+    position_t pos;
+    Stage stage;
+    bool result;
+};
+
+// Result of SuRF::approxCount. Stored keys are truncated, so a boundary
+// key may or may not fall in the range: the true count is in
+// [lower, upper], and count is the number of keys between the boundaries.
+struct CountEstimate {
+    uint64_t count;
+    uint64_t lower;
+    uint64_t upper;
+};
+
 void align(char*& ptr) {
     ptr = (char*)(((uint64_t)ptr + 7) & ~((uint64_t)7));
 }
@@ -11,24 +11,32 @@ namespace surf {
 
 class LabelVector {
 public:
-    LabelVector() : num_bytes_(0), labels_(nullptr) {};
+    LabelVector() : num_bytes_(0), label_bits_(kByteLabelBits), labels_(nullptr) {};
 
+    // With label_bits = kNibbleLabelBits, two labels are packed per byte
+    // (high nibble first) and the terminator is stored as 0xF. Like 0xFF
+    // in byte mode, it is told apart from a real 0xF label by position:
+    // a terminator is always the first label of a node with more than one
+    // label, where a real maximum label cannot appear.
     LabelVector(const std::vector<std::vector<label_t> >& labels_per_level,
 		const level_t start_level = 0,
-		level_t end_level = 0/* non-inclusive */) {
+		level_t end_level = 0/* non-inclusive */,
+		const level_t label_bits = kByteLabelBits) : label_bits_(label_bits) {
 	if (end_level == 0)
 	    end_level = labels_per_level.size();
 
-	num_bytes_ = 1;
+	position_t num_labels = 0;
 	for (level_t level = start_level; level < end_level; level++)
-	    num_bytes_ += labels_per_level[level].size();
+	    num_labels += labels_per_level[level].size();
+	num_bytes_ = (num_labels * label_bits_ + 7) / 8 + 1;
 
 	labels_ = new label_t[num_bytes_];
+	memset(labels_, 0, num_bytes_);
 
 	position_t pos = 0;
 	for (level_t level = start_level; level < end_level; level++) {
 	    for (position_t idx = 0; idx < labels_per_level[level].size(); idx++) {
-		labels_[pos] = labels_per_level[level][idx];
+		write(pos, labels_per_level[level][idx]);
 		pos++;
 	    }
 	}
@@ -40,8 +48,16 @@ public:
 	return num_bytes_;
     }
 
+    level_t getLabelBits() const {
+	return label_bits_;
+    }
+
+    label_t terminator() const {
+	return (label_t)(kTerminator >> (kByteLabelBits - label_bits_));
+    }
+
     position_t serializedSize() const {
-	position_t size = sizeof(num_bytes_) + num_bytes_;
+	position_t size = sizeof(num_bytes_) + sizeof(label_bits_) + num_bytes_;
 	sizeAlign(size);
 	return size;
     }
@@ -51,11 +67,17 @@ public:
     }
 
     label_t read(const position_t pos) const {
-	return labels_[pos];
+	if (label_bits_ == kByteLabelBits)
+	    return labels_[pos];
+	return (labels_[pos >> 1] >> ((~pos & 1) << 2)) & 0xF;
     }
 
     label_t operator[](const position_t pos) const {
-	return labels_[pos];
+	return read(pos);
+    }
+
+    void prefetch(const position_t pos) const {
+	__builtin_prefetch(labels_ + ((pos * label_bits_) >> 3));
     }
 
     bool search(const label_t target, position_t& pos, const position_t search_len) const;
@@ -68,9 +90,15 @@ public:
     bool binarySearchGreaterThan(const label_t target, position_t& pos, const position_t search_len) const;
     bool linearSearchGreaterThan(const label_t target, position_t& pos, const position_t search_len) const;
 
+    // Nodes have at most 17 nibble labels: a linear scan is enough
+    bool nibbleSearch(const label_t target, position_t& pos, const position_t search_len) const;
+    bool nibbleSearchGreaterThan(const label_t target, position_t& pos, const position_t search_len) const;
+
     void serialize(char*& dst) const {
 	memcpy(dst, &num_bytes_, sizeof(num_bytes_));
 	dst += sizeof(num_bytes_);
+	memcpy(dst, &label_bits_, sizeof(label_bits_));
+	dst += sizeof(label_bits_);
 	memcpy(dst, labels_, num_bytes_);
 	dst += num_bytes_;
 	align(dst);
@@ -80,6 +108,8 @@ public:
 	LabelVector* lv = new LabelVector();
 	memcpy(&(lv->num_bytes_), src, sizeof(lv->num_bytes_));
 	src += sizeof(lv->num_bytes_);
+	memcpy(&(lv->label_bits_), src, sizeof(lv->label_bits_));
+	src += sizeof(lv->label_bits_);
 	lv->labels_ = const_cast<label_t*>(reinterpret_cast<const label_t*>(src));
 	src += lv->num_bytes_;
 	align(src);
@@ -91,17 +121,27 @@ public:
     }
 
 private:
+    void write(const position_t pos, const label_t label) {
+	if (label_bits_ == kByteLabelBits)
+	    labels_[pos] = label;
+	else
+	    labels_[pos >> 1] |= (label & 0xF) << ((~pos & 1) << 2);
+    }
+
     position_t num_bytes_;
+    level_t label_bits_;
     label_t* labels_;
 };
 
 bool LabelVector::search(const label_t target, position_t& pos, position_t search_len) const {
     //skip terminator label
-    if ((search_len > 1) && (labels_[pos] == kTerminator)) {
+    if ((search_len > 1) && (read(pos) == terminator())) {
 	pos++;
 	search_len--;
     }
 
+    if (label_bits_ != kByteLabelBits)
+	return nibbleSearch(target, pos, search_len);
     if (search_len < 3)
 	return linearSearch(target, pos, search_len);
     if (search_len < 12)
@@ -112,11 +152,13 @@ bool LabelVector::search(const label_t target, position_t& pos, position_t searc
 
 bool LabelVector::searchGreaterThan(const label_t target, position_t& pos, position_t search_len) const {
     //skip terminator label
-    if ((search_len > 1) && (labels_[pos] == kTerminator)) {
+    if ((search_len > 1) && (read(pos) == terminator())) {
 	pos++;
 	search_len--;
     }
 
+    if (label_bits_ != kByteLabelBits)
+	return nibbleSearchGreaterThan(target, pos, search_len);
     if (search_len < 3)
 	return linearSearchGreaterThan(target, pos, search_len);
     else
@@ -216,6 +258,26 @@ bool LabelVector::linearSearchGreaterThan(const label_t target, position_t& pos,
     return false;
 }
 
+bool LabelVector::nibbleSearch(const label_t target, position_t& pos, const position_t search_len) const {
+    for (position_t i = 0; i < search_len; i++) {
+	if (target == read(pos + i)) {
+	    pos += i;
+	    return true;
+	}
+    }
+    return false;
+}
+
+bool LabelVector::nibbleSearchGreaterThan(const label_t target, position_t& pos, const position_t search_len) const {
+    for (position_t i = 0; i < search_len; i++) {
+	if (read(pos + i) > target) {
+	    pos += i;
+	    return true;
+	}
+    }
+    return false;
+}
+
 } // namespace surf
 
 #endif // LABELVECTOR_H_
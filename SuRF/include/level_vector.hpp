@@ -0,0 +1,60 @@
+#ifndef LEVELVECTOR_H_
+#define LEVELVECTOR_H_
+
+#include <vector>
+
+#include "config.hpp"
+
+namespace surf {
+
+// Per-level state of a trie iterator. Up to kInlineLevels levels are
+// stored inline, so that iterators over tries of common heights can
+// live on the stack without allocating.
+template <typename T>
+class LevelVector {
+public:
+    static const level_t kInlineLevels = 64;
+
+    LevelVector() : size_(0) {};
+
+    // New levels are zero-filled
+    void resize(const level_t size) {
+	if (size > kInlineLevels) {
+	    if (heap_.empty())
+		heap_.assign(inline_, inline_ + size_);
+	    heap_.resize(size, 0);
+	} else
+	    for (level_t i = size_; i < size; i++)
+		inline_[i] = 0;
+	size_ = size;
+    }
+
+    level_t size() const {
+	return size_;
+    }
+
+    T* data() {
+	return (size_ > kInlineLevels) ? heap_.data() : inline_;
+    }
+
+    const T* data() const {
+	return (size_ > kInlineLevels) ? heap_.data() : inline_;
+    }
+
+    T& operator[](const level_t level) {
+	return data()[level];
+    }
+
+    const T& operator[](const level_t level) const {
+	return data()[level];
+    }
+
+private:
+    level_t size_;
+    T inline_[kInlineLevels];
+    std::vector<T> heap_;
+};
+
+} // namespace surf
+
+#endif // LEVELVECTOR_H_
@@ -4,6 +4,7 @@
 #include <string>
 
 #include "config.hpp"
+#include "level_vector.hpp"
 #include "rank.hpp"
 #include "suffix.hpp"
 #include "surf_builder.hpp"
@@ -15,16 +16,14 @@ public:
     class Iter {
     public:
 	Iter() : is_valid_(false) {};
-	Iter(LoudsDense* trie) : is_valid_(false), is_search_complete_(false),
-				 is_move_left_complete_(false),
-				 is_move_right_complete_(false),
-				 trie_(trie),
-				 send_out_node_num_(0), key_len_(0),
-				 is_at_prefix_key_(false) {
-	    for (level_t level = 0; level < trie_->getHeight(); level++) {
-		key_.push_back(0);
-		pos_in_trie_.push_back(0);
-	    }
+	Iter(const LoudsDense* trie) : is_valid_(false), is_search_complete_(false),
+				       is_move_left_complete_(false),
+				       is_move_right_complete_(false),
+				       trie_(trie),
+				       send_out_node_num_(0), key_len_(0),
+				       is_at_prefix_key_(false) {
+	    key_.resize(trie_->getHeight());
+	    pos_in_trie_.resize(trie_->getHeight());
 	}
 
 	void clear();
@@ -42,6 +41,10 @@ public:
 	int getSuffix(word_t* suffix) const;
 	std::string getKeyWithSuffix(unsigned* bitlen) const;
 	position_t getSendOutNodeNum() const { return send_out_node_num_; };
+	// Position of the iterator at level, or false if its key ends above
+	// level. At a prefix key, pos is the start of the node holding it
+	// and with_prefix_key is set (see LoudsDense::countKeysBefore)
+	bool getCut(const level_t level, position_t& pos, bool& with_prefix_key) const;
 
 	void setToFirstLabelInRoot();
 	void setToLastLabelInRoot();
@@ -68,12 +71,12 @@ public:
 	bool is_move_left_complete_;
 	// If false, call moveToRightMostKey in LoudsSparse to complete
 	bool is_move_right_complete_; 
-	LoudsDense* trie_;
+	const LoudsDense* trie_;
 	position_t send_out_node_num_;
 	level_t key_len_; // Does NOT include suffix
 
-	std::vector<label_t> key_;
-	std::vector<position_t> pos_in_trie_;
+	LevelVector<label_t> key_;
+	LevelVector<position_t> pos_in_trie_;
 	bool is_at_prefix_key_;
 
 	friend class LoudsDense;
@@ -88,9 +91,22 @@ public:
     // Returns whether key exists in the trie so far
     // out_node_num == 0 means search terminates in louds-dense.
     bool lookupKey(const std::string& key, position_t& out_node_num) const;
+    // Batched form of lookupKey, one level per step (see LookupProbe).
+    // When the walk leaves the dense levels, the probe moves to
+    // LookupProbe::kSparseNode with node_num set.
+    void prefetchLookup(LookupProbe& probe) const;
+    void lookupStep(LookupProbe& probe) const;
     // return value indicates potential false positive
     bool moveToKeyGreaterThan(const std::string& key, 
 			      const bool inclusive, LoudsDense::Iter& iter) const;
+    // For SuRF::approxCount: a cut at pos splits the trie level that
+    // holds pos. Returns the number of keys before the cut; the prefix
+    // key of the node holding pos is after the cut if with_prefix_key.
+    position_t countKeysBefore(const position_t pos, const bool with_prefix_key) const;
+    // Number of child branches before the cut; their child nodes
+    // precede the cut one level down
+    position_t countChildrenBefore(const position_t pos) const;
+    position_t getNodeStartPos(const position_t node_num) const { return node_num * node_fanout_; };
 
     uint64_t getHeight() const { return height_; };
     uint64_t serializedSize() const;
@@ -99,6 +115,8 @@ public:
     void serialize(char*& dst) const {
 	memcpy(dst, &height_, sizeof(height_));
 	dst += sizeof(height_);
+	memcpy(dst, &node_fanout_, sizeof(node_fanout_));
+	dst += sizeof(node_fanout_);
 	align(dst);
 	label_bitmaps_->serialize(dst);
 	child_indicator_bitmaps_->serialize(dst);
@@ -111,6 +129,8 @@ public:
 	LoudsDense* louds_dense = new LoudsDense();
 	memcpy(&(louds_dense->height_), src, sizeof(louds_dense->height_));
 	src += sizeof(louds_dense->height_);
+	memcpy(&(louds_dense->node_fanout_), src, sizeof(louds_dense->node_fanout_));
+	src += sizeof(louds_dense->node_fanout_);
 	align(src);
 	louds_dense->label_bitmaps_ = BitvectorRank::deSerialize(src);
 	louds_dense->child_indicator_bitmaps_ = BitvectorRank::deSerialize(src);
@@ -138,10 +158,10 @@ private:
 				  LoudsDense::Iter& iter) const;
 
 private:
-    static const position_t kNodeFanout = 256;
     static const position_t kRankBasicBlockSize  = 512;
 
     level_t height_;
+    position_t node_fanout_; // 256 for byte labels, 16 for nibble labels
 
     BitvectorRank* label_bitmaps_;
     BitvectorRank* child_indicator_bitmaps_;
@@ -152,9 +172,10 @@ private:
 
 LoudsDense::LoudsDense(const SuRFBuilder* builder) {
     height_ = builder->getSparseStartLevel();
+    node_fanout_ = builder->getFanout();
     std::vector<position_t> num_bits_per_level;
     for (level_t level = 0; level < height_; level++)
-	num_bits_per_level.push_back(builder->getBitmapLabels()[level].size() * kWordSize);
+	num_bits_per_level.push_back(builder->getNodeCounts()[level] * node_fanout_);
 
     label_bitmaps_ = new BitvectorRank(kRankBasicBlockSize, builder->getBitmapLabels(),
 				       num_bits_per_level, 0, height_);
@@ -185,7 +206,7 @@ bool LoudsDense::lookupKey(const std::string& key, position_t& out_node_num) con
     position_t node_num = 0;
     position_t pos = 0;
     for (level_t level = 0; level < height_; level++) {
-	pos = (node_num * kNodeFanout);
+	pos = (node_num * node_fanout_);
 	if (level >= key.length()) { //if run out of searchKey bytes
 	    if (prefixkey_indicator_bits_->readBit(node_num)) //if the prefix is also a key
 		return suffixes_->checkEquality(getSuffixPos(pos, true), key, level + 1);
@@ -209,13 +230,51 @@ bool LoudsDense::lookupKey(const std::string& key, position_t& out_node_num) con
     return true;
 }
 
+void LoudsDense::prefetchLookup(LookupProbe& probe) const {
+    probe.pos = probe.node_num * node_fanout_;
+    if (probe.level >= probe.key->length()) {
+	prefixkey_indicator_bits_->prefetch(probe.node_num);
+	return;
+    }
+    probe.pos += (label_t)(*probe.key)[probe.level];
+    label_bitmaps_->prefetch(probe.pos);
+    child_indicator_bitmaps_->prefetch(probe.pos);
+}
+
+void LoudsDense::lookupStep(LookupProbe& probe) const {
+    const std::string& key = *probe.key;
+    position_t pos = probe.pos;
+    probe.stage = LookupProbe::kDone;
+    if (probe.level >= key.length()) { //if run out of searchKey bytes
+	probe.result = prefixkey_indicator_bits_->readBit(probe.node_num)
+	    && suffixes_->checkEquality(getSuffixPos(pos, true), key, probe.level + 1);
+	return;
+    }
+    if (!label_bitmaps_->readBit(pos)) {
+	probe.result = false;
+	return;
+    }
+    if (!child_indicator_bitmaps_->readBit(pos)) {
+	probe.result = suffixes_->checkEquality(getSuffixPos(pos, false), key, probe.level + 1);
+	return;
+    }
+    probe.node_num = getChildNodeNum(pos);
+    probe.level++;
+    if (probe.level < height_) {
+	probe.stage = LookupProbe::kDense;
+	prefetchLookup(probe);
+    } else {
+	probe.stage = LookupProbe::kSparseNode;
+    }
+}
+
 bool LoudsDense::moveToKeyGreaterThan(const std::string& key, 
 				      const bool inclusive, LoudsDense::Iter& iter) const {
     position_t node_num = 0;
     position_t pos = 0;
     for (level_t level = 0; level < height_; level++) {
 	// if is_at_prefix_key_, pos is at the next valid position in the child node
-	pos = node_num * kNodeFanout;
+	pos = node_num * node_fanout_;
 	if (level >= key.length()) { // if run out of searchKey bytes
 	    iter.append(getNextPos(pos - 1));
 	    if (prefixkey_indicator_bits_->readBit(node_num)) //if the prefix is also a key
@@ -248,8 +307,26 @@ bool LoudsDense::moveToKeyGreaterThan(const std::string& key,
     return true;
 }
 
+position_t LoudsDense::countKeysBefore(const position_t pos, const bool with_prefix_key) const {
+    if (pos == 0)
+	return 0;
+    position_t node_num = pos / node_fanout_;
+    position_t num_keys = label_bitmaps_->rank(pos - 1) - child_indicator_bitmaps_->rank(pos - 1);
+    if (node_num > 0)
+	num_keys += prefixkey_indicator_bits_->rank(node_num - 1);
+    if (!with_prefix_key && prefixkey_indicator_bits_->readBit(node_num))
+	num_keys++;
+    return num_keys;
+}
+
+position_t LoudsDense::countChildrenBefore(const position_t pos) const {
+    if (pos == 0)
+	return 0;
+    return child_indicator_bitmaps_->rank(pos - 1);
+}
+
 uint64_t LoudsDense::serializedSize() const {
-    uint64_t size = sizeof(height_)
+    uint64_t size = sizeof(height_) + sizeof(node_fanout_)
 	+ label_bitmaps_->serializedSize()
 	+ child_indicator_bitmaps_->serializedSize()
 	+ prefixkey_indicator_bits_->serializedSize()
@@ -271,7 +348,7 @@ position_t LoudsDense::getChildNodeNum(const position_t pos) const {
 }
 
 position_t LoudsDense::getSuffixPos(const position_t pos, const bool is_prefix_key) const {
-    position_t node_num = pos / kNodeFanout;
+    position_t node_num = pos / node_fanout_;
     position_t suffix_pos = (label_bitmaps_->rank(pos)
 			     - child_indicator_bitmaps_->rank(pos)
 			     + prefixkey_indicator_bits_->rank(node_num)
@@ -311,6 +388,16 @@ bool LoudsDense::compareSuffixGreaterThan(const position_t pos, const std::strin
 
 //============================================================================
 
+bool LoudsDense::Iter::getCut(const level_t level, position_t& pos, bool& with_prefix_key) const {
+    if (level >= key_len_)
+	return false;
+    pos = pos_in_trie_[level];
+    with_prefix_key = (is_at_prefix_key_ && (level == key_len_ - 1));
+    if (with_prefix_key)
+	pos -= pos % trie_->node_fanout_;
+    return true;
+}
+
 void LoudsDense::Iter::clear() {
     is_valid_ = false;
     key_len_ = 0;
@@ -376,14 +463,14 @@ std::string LoudsDense::Iter::getKeyWithSuffix(unsigned* bitlen) const {
 
 void LoudsDense::Iter::append(position_t pos) {
     assert(key_len_ < key_.size());
-    key_[key_len_] = (label_t)(pos % kNodeFanout);
+    key_[key_len_] = (label_t)(pos % trie_->node_fanout_);
     pos_in_trie_[key_len_] = pos;
     key_len_++;
 }
 
 void LoudsDense::Iter::set(level_t level, position_t pos) {
     assert(level < key_.size());
-    key_[level] = (label_t)(pos % kNodeFanout);
+    key_[level] = (label_t)(pos % trie_->node_fanout_);
     pos_in_trie_[level] = pos;
 }
 
@@ -410,7 +497,7 @@ void LoudsDense::Iter::setToFirstLabelInRoot() {
 
 void LoudsDense::Iter::setToLastLabelInRoot() {
     bool is_out_of_bound;
-    pos_in_trie_[0] = trie_->getPrevPos(kNodeFanout, &is_out_of_bound);
+    pos_in_trie_[0] = trie_->getPrevPos(trie_->node_fanout_, &is_out_of_bound);
     key_[0] = (label_t)pos_in_trie_[0];
     key_len_++;
 }
@@ -427,13 +514,13 @@ void LoudsDense::Iter::moveToLeftMostKey() {
 	position_t node_num = trie_->getChildNodeNum(pos);
 	//if the current prefix is also a key
 	if (trie_->prefixkey_indicator_bits_->readBit(node_num)) {
-	    append(trie_->getNextPos(node_num * kNodeFanout - 1));
+	    append(trie_->getNextPos(node_num * trie_->node_fanout_ - 1));
 	    is_at_prefix_key_ = true;
 	    // valid, search complete, moveLeft complete, moveRight complete
 	    return setFlags(true, true, true, true);
 	}
 
-	pos = trie_->getNextPos(node_num * kNodeFanout - 1);
+	pos = trie_->getNextPos(node_num * trie_->node_fanout_ - 1);
 	append(pos);
 
 	// if trie branch terminates
@@ -459,7 +546,7 @@ void LoudsDense::Iter::moveToRightMostKey() {
     while (level < trie_->getHeight() - 1) {
 	position_t node_num = trie_->getChildNodeNum(pos);
 	bool is_out_of_bound;
-	pos = trie_->getPrevPos((node_num + 1) * kNodeFanout, &is_out_of_bound);
+	pos = trie_->getPrevPos((node_num + 1) * trie_->node_fanout_, &is_out_of_bound);
 	if (is_out_of_bound) {
 	    is_valid_ = false;
 	    return;
@@ -487,7 +574,7 @@ void LoudsDense::Iter::operator ++(int) {
     position_t pos = pos_in_trie_[key_len_ - 1];
     position_t next_pos = trie_->getNextPos(pos);
     // if crossing node boundary
-    while ((next_pos / kNodeFanout) > (pos / kNodeFanout)) {
+    while ((next_pos / trie_->node_fanout_) > (pos / trie_->node_fanout_)) {
 	key_len_--;
 	if (key_len_ == 0) {
 	    is_valid_ = false;
@@ -515,9 +602,9 @@ void LoudsDense::Iter::operator --(int) {
     }
     
     // if crossing node boundary
-    while ((prev_pos / kNodeFanout) < (pos / kNodeFanout)) {
+    while ((prev_pos / trie_->node_fanout_) < (pos / trie_->node_fanout_)) {
 	//if the current prefix is also a key
-	position_t node_num = pos / kNodeFanout;
+	position_t node_num = pos / trie_->node_fanout_;
 	if (trie_->prefixkey_indicator_bits_->readBit(node_num)) {
 	    is_at_prefix_key_ = true;
 	    // valid, search complete, moveLeft complete, moveRight complete
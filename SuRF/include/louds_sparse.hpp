@@ -4,6 +4,7 @@
 #include <string>
 
 #include "config.hpp"
+#include "level_vector.hpp"
 #include "label_vector.hpp"
 #include "rank.hpp"
 #include "select.hpp"
@@ -17,13 +18,11 @@ public:
     class Iter {
     public:
 	Iter() : is_valid_(false) {};
-	Iter(LoudsSparse* trie) : is_valid_(false), trie_(trie), start_node_num_(0), 
-				  key_len_(0), is_at_terminator_(false) {
+	Iter(const LoudsSparse* trie) : is_valid_(false), trie_(trie), start_node_num_(0), 
+					key_len_(0), is_at_terminator_(false) {
 	    start_level_ = trie_->getStartLevel();
-	    for (level_t level = start_level_; level < trie_->getHeight(); level++) {
-		key_.push_back(0);
-		pos_in_trie_.push_back(0);
-	    }
+	    key_.resize(trie_->getHeight() - start_level_);
+	    pos_in_trie_.resize(trie_->getHeight() - start_level_);
 	}
 
 	void clear();
@@ -35,6 +34,9 @@ public:
 
 	position_t getStartNodeNum() const { return start_node_num_; };
 	void setStartNodeNum(position_t node_num) { start_node_num_ = node_num; };
+	// Position of the iterator at level (counted from the root), or
+	// false if its key does not reach level
+	bool getCut(const level_t level, position_t& pos) const;
 
 	void setToFirstLabelInRoot();
 	void setToLastLabelInRoot();
@@ -50,13 +52,13 @@ public:
 
     private:
 	bool is_valid_; // True means the iter currently points to a valid key
-	LoudsSparse* trie_;
+	const LoudsSparse* trie_;
 	level_t start_level_;
 	position_t start_node_num_; // Passed in by the dense iterator; default = 0
 	level_t key_len_; // Start counting from start_level_; does NOT include suffix
 
-	std::vector<label_t> key_;
-	std::vector<position_t> pos_in_trie_;
+	LevelVector<label_t> key_;
+	LevelVector<position_t> pos_in_trie_;
 	bool is_at_terminator_;
 
 	friend class LoudsSparse;
@@ -71,9 +73,19 @@ public:
     // point query: trie walk starts at node "in_node_num" instead of root
     // in_node_num is provided by louds-dense's lookupKey function
     bool lookupKey(const std::string& key, const position_t in_node_num) const;
+    // Batched form of lookupKey, starting from a probe in
+    // LookupProbe::kSparseNode; a level takes three steps (select lookup
+    // table, select, label search) so that each can be prefetched.
+    void prefetchLookup(const LookupProbe& probe) const;
+    void lookupStep(LookupProbe& probe) const;
     // return value indicates potential false positive
     bool moveToKeyGreaterThan(const std::string& key, 
 			      const bool inclusive, LoudsSparse::Iter& iter) const;
+    // For SuRF::approxCount; see LoudsDense::countKeysBefore.
+    // getNodeStartPos returns the end of the trie past the last node
+    position_t countKeysBefore(const position_t pos) const;
+    position_t countChildrenBefore(const position_t pos) const;
+    position_t getNodeStartPos(const position_t node_num) const;
 
     level_t getHeight() const { return height_; };
     level_t getStartLevel() const { return start_level_; };
@@ -129,6 +141,9 @@ private:
     position_t getLastLabelPos(const position_t node_num) const;
     position_t getSuffixPos(const position_t pos) const;
     position_t nodeSize(const position_t pos) const;
+    // A terminator is the first label of a node with more than one label;
+    // a real maximum label cannot sit there
+    inline bool isTerminator(const label_t label, const position_t pos) const;
 
     void moveToLeftInNextSubtrie(position_t pos, const position_t node_size, 
 				 const label_t label, LoudsSparse::Iter& iter) const;
@@ -139,7 +154,7 @@ private:
 
 private:
     static const position_t kRankBasicBlockSize = 512;
-    static const position_t kSelectSampleInterval = 64;
+    static const position_t kSelectSampleInterval = 32;
 
     level_t height_; // trie height
     level_t start_level_; // louds-sparse encoding starts at this level
@@ -168,7 +183,8 @@ LoudsSparse::LoudsSparse(const SuRFBuilder* builder) {
     else
 	child_count_dense_ = node_count_dense_ + builder->getNodeCounts()[start_level_] - 1;
 
-    labels_ = new LabelVector(builder->getLabels(), start_level_, height_);
+    labels_ = new LabelVector(builder->getLabels(), start_level_, height_,
+			      builder->getLabelBits());
 
     std::vector<position_t> num_items_per_level;
     for (level_t level = 0; level < height_; level++)
@@ -212,11 +228,54 @@ bool LoudsSparse::lookupKey(const std::string& key, const position_t in_node_num
 	node_num = getChildNodeNum(pos);
 	pos = getFirstLabelPos(node_num);
     }
-    if ((labels_->read(pos) == kTerminator) && (!child_indicator_bits_->readBit(pos)))
+    if (isTerminator(labels_->read(pos), pos) && (!child_indicator_bits_->readBit(pos)))
 	return suffixes_->checkEquality(getSuffixPos(pos), key, level + 1);
     return false;
 }
 
+void LoudsSparse::prefetchLookup(const LookupProbe& probe) const {
+    louds_bits_->prefetchSelect(probe.node_num + 1 - node_count_dense_);
+}
+
+void LoudsSparse::lookupStep(LookupProbe& probe) const {
+    if (probe.stage == LookupProbe::kSparseNode) {
+	louds_bits_->prefetchSelectBits(probe.node_num + 1 - node_count_dense_);
+	probe.stage = LookupProbe::kSparseSelect;
+	return;
+    }
+    if (probe.stage == LookupProbe::kSparseSelect) {
+	probe.pos = getFirstLabelPos(probe.node_num);
+	labels_->prefetch(probe.pos);
+	louds_bits_->prefetch(probe.pos);
+	child_indicator_bits_->prefetch(probe.pos);
+	probe.stage = LookupProbe::kSparseLabel;
+	return;
+    }
+
+    const std::string& key = *probe.key;
+    position_t pos = probe.pos;
+    level_t level = probe.level;
+    probe.stage = LookupProbe::kDone;
+    if (level >= key.length()) {
+	probe.result = isTerminator(labels_->read(pos), pos) && !child_indicator_bits_->readBit(pos)
+	    && suffixes_->checkEquality(getSuffixPos(pos), key, level + 1);
+	return;
+    }
+    if (!labels_->search((label_t)key[level], pos, nodeSize(pos))) {
+	probe.result = false;
+	return;
+    }
+    // if trie branch terminates
+    if (!child_indicator_bits_->readBit(pos)) {
+	probe.result = suffixes_->checkEquality(getSuffixPos(pos), key, level + 1);
+	return;
+    }
+    probe.node_num = getChildNodeNum(pos);
+    probe.level++;
+    probe.stage = LookupProbe::kSparseNode;
+    prefetchLookup(probe);
+}
+
 bool LoudsSparse::moveToKeyGreaterThan(const std::string& key, 
 				       const bool inclusive, LoudsSparse::Iter& iter) const {
     position_t node_num = iter.getStartNodeNum();
@@ -242,9 +301,8 @@ bool LoudsSparse::moveToKeyGreaterThan(const std::string& key,
 	pos = getFirstLabelPos(node_num);
     }
 
-    if ((labels_->read(pos) == kTerminator) && (!child_indicator_bits_->readBit(pos))
-	&& !louds_bits_->readBit(pos + 1)) {
-	iter.append(kTerminator, pos);
+    if (isTerminator(labels_->read(pos), pos) && (!child_indicator_bits_->readBit(pos))) {
+	iter.append(labels_->terminator(), pos);
 	iter.is_at_terminator_ = true;
 	if (!inclusive)
 	    iter++;
@@ -261,6 +319,24 @@ bool LoudsSparse::moveToKeyGreaterThan(const std::string& key,
     return true;
 }
 
+position_t LoudsSparse::countKeysBefore(const position_t pos) const {
+    if (pos == 0)
+	return 0;
+    return (pos - child_indicator_bits_->rank(pos - 1));
+}
+
+position_t LoudsSparse::countChildrenBefore(const position_t pos) const {
+    if (pos == 0)
+	return child_count_dense_;
+    return (child_indicator_bits_->rank(pos - 1) + child_count_dense_);
+}
+
+position_t LoudsSparse::getNodeStartPos(const position_t node_num) const {
+    if (node_num + 1 - node_count_dense_ > louds_bits_->numOnes())
+	return louds_bits_->numBits();
+    return getFirstLabelPos(node_num);
+}
+
 uint64_t LoudsSparse::serializedSize() const {
     uint64_t size = sizeof(height_) + sizeof(start_level_)
 	+ sizeof(node_count_dense_) + sizeof(child_count_dense_)
@@ -299,6 +375,11 @@ position_t LoudsSparse::getSuffixPos(const position_t pos) const {
     return (pos - child_indicator_bits_->rank(pos));
 }
 
+bool LoudsSparse::isTerminator(const label_t label, const position_t pos) const {
+    return (label == labels_->terminator())
+	&& (pos + 1 < louds_bits_->numBits()) && !louds_bits_->readBit(pos + 1);
+}
+
 position_t LoudsSparse::nodeSize(const position_t pos) const {
     assert(louds_bits_->readBit(pos));
     return louds_bits_->distanceToNextSetBit(pos);
@@ -331,6 +412,13 @@ bool LoudsSparse::compareSuffixGreaterThan(const position_t pos, const std::stri
 
 //============================================================================
 
+bool LoudsSparse::Iter::getCut(const level_t level, position_t& pos) const {
+    if ((level < start_level_) || (level - start_level_ >= key_len_))
+	return false;
+    pos = pos_in_trie_[level - start_level_];
+    return true;
+}
+
 void LoudsSparse::Iter::clear() {
     is_valid_ = false;
     key_len_ = 0;
@@ -435,7 +523,7 @@ void LoudsSparse::Iter::moveToLeftMostKey() {
     label_t label = trie_->labels_->read(pos);
 
     if (!trie_->child_indicator_bits_->readBit(pos)) {
-	if ((label == kTerminator) && !trie_->louds_bits_->readBit(pos + 1))
+	if (trie_->isTerminator(label, pos))
 	    is_at_terminator_ = true;
 	is_valid_ = true;
 	return;
@@ -448,7 +536,7 @@ void LoudsSparse::Iter::moveToLeftMostKey() {
 	// if trie branch terminates
 	if (!trie_->child_indicator_bits_->readBit(pos)) {
 	    append(label, pos);
-	    if ((label == kTerminator) && !trie_->louds_bits_->readBit(pos + 1))
+	    if (trie_->isTerminator(label, pos))
 		is_at_terminator_ = true;
 	    is_valid_ = true;
 	    return;
@@ -472,7 +560,7 @@ void LoudsSparse::Iter::moveToRightMostKey() {
     label_t label = trie_->labels_->read(pos);
 
     if (!trie_->child_indicator_bits_->readBit(pos)) {
-	if ((label == kTerminator) && !trie_->louds_bits_->readBit(pos + 1))
+	if (trie_->isTerminator(label, pos))
 	    is_at_terminator_ = true;
 	is_valid_ = true;
 	return;
@@ -485,7 +573,7 @@ void LoudsSparse::Iter::moveToRightMostKey() {
 	// if trie branch terminates
 	if (!trie_->child_indicator_bits_->readBit(pos)) {
 	    append(label, pos);
-	    if ((label == kTerminator) && !trie_->louds_bits_->readBit(pos + 1))
+	    if (trie_->isTerminator(label, pos))
 		is_at_terminator_ = true;
 	    is_valid_ = true;
 	    return;
@@ -6,6 +6,10 @@
 #include <stdio.h>
 #include <stdint.h>
 
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
 namespace surf {
 
 #define L8 0x0101010101010101ULL // Every lowest 8th bit set: 00000001...
@@ -144,8 +148,21 @@ inline int select64_broadword(uint64_t x, int k) {
     return place + ( LEQ_STEP_8( bit_sums, byte_rank_step_8 ) * ONES_STEP_8 >> 56 );   
 }
 
+#ifdef __BMI2__
+// Same result as select64_popcount_search (bits counted from the most
+// significant end). pdep deposits a single 1 onto the k-th set bit.
+// Note that pdep is microcoded, and slow, on AMD before Zen 3.
+inline int select64_pdep(uint64_t x, int k) {
+    return __builtin_clzll(_pdep_u64(1ULL << (popcount(x) - k), x));
+}
+#endif
+
 inline int select64(uint64_t x, int k) {
+#ifdef __BMI2__
+    return select64_pdep(x, k);
+#else
     return select64_popcount_search(x, k);
+#endif
 }
 
 // x is the starting offset of the 512 bits;
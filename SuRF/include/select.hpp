@@ -28,6 +28,16 @@ public:
 
     ~BitvectorSelect() {}
 
+    // Prefetches the lookup table slot that select(rank) starts from
+    void prefetchSelect(const position_t rank) const {
+	__builtin_prefetch(select_lut_ + rank / sample_interval_);
+    }
+
+    // Prefetches the bits that select(rank) scans; reads the lookup table
+    void prefetchSelectBits(const position_t rank) const {
+	__builtin_prefetch(bits_ + select_lut_[rank / sample_interval_] / kWordSize);
+    }
+
     // Returns the postion of the rank-th 1 bit.
     // posistion is zero-based; rank is one-based.
     // E.g., for bitvector: 100101000, select(3) = 5
@@ -62,7 +72,7 @@ public:
 	    rank_left -= ones_count_in_word;
 	    ones_count_in_word = popcount(word);
 	}
-	return (word_id * kWordSize + select64_popcount_search(word, rank_left));
+	return (word_id * kWordSize + select64(word, rank_left));
     }
 
     position_t selectLutSize() const {
@@ -135,7 +145,7 @@ private:
 	    position_t num_ones_in_word = popcount(bits_[i]);
 	    while (sampling_ones <= (cumu_ones_upto_word + num_ones_in_word)) {
 		int diff = sampling_ones - cumu_ones_upto_word;
-		position_t result_pos = i * kWordSize + select64_popcount_search(bits_[i], diff);
+		position_t result_pos = i * kWordSize + select64(bits_[i], diff);
 		select_lut_vector.push_back(result_pos);
 		sampling_ones += sample_interval_;
 	    }
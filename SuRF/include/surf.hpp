@@ -1,13 +1,20 @@
 #ifndef SURF_H_
 #define SURF_H_
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "config.hpp"
 #include "louds_dense.hpp"
 #include "louds_sparse.hpp"
 #include "surf_builder.hpp"
+#include "surf_file.hpp"
 
 namespace surf {
 
@@ -36,6 +43,7 @@ public:
 
     private:
 	void passToSparse();
+	bool getCut(const level_t level, position_t& pos, bool& with_prefix_key) const;
 	bool incrementDenseIter();
 	bool incrementSparseIter();
 	bool decrementDenseIter();
@@ -67,29 +75,51 @@ public:
 	       suffix_type, hash_suffix_len, real_suffix_len);
     }
     
+    // With label_bits = kNibbleLabelBits, each trie level holds 4 bits
+    // and every key byte must be < 16 (one nibble per byte).
+    // num_threads > 1 builds the trie in parallel (see SuRFBuilder::build);
+    // the filter is identical to a single-threaded build
     SuRF(const std::vector<std::string>& keys,
 	 const bool include_dense, const uint32_t sparse_dense_ratio,
-	 const SuffixType suffix_type, const level_t hash_suffix_len, const level_t real_suffix_len) {
+	 const SuffixType suffix_type, const level_t hash_suffix_len, const level_t real_suffix_len,
+	 const level_t label_bits = kByteLabelBits, const unsigned num_threads = 1) {
 	create(keys, include_dense, sparse_dense_ratio,
-	       suffix_type, hash_suffix_len, real_suffix_len);
+	       suffix_type, hash_suffix_len, real_suffix_len, label_bits, num_threads);
     }
 
-    ~SuRF() {};
+    ~SuRF() {
+	if (mapped_data_ != nullptr)
+	    munmap(mapped_data_, mapped_size_);
+    };
 
     void create(const std::vector<std::string>& keys,
 		const bool include_dense, const uint32_t sparse_dense_ratio,
 		const SuffixType suffix_type,
-                const level_t hash_suffix_len, const level_t real_suffix_len);
+                const level_t hash_suffix_len, const level_t real_suffix_len,
+		const level_t label_bits = kByteLabelBits, const unsigned num_threads = 1);
     
     bool lookupKey(const std::string& key) const;
+    // Looks up every key in keys; results[i] is lookupKey(keys[i]).
+    // Up to kLookupBatchSize probes advance in turn, one trie level at
+    // a time, so that the cache misses of one probe overlap with the
+    // work on the others. Keys need not be sorted.
+    void lookupKeys(const std::vector<std::string>& keys, std::vector<bool>& results) const;
     // This function searches in a conservative way: if inclusive is true
     // and the stored key prefix matches key, iter stays at this key prefix.
     SuRF::Iter moveToKeyGreaterThan(const std::string& key, const bool inclusive) const;
     SuRF::Iter moveToKeyLessThan(const std::string& key, const bool inclusive) const;
     SuRF::Iter moveToFirst() const;
     SuRF::Iter moveToLast() const;
+    // Read-only: a filter can be probed from several threads at once
     bool lookupRange(const std::string& left_key, const bool left_inclusive, 
-		     const std::string& right_key, const bool right_inclusive);
+		     const std::string& right_key, const bool right_inclusive) const;
+    // Estimates the number of keys in [left_key, right_key] without
+    // walking them: each trie level is split at the positions of the two
+    // boundary iterators and the keys in between are counted by rank.
+    CountEstimate approxCount(const std::string& left_key, const std::string& right_key) const;
+    // Keys from left (inclusive) up to right (exclusive); an invalid
+    // right iterator stands for the end of the filter
+    CountEstimate approxCount(const SuRF::Iter& left, const SuRF::Iter& right) const;
 
     uint64_t serializedSize() const;
     uint64_t getMemoryUsage() const;
@@ -100,17 +130,24 @@ public:
     char* serialize() const {
 	uint64_t size = serializedSize();
 	char* data = new char[size];
+	memset(data, 0, size); // alignment padding
 	char* cur_data = data;
-	louds_dense_->serialize(cur_data);
-	louds_sparse_->serialize(cur_data);
+	serialize(cur_data);
 	assert(cur_data - data == (int64_t)size);
 	return data;
     }
 
+    // dst must be 8-byte aligned and hold serializedSize() bytes
+    void serialize(char*& dst) const {
+	louds_dense_->serialize(dst);
+	louds_sparse_->serialize(dst);
+    }
+
     static SuRF* deSerialize(char* src) {
 	SuRF* surf = new SuRF();
 	surf->louds_dense_ = LoudsDense::deSerialize(src);
 	surf->louds_sparse_ = LoudsSparse::deSerialize(src);
+	surf->avg_height_ = 0;
 	return surf;
     }
 
@@ -119,25 +156,52 @@ public:
 	louds_sparse_->destroy();
     }
 
+    // Writes the filter to path in the format of surf_file.hpp. The
+    // filter is serialized straight into a shared mapping of the file,
+    // without an intermediate heap buffer. Returns false on I/O errors.
+    bool writeFile(const std::string& path) const;
+    // Maps a file written by writeFile and answers queries in place;
+    // pages are read in on first access. verify_checksum reads the whole
+    // filter once. Returns nullptr if the file is missing or malformed.
+    // The mapping is released when the returned SuRF is deleted; do not
+    // call destroy() on it.
+    static SuRF* openFile(const std::string& path, const bool verify_checksum = false);
+
 private:
+    static const int kLookupBatchSize = 16;
+
+    inline void startLookup(LookupProbe& probe, const std::string& key) const;
+    inline void lookupStep(LookupProbe& probe) const;
+    // For approxCount: the cut at level below a cut at pos one level up
+    // (or, at level 0, the end of the root node)
+    position_t getCutBelow(const level_t level, const position_t pos) const;
+
     LoudsDense* louds_dense_;
     LoudsSparse* louds_sparse_;
     SuRFBuilder* builder_;
     double avg_height_;
-    SuRF::Iter iter_;
+    char* mapped_data_ = nullptr;
+    uint64_t mapped_size_ = 0;
 };
 
 void SuRF::create(const std::vector<std::string>& keys,
 		  const bool include_dense, const uint32_t sparse_dense_ratio,
 		  const SuffixType suffix_type,
-                  const level_t hash_suffix_len, const level_t real_suffix_len) {
+                  const level_t hash_suffix_len, const level_t real_suffix_len,
+		  const level_t label_bits, const unsigned num_threads) {
     builder_ = new SuRFBuilder(include_dense, sparse_dense_ratio,
-			       suffix_type, hash_suffix_len, real_suffix_len);
-    builder_->build(keys);
-    louds_dense_ = new LoudsDense(builder_);
-    louds_sparse_ = new LoudsSparse(builder_);
+			       suffix_type, hash_suffix_len, real_suffix_len, label_bits);
+    builder_->build(keys, num_threads);
+    if (num_threads > 1) {
+	// the two tries index disjoint builder vectors
+	std::thread dense_thread([this]() { louds_dense_ = new LoudsDense(builder_); });
+	louds_sparse_ = new LoudsSparse(builder_);
+	dense_thread.join();
+    } else {
+	louds_dense_ = new LoudsDense(builder_);
+	louds_sparse_ = new LoudsSparse(builder_);
+    }
     avg_height_ = builder_->getAvgTrieHeight();
-    iter_ = SuRF::Iter(this);
 
 #ifdef PRINT_TRIE_HEIGHT
     uint64_t dense_height = louds_dense_->getHeight();
@@ -150,8 +214,79 @@ void SuRF::create(const std::vector<std::string>& keys,
     delete builder_;
 }
 
+bool SuRF::writeFile(const std::string& path) const {
+    uint64_t payload_size = serializedSize();
+    uint64_t file_size = fileAlignedSize(sizeof(FileHeader) + payload_size);
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+	return false;
+    // reserve the blocks up front: stores into a sparse mapping raise
+    // SIGBUS instead of an error when the disk is full
+    if (posix_fallocate(fd, 0, file_size) != 0) {
+	close(fd);
+	return false;
+    }
+    void* data = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+	close(fd);
+	return false;
+    }
+
+    char* payload = reinterpret_cast<char*>(data) + sizeof(FileHeader);
+    char* cur_data = payload;
+    serialize(cur_data);
+    assert(cur_data - payload == (int64_t)payload_size);
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = kFileMagic;
+    header.version = kFileVersion;
+    header.header_size = sizeof(FileHeader);
+    header.payload_size = payload_size;
+    header.checksum = fileChecksum(payload, payload_size);
+    memcpy(data, &header, sizeof(header));
+    bool ok = (msync(data, file_size, MS_SYNC) == 0);
+    ok = (munmap(data, file_size) == 0) && ok;
+    ok = (close(fd) == 0) && ok;
+    return ok;
+}
+
+SuRF* SuRF::openFile(const std::string& path, const bool verify_checksum) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+	return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(FileHeader)) {
+	close(fd);
+	return nullptr;
+    }
+    uint64_t file_size = st.st_size;
+    void* data = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+	return nullptr;
+
+    FileHeader header;
+    memcpy(&header, data, sizeof(header));
+    char* payload = reinterpret_cast<char*>(data) + header.header_size;
+    if (header.magic != kFileMagic || header.version != kFileVersion
+	|| header.header_size != sizeof(FileHeader)
+	|| fileAlignedSize(header.header_size + header.payload_size) != file_size
+	|| (verify_checksum && fileChecksum(payload, header.payload_size) != header.checksum)) {
+	munmap(data, file_size);
+	return nullptr;
+    }
+
+    SuRF* surf = deSerialize(payload);
+    surf->mapped_data_ = reinterpret_cast<char*>(data);
+    surf->mapped_size_ = file_size;
+    return surf;
+}
+
 bool SuRF::lookupKey(const std::string& key) const {
     position_t connect_node_num = 0;
+    if (louds_dense_->getHeight() == 0)
+	return louds_sparse_->lookupKey(key, 0);
     if (!louds_dense_->lookupKey(key, connect_node_num))
 	return false;
     else if (connect_node_num != 0)
@@ -159,6 +294,60 @@ bool SuRF::lookupKey(const std::string& key) const {
     return true;
 }
 
+void SuRF::startLookup(LookupProbe& probe, const std::string& key) const {
+    probe.key = &key;
+    probe.level = 0;
+    probe.node_num = 0;
+    probe.result = false;
+    if (louds_dense_->getHeight() == 0) {
+	probe.stage = LookupProbe::kSparseNode;
+	louds_sparse_->prefetchLookup(probe);
+    } else {
+	probe.stage = LookupProbe::kDense;
+	louds_dense_->prefetchLookup(probe);
+    }
+}
+
+void SuRF::lookupStep(LookupProbe& probe) const {
+    if (probe.stage == LookupProbe::kDense) {
+	louds_dense_->lookupStep(probe);
+	if (probe.stage == LookupProbe::kSparseNode)
+	    louds_sparse_->prefetchLookup(probe);
+    } else {
+	louds_sparse_->lookupStep(probe);
+    }
+}
+
+void SuRF::lookupKeys(const std::vector<std::string>& keys, std::vector<bool>& results) const {
+    results.assign(keys.size(), false);
+    LookupProbe probes[kLookupBatchSize];
+    size_t key_ids[kLookupBatchSize];
+    size_t next_key = 0;
+    int num_probes = 0;
+    while (num_probes < kLookupBatchSize && next_key < keys.size()) {
+	key_ids[num_probes] = next_key;
+	startLookup(probes[num_probes++], keys[next_key++]);
+    }
+    while (num_probes > 0) {
+	for (int i = 0; i < num_probes; ) {
+	    lookupStep(probes[i]);
+	    if (probes[i].stage != LookupProbe::kDone) {
+		i++;
+		continue;
+	    }
+	    results[key_ids[i]] = probes[i].result;
+	    if (next_key < keys.size()) {
+		key_ids[i] = next_key;
+		startLookup(probes[i++], keys[next_key++]);
+	    } else {
+		num_probes--;
+		probes[i] = probes[num_probes];
+		key_ids[i] = key_ids[num_probes];
+	    }
+	}
+    }
+}
+
 SuRF::Iter SuRF::moveToKeyGreaterThan(const std::string& key, const bool inclusive) const {
     SuRF::Iter iter(this);
     iter.could_be_fp_ = louds_dense_->moveToKeyGreaterThan(key, inclusive, iter.dense_iter_);
@@ -231,24 +420,24 @@ SuRF::Iter SuRF::moveToLast() const {
 }
 
 bool SuRF::lookupRange(const std::string& left_key, const bool left_inclusive, 
-		       const std::string& right_key, const bool right_inclusive) {
-    iter_.clear();
-    louds_dense_->moveToKeyGreaterThan(left_key, left_inclusive, iter_.dense_iter_);
-    if (!iter_.dense_iter_.isValid()) return false;
-    if (!iter_.dense_iter_.isComplete()) {
-	if (!iter_.dense_iter_.isSearchComplete()) {
-	    iter_.passToSparse();
-	    louds_sparse_->moveToKeyGreaterThan(left_key, left_inclusive, iter_.sparse_iter_);
-	    if (!iter_.sparse_iter_.isValid()) {
-		iter_.incrementDenseIter();
+		       const std::string& right_key, const bool right_inclusive) const {
+    SuRF::Iter iter(this);
+    louds_dense_->moveToKeyGreaterThan(left_key, left_inclusive, iter.dense_iter_);
+    if (!iter.dense_iter_.isValid()) return false;
+    if (!iter.dense_iter_.isComplete()) {
+	if (!iter.dense_iter_.isSearchComplete()) {
+	    iter.passToSparse();
+	    louds_sparse_->moveToKeyGreaterThan(left_key, left_inclusive, iter.sparse_iter_);
+	    if (!iter.sparse_iter_.isValid()) {
+		iter.incrementDenseIter();
 	    }
-	} else if (!iter_.dense_iter_.isMoveLeftComplete()) {
-	    iter_.passToSparse();
-	    iter_.sparse_iter_.moveToLeftMostKey();
+	} else if (!iter.dense_iter_.isMoveLeftComplete()) {
+	    iter.passToSparse();
+	    iter.sparse_iter_.moveToLeftMostKey();
 	}
     }
-    if (!iter_.isValid()) return false;
-    int compare = iter_.compare(right_key);
+    if (!iter.isValid()) return false;
+    int compare = iter.compare(right_key);
     if (compare == kCouldBePositive)
 	return true;
     if (right_inclusive)
@@ -257,6 +446,66 @@ bool SuRF::lookupRange(const std::string& left_key, const bool left_inclusive,
 	return (compare < 0);
 }
 
+position_t SuRF::getCutBelow(const level_t level, const position_t pos) const {
+    level_t dense_height = louds_dense_->getHeight();
+    position_t num_children = 0;
+    if (level > 0)
+	num_children = (level - 1 < dense_height) ? louds_dense_->countChildrenBefore(pos)
+	    : louds_sparse_->countChildrenBefore(pos);
+    // node 0 is the root; node i is the child of the i-th branch
+    if (level < dense_height)
+	return louds_dense_->getNodeStartPos(num_children + 1);
+    return louds_sparse_->getNodeStartPos(num_children + 1);
+}
+
+CountEstimate SuRF::approxCount(const std::string& left_key, const std::string& right_key) const {
+    return approxCount(moveToKeyGreaterThan(left_key, true), moveToKeyGreaterThan(right_key, false));
+}
+
+CountEstimate SuRF::approxCount(const SuRF::Iter& left, const SuRF::Iter& right) const {
+    CountEstimate estimate = {0, 0, 0};
+    if (!left.isValid())
+	return estimate;
+    level_t dense_height = louds_dense_->getHeight();
+    position_t left_pos = 0, right_pos = 0;
+    bool left_with_prefix_key = true, right_with_prefix_key = true;
+    bool left_on_path = true, right_on_path = right.isValid();
+    uint64_t count = 0;
+    for (level_t level = 0; level < getHeight(); level++) {
+	if (left_on_path)
+	    left_on_path = left.getCut(level, left_pos, left_with_prefix_key);
+	if (!left_on_path) {
+	    left_pos = getCutBelow(level, left_pos);
+	    left_with_prefix_key = true;
+	}
+	if (right_on_path)
+	    right_on_path = right.getCut(level, right_pos, right_with_prefix_key);
+	if (!right_on_path) {
+	    right_pos = getCutBelow(level, right_pos);
+	    right_with_prefix_key = true;
+	}
+
+	bool is_dense = (level < dense_height);
+	position_t left_keys, right_keys;
+	if (is_dense) {
+	    left_keys = louds_dense_->countKeysBefore(left_pos, left_with_prefix_key);
+	    right_keys = louds_dense_->countKeysBefore(right_pos, right_with_prefix_key);
+	} else {
+	    left_keys = louds_sparse_->countKeysBefore(left_pos);
+	    right_keys = louds_sparse_->countKeysBefore(right_pos);
+	}
+	if (right_keys > left_keys)
+	    count += right_keys - left_keys;
+    }
+
+    // the key at left may be less than the left bound, and the key at
+    // right may still be within the right bound
+    estimate.count = count;
+    estimate.lower = (left.getFpFlag() && count > 0) ? count - 1 : count;
+    estimate.upper = (right.isValid() && right.getFpFlag()) ? count + 1 : count;
+    return estimate;
+}
+
 uint64_t SuRF::serializedSize() const {
     return (louds_dense_->serializedSize()
 	    + louds_sparse_->serializedSize());
@@ -331,6 +580,15 @@ void SuRF::Iter::passToSparse() {
     sparse_iter_.setStartNodeNum(dense_iter_.getSendOutNodeNum());
 }
 
+bool SuRF::Iter::getCut(const level_t level, position_t& pos, bool& with_prefix_key) const {
+    if (dense_iter_.getCut(level, pos, with_prefix_key))
+	return true;
+    if (dense_iter_.isComplete())
+	return false;
+    with_prefix_key = true;
+    return sparse_iter_.getCut(level, pos);
+}
+
 bool SuRF::Iter::incrementDenseIter() {
     if (!dense_iter_.isValid()) 
 	return false;
@@ -4,6 +4,7 @@
 #include <assert.h>
 
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "config.hpp"
@@ -14,10 +15,14 @@ namespace surf {
 
 class SuRFBuilder {
 public: 
-    SuRFBuilder() : sparse_start_level_(0), suffix_type_(kNone) {};
+    SuRFBuilder() : label_bits_(kByteLabelBits), fanout_(kFanout),
+		    sparse_start_level_(0), suffix_type_(kNone) {};
+    // With label_bits = kNibbleLabelBits, every key byte must be < 16
     explicit SuRFBuilder(bool include_dense, uint32_t sparse_dense_ratio,
-			 SuffixType suffix_type, level_t hash_suffix_len, level_t real_suffix_len)
+			 SuffixType suffix_type, level_t hash_suffix_len, level_t real_suffix_len,
+			 level_t label_bits = kByteLabelBits)
 	: include_dense_(include_dense), sparse_dense_ratio_(sparse_dense_ratio),
+	  label_bits_(label_bits), fanout_((position_t)1 << label_bits),
 	  sparse_start_level_(0), suffix_type_(suffix_type),
           hash_suffix_len_(hash_suffix_len), real_suffix_len_(real_suffix_len) {};
 
@@ -27,7 +32,13 @@ public:
     // through a single scan of the sorted key list.
     // After build, the member vectors are used in SuRF constructor.
     // REQUIRED: provided key list must be sorted.
-    void build(const std::vector<std::string>& keys);
+    // With num_threads > 1, the key list is split into partitions of
+    // about equal key counts, each built by its own thread. A partition
+    // starts from the path its first key shares with the last key of
+    // the previous one, and the per-level vectors are appended in key
+    // order with that path merged; the result is identical to the
+    // single-threaded build.
+    void build(const std::vector<std::string>& keys, const unsigned num_threads = 1);
 
     static bool readBit(const std::vector<word_t>& bits, const position_t pos) {
 	assert(pos < (bits.size() * kWordSize));
@@ -78,6 +89,12 @@ public:
     level_t getSparseStartLevel() const {
 	return sparse_start_level_;
     }
+    level_t getLabelBits() const {
+	return label_bits_;
+    }
+    position_t getFanout() const {
+	return fanout_;
+    }
     double getAvgTrieHeight() const {
 	return avg_trie_height_;
     }
@@ -100,8 +117,27 @@ private:
     }
 
     // Fill in the LOUDS-Sparse vectors through a single scan
-    // of the sorted key list.
-    void buildSparse(const std::vector<std::string>& keys);
+    // of the sorted keys in [begin, end). Returns the sum of the
+    // key heights in the trie.
+    int64_t buildSparse(const std::vector<std::string>& keys,
+			const position_t begin, const position_t end);
+    int64_t buildSparseParallel(const std::vector<std::string>& keys, const unsigned num_threads);
+    // Fills an empty builder with the path that key shares with
+    // prev_key, the last key of the previous partition: one item per
+    // common byte and a terminator below them, so that key is inserted
+    // exactly as in a single-threaded build. Returns the number of
+    // levels filled.
+    level_t seedBoundaryPath(const std::string& prev_key, const std::string& key);
+    // Appends the sparse vectors of a builder whose keys all sort after
+    // the keys in this one. The first item of each of its
+    // num_seeded_levels levels stands for the last item of that level
+    // here and is skipped.
+    void appendSparse(const SuRFBuilder& part, const level_t num_seeded_levels);
+    // Appends bits [src_begin, src_end) of src to dst, which holds
+    // dst_num_bits bits.
+    static void appendBits(std::vector<word_t>& dst, const position_t dst_num_bits,
+			   const std::vector<word_t>& src,
+			   const position_t src_begin, const position_t src_end);
 
     // Walks down the current partially-filled trie by comparing key to
     // its previous key in the list until their prefixes do not match.
@@ -153,6 +189,8 @@ private:
     // trie level >= sparse_start_level_: LOUDS-Sparse
     bool include_dense_;
     uint32_t sparse_dense_ratio_;
+    level_t label_bits_;
+    position_t fanout_;
     level_t sparse_start_level_;
 
     double avg_trie_height_;
@@ -178,30 +216,162 @@ private:
     std::vector<bool> is_last_item_terminator_;
 };
 
-void SuRFBuilder::build(const std::vector<std::string>& keys) {
+void SuRFBuilder::build(const std::vector<std::string>& keys, const unsigned num_threads) {
     assert(keys.size() > 0);
-    buildSparse(keys);
+    int64_t total_height;
+    if (num_threads > 1)
+	total_height = buildSparseParallel(keys, num_threads);
+    else
+	total_height = buildSparse(keys, 0, keys.size());
+    avg_trie_height_ = (total_height + 0.0) / keys.size();
     if (include_dense_) {
 	determineCutoffLevel();
 	buildDense();
     }
 }
 
-void SuRFBuilder::buildSparse(const std::vector<std::string>& keys) {
+int64_t SuRFBuilder::buildSparse(const std::vector<std::string>& keys,
+				 const position_t begin, const position_t end) {
     int64_t total_height = 0;
-    for (position_t i = 0; i < keys.size(); i++) {
+    for (position_t i = begin; i < end; i++) {
 	level_t level = skipCommonPrefix(keys[i]);	
 	position_t curpos = i;
-	while ((i + 1 < keys.size()) && isSameKey(keys[curpos], keys[i+1]))
+	while ((i + 1 < end) && isSameKey(keys[curpos], keys[i+1]))
 	    i++;
-	if (i < keys.size() - 1)
+	// the last key of a partition is stored as deep as its successor
+	// in the next partition requires
+	if (i + 1 < keys.size())
 	    level = insertKeyBytesToTrieUntilUnique(keys[curpos], keys[i+1], level);
 	else // for last key, there is no successor key in the list
 	    level = insertKeyBytesToTrieUntilUnique(keys[curpos], std::string(), level);
 	insertSuffix(keys[curpos], level);
 	total_height += level;
     }
-    avg_trie_height_ = (total_height + 0.0) / keys.size();
+    return total_height;
+}
+
+int64_t SuRFBuilder::buildSparseParallel(const std::vector<std::string>& keys,
+					 const unsigned num_threads) {
+    std::vector<position_t> bounds;
+    bounds.push_back(0);
+    for (unsigned t = 1; t < num_threads; t++) {
+	position_t bound = (position_t)((uint64_t)keys.size() * t / num_threads);
+	if (bound <= bounds.back())
+	    bound = bounds.back() + 1;
+	// copies of a key stay in one partition
+	while (bound < keys.size() && isSameKey(keys[bound], keys[bound - 1]))
+	    bound++;
+	if (bound >= keys.size())
+	    break;
+	bounds.push_back(bound);
+    }
+    bounds.push_back(keys.size());
+    if (bounds.size() == 2)
+	return buildSparse(keys, 0, keys.size());
+
+    size_t num_parts = bounds.size() - 1;
+    std::vector<SuRFBuilder> parts(num_parts, SuRFBuilder(include_dense_, sparse_dense_ratio_,
+							 suffix_type_, hash_suffix_len_,
+							 real_suffix_len_, label_bits_));
+    std::vector<int64_t> heights(num_parts, 0);
+    std::vector<level_t> num_seeded_levels(num_parts, 0);
+    std::vector<std::thread> threads;
+    for (size_t p = 1; p < num_parts; p++)
+	threads.push_back(std::thread([&, p]() {
+		    num_seeded_levels[p] = parts[p].seedBoundaryPath(keys[bounds[p] - 1], keys[bounds[p]]);
+		    heights[p] = parts[p].buildSparse(keys, bounds[p], bounds[p + 1]);
+		}));
+    heights[0] = buildSparse(keys, bounds[0], bounds[1]);
+    for (size_t t = 0; t < threads.size(); t++)
+	threads[t].join();
+
+    int64_t total_height = heights[0];
+    for (size_t p = 1; p < num_parts; p++) {
+	appendSparse(parts[p], num_seeded_levels[p]);
+	total_height += heights[p];
+    }
+
+    // match the word counts of a single-threaded build
+    for (level_t level = 0; level < getTreeHeight(); level++) {
+	position_t num_words = getNumItems(level) / kWordSize + 1;
+	child_indicator_bits_[level].resize(num_words, 0);
+	louds_bits_[level].resize(num_words, 0);
+	position_t num_suffix_bits = suffix_counts_[level] * getSuffixLen();
+	suffixes_[level].resize((num_suffix_bits + kWordSize - 1) / kWordSize, 0);
+    }
+    return total_height;
+}
+
+level_t SuRFBuilder::seedBoundaryPath(const std::string& prev_key, const std::string& key) {
+    assert(getTreeHeight() == 0);
+    level_t num_common = 0;
+    while (num_common < prev_key.length() && num_common < key.length()
+	   && prev_key[num_common] == key[num_common])
+	num_common++;
+    // the seeded items only make key's own items attach where they do in
+    // a single-threaded build; their louds bits and node counts are
+    // never used
+    for (level_t level = 0; level <= num_common; level++) {
+	addLevel();
+	if (level < num_common) {
+	    labels_[level].push_back(key[level]);
+	    setBit(child_indicator_bits_[level], 0);
+	} else {
+	    labels_[level].push_back(kTerminator);
+	    is_last_item_terminator_[level] = true;
+	}
+	moveToNextItemSlot(level);
+    }
+    return num_common + 1;
+}
+
+void SuRFBuilder::appendSparse(const SuRFBuilder& part, const level_t num_seeded_levels) {
+    assert(num_seeded_levels <= getTreeHeight());
+    level_t suffix_len = getSuffixLen();
+    for (level_t level = 0; level < part.getTreeHeight(); level++) {
+	if (level >= getTreeHeight())
+	    addLevel();
+	position_t num_items = getNumItems(level);
+	position_t part_begin = (level < num_seeded_levels) ? 1 : 0;
+	position_t part_num_items = part.labels_[level].size();
+	labels_[level].insert(labels_[level].end(),
+			      part.labels_[level].begin() + part_begin, part.labels_[level].end());
+	appendBits(child_indicator_bits_[level], num_items,
+		   part.child_indicator_bits_[level], part_begin, part_num_items);
+	appendBits(louds_bits_[level], num_items,
+		   part.louds_bits_[level], part_begin, part_num_items);
+	appendBits(suffixes_[level], suffix_counts_[level] * suffix_len,
+		   part.suffixes_[level], 0, part.suffix_counts_[level] * suffix_len);
+	suffix_counts_[level] += part.suffix_counts_[level];
+	node_counts_[level] += part.node_counts_[level];
+	if (part_num_items > part_begin)
+	    is_last_item_terminator_[level] = part.is_last_item_terminator_[level];
+    }
+}
+
+void SuRFBuilder::appendBits(std::vector<word_t>& dst, const position_t dst_num_bits,
+			     const std::vector<word_t>& src,
+			     const position_t src_begin, const position_t src_end) {
+    dst.resize((dst_num_bits + kWordSize - 1) / kWordSize);
+    position_t num_bits = src_end - src_begin;
+    position_t offset = dst_num_bits % kWordSize;
+    position_t src_word_id = src_begin / kWordSize;
+    position_t src_offset = src_begin % kWordSize;
+    for (position_t i = 0; i * kWordSize < num_bits; i++) {
+	word_t word = src[src_word_id + i] << src_offset;
+	if (src_offset != 0 && src_word_id + i + 1 < src.size())
+	    word |= src[src_word_id + i + 1] >> (kWordSize - src_offset);
+	position_t len = num_bits - i * kWordSize;
+	if (len < kWordSize)
+	    word &= ~(kOneMask >> len);
+	if (offset == 0) {
+	    dst.push_back(word);
+	} else {
+	    dst.back() |= (word >> offset);
+	    if (len > kWordSize - offset)
+		dst.push_back(word << (kWordSize - offset));
+	}
+    }
 }
 
 level_t SuRFBuilder::skipCommonPrefix(const std::string& key) {
@@ -340,7 +510,7 @@ inline uint64_t SuRFBuilder::computeDenseMem(const level_t downto_level) const {
     assert(downto_level <= getTreeHeight());
     uint64_t mem = 0;
     for (level_t level = 0; level < downto_level; level++) {
-	mem += (2 * kFanout * node_counts_[level]);
+	mem += (2 * fanout_ * node_counts_[level]);
 	if (level > 0)
 	    mem += (node_counts_[level - 1] / 8 + 1);
 	mem += (suffix_counts_[level] * getSuffixLen() / 8);
@@ -352,7 +522,7 @@ inline uint64_t SuRFBuilder::computeSparseMem(const level_t start_level) const {
     uint64_t mem = 0;
     for (level_t level = start_level; level < getTreeHeight(); level++) {
 	position_t num_items = labels_[level].size();
-	mem += (num_items + 2 * num_items / 8 + 1);
+	mem += (num_items * label_bits_ / 8 + 2 * num_items / 8 + 1);
 	mem += (suffix_counts_[level] * getSuffixLen() / 8);
     }
     return mem;
@@ -386,22 +556,20 @@ void SuRFBuilder::initDenseVectors(const level_t level) {
     bitmap_child_indicator_bits_.push_back(std::vector<word_t>());
     prefixkey_indicator_bits_.push_back(std::vector<word_t>());
 
-    for (position_t nc = 0; nc < node_counts_[level]; nc++) {
-	for (int i = 0; i < (int)kFanout; i += kWordSize) {
-	    bitmap_labels_[level].push_back(0);
-	    bitmap_child_indicator_bits_[level].push_back(0);
-	}
-	if (nc % kWordSize == 0)
-	    prefixkey_indicator_bits_[level].push_back(0);
-    }
+    position_t num_words = (node_counts_[level] * fanout_ + kWordSize - 1) / kWordSize;
+    bitmap_labels_[level].resize(num_words, 0);
+    bitmap_child_indicator_bits_[level].resize(num_words, 0);
+    for (position_t nc = 0; nc < node_counts_[level]; nc += kWordSize)
+	prefixkey_indicator_bits_[level].push_back(0);
 }
 
 void SuRFBuilder::setLabelAndChildIndicatorBitmap(const level_t level, 
 						  const position_t node_num, const position_t pos) {
     label_t label = labels_[level][pos];
-    setBit(bitmap_labels_[level], node_num * kFanout + label);
+    assert(label < fanout_);
+    setBit(bitmap_labels_[level], node_num * fanout_ + label);
     if (readBit(child_indicator_bits_[level], pos))
-	setBit(bitmap_child_indicator_bits_[level], node_num * kFanout + label);
+	setBit(bitmap_child_indicator_bits_[level], node_num * fanout_ + label);
 }
 
 void SuRFBuilder::addLevel() {
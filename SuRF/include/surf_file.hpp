@@ -0,0 +1,46 @@
+#ifndef SURFFILE_H_
+#define SURFFILE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include "config.hpp"
+
+namespace surf {
+
+// On-disk SuRF layout: a 64-byte header followed by the serialized
+// filter (SuRF::serialize). The file is padded to a multiple of 64 bytes
+// so the filter starts, and ends, on a cache line boundary.
+static const uint64_t kFileMagic = 0x31656c6946465253; // "SRFFile1"
+static const uint32_t kFileVersion = 1;
+static const uint64_t kFileAlignment = 64;
+
+struct FileHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t payload_size; // SuRF::serializedSize()
+    uint64_t checksum;     // fileChecksum() of the payload
+    uint8_t reserved[32];
+};
+
+static_assert(sizeof(FileHeader) == kFileAlignment, "SuRF file header must fill one cache line");
+
+inline uint64_t fileAlignedSize(const uint64_t size) {
+    return (size + kFileAlignment - 1) & ~(kFileAlignment - 1);
+}
+
+// 64-bit FNV-1a over words; size must be a multiple of 8
+inline uint64_t fileChecksum(const char* data, const uint64_t size) {
+    uint64_t h = 0xcbf29ce484222325;
+    for (uint64_t i = 0; i < size; i += sizeof(word_t)) {
+	word_t word;
+	memcpy(&word, data + i, sizeof(word));
+	h = (h ^ word) * 0x100000001b3;
+    }
+    return h;
+}
+
+} // namespace surf
+
+#endif // SURFFILE_H_
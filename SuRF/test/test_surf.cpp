@@ -2,8 +2,10 @@
 
 #include <assert.h>
 
+#include <algorithm>
 #include <fstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "config.hpp"
@@ -31,8 +33,10 @@ class SuRFUnitTest : public ::testing::Test {
   virtual void TearDown(){};
 
   void newSuRFWords(SuffixType suffix_type, level_t suffix_len);
+  void newSuRFWordsRaw(SuffixType suffix_type);
 
   std::string encodeString(const std::string &key);
+  std::string encodeNibbles(const std::string &key);
 
   hope::Encoder *encoder_;
   SuRF *surf_;
@@ -53,12 +57,27 @@ void SuRFUnitTest::newSuRFWords(SuffixType suffix_type, level_t suffix_len) {
     surf_ = new SuRF(words_compressed_);
 }
 
+void SuRFUnitTest::newSuRFWordsRaw(SuffixType suffix_type) {
+  if (suffix_type == kNone)
+    surf_ = new SuRF(words);
+  else
+    surf_ = new SuRF(words, kIncludeDense, kSparseDenseRatio, kReal, 0, 8);
+}
+
 std::string SuRFUnitTest::encodeString(const std::string &key) {
   int enc_len = encoder_->encode(key, buffer_);
   int enc_len_round = (enc_len + 7) >> 3;
   return std::string((const char *)buffer_, enc_len_round);
 }
 
+// One 4-bit label per byte
+std::string SuRFUnitTest::encodeNibbles(const std::string &key) {
+  int enc_len = encoder_->encode(key, buffer_);
+  std::string nibbles;
+  for (int i = 0; i < (enc_len + 3) >> 2; i++) nibbles.push_back((buffer_[i >> 1] >> ((i & 1) ? 0 : 4)) & 0xF);
+  return nibbles;
+}
+
 TEST_F(SuRFUnitTest, lookupWordTest) {
   encoder_ = hope::EncoderFactory::createEncoder(kEncoderType);
   encoder_->build(words, kDictSizeLimit);
@@ -114,6 +133,181 @@ TEST_F(SuRFUnitTest, lookupRangeWordTest) {
   }
 }
 
+TEST_F(SuRFUnitTest, nibbleLabelWordTest) {
+  words_compressed_.clear();
+  encoder_ = hope::EncoderFactory::createEncoder(kEncoderType);
+  encoder_->build(words, kDictSizeLimit);
+  std::vector<std::string> words_nibbles;
+  for (int i = 0; i < (int)words.size(); i++) {
+    words_compressed_.push_back(encodeString(words[i]));
+    words_nibbles.push_back(encodeNibbles(words[i]));
+  }
+  SuRF *byte_surf = new SuRF(words_compressed_, kIncludeDense, kSparseDenseRatio, kHash, 8, 0);
+  surf_ = new SuRF(words_nibbles, kIncludeDense, kSparseDenseRatio, kHash, 8, 0, kNibbleLabelBits);
+  EXPECT_LT(surf_->getMemoryUsage(), byte_surf->getMemoryUsage());
+
+  char *data = surf_->serialize();
+  SuRF *surf_copy = SuRF::deSerialize(data);
+  for (int i = 0; i < (int)words.size(); i++) {
+    ASSERT_TRUE(surf_->lookupKey(words_nibbles[i]));
+    ASSERT_TRUE(surf_copy->lookupKey(words_nibbles[i]));
+  }
+  for (int i = 0; i < (int)words.size() - 1; i++) {
+    ASSERT_TRUE(surf_->lookupRange(words_nibbles[i], true, words_nibbles[i + 1], false));
+    SuRF::Iter iter = surf_copy->moveToKeyGreaterThan(words_nibbles[i], true);
+    ASSERT_TRUE(iter.isValid());
+    std::string iter_key = iter.getKey();
+    ASSERT_EQ(0, words_nibbles[i].compare(0, iter_key.length(), iter_key));
+    iter++;
+    ASSERT_TRUE(iter.isValid());
+    iter_key = iter.getKey();
+    ASSERT_EQ(0, words_nibbles[i + 1].compare(0, iter_key.length(), iter_key));
+  }
+
+  delete surf_copy;
+  delete[] data;
+  byte_surf->destroy();
+  delete byte_surf;
+  surf_->destroy();
+  delete surf_;
+  delete encoder_;
+}
+
+TEST_F(SuRFUnitTest, parallelBuildTest) {
+  // with a common prefix (as in URLs), every partition bound cuts
+  // through a shared path instead of the root
+  std::vector<std::vector<std::string> > key_lists(2, words);
+  for (int i = 0; i < (int)words.size(); i++)
+    key_lists[1][i] = "http://www." + words[i];
+  for (int k = 0; k < (int)key_lists.size(); k++) {
+    const std::vector<std::string> &keys = key_lists[k];
+    SuRF *serial_surf = new SuRF(keys, kIncludeDense, kSparseDenseRatio, kReal, 0, 8);
+    char *serial_data = serial_surf->serialize();
+    for (unsigned num_threads = 2; num_threads <= 16; num_threads *= 2) {
+      SuRF *parallel_surf = new SuRF(keys, kIncludeDense, kSparseDenseRatio, kReal, 0, 8,
+                                     kByteLabelBits, num_threads);
+      ASSERT_EQ(serial_surf->serializedSize(), parallel_surf->serializedSize());
+      char *parallel_data = parallel_surf->serialize();
+      EXPECT_EQ(0, memcmp(serial_data, parallel_data, serial_surf->serializedSize()));
+      delete[] parallel_data;
+      parallel_surf->destroy();
+      delete parallel_surf;
+    }
+    delete[] serial_data;
+    serial_surf->destroy();
+    delete serial_surf;
+  }
+}
+
+TEST_F(SuRFUnitTest, lookupKeysTest) {
+  std::vector<std::string> probe_keys;
+  for (int i = 0; i < (int)words.size(); i++) {
+    probe_keys.push_back(words[i]);
+    probe_keys.push_back(words[i] + "\x01");
+    probe_keys.push_back(words[i].substr(0, words[i].length() / 2));
+  }
+  std::reverse(probe_keys.begin(), probe_keys.end());
+  for (int t = 0; t < kNumSuffixType; t++) {
+    newSuRFWordsRaw(kSuffixTypeList[t]);
+    std::vector<bool> results;
+    surf_->lookupKeys(probe_keys, results);
+    ASSERT_EQ(probe_keys.size(), results.size());
+    for (int i = 0; i < (int)probe_keys.size(); i++) {
+      ASSERT_EQ(surf_->lookupKey(probe_keys[i]), results[i]);
+    }
+    surf_->destroy();
+    delete surf_;
+  }
+}
+
+TEST_F(SuRFUnitTest, select64Test) {
+  uint64_t word = 0x9e3779b97f4a7c15ULL;
+  for (int i = 0; i < 1000; i++) {
+    word = word * 6364136223846793005ULL + 1442695040888963407ULL;
+    for (int k = 1; k <= popcount(word); k++) ASSERT_EQ(select64_popcount_search(word, k), select64(word, k));
+  }
+  EXPECT_EQ(0, select64(1ULL << 63, 1));
+  EXPECT_EQ(63, select64(~0ULL, 64));
+}
+
+TEST_F(SuRFUnitTest, approxCountTest) {
+  for (int t = 0; t < kNumSuffixType; t++) {
+    newSuRFWordsRaw(kSuffixTypeList[t]);
+    for (int i = 0; i < (int)words.size(); i += 37) {
+      int j = std::min(i + (i % 5000), (int)words.size() - 1);
+      uint64_t num_keys = j - i + 1;
+      CountEstimate estimate = surf_->approxCount(words[i], words[j]);
+      ASSERT_LE(estimate.lower, num_keys);
+      ASSERT_GE(estimate.upper, num_keys);
+      ASSERT_LE(estimate.lower, estimate.count);
+      ASSERT_GE(estimate.upper, estimate.count);
+      // a left bound between two keys
+      estimate = surf_->approxCount(words[i] + "\x01", words[j]);
+      ASSERT_LE(estimate.lower, num_keys - 1);
+      ASSERT_GE(estimate.upper, num_keys - 1);
+    }
+    CountEstimate estimate = surf_->approxCount(surf_->moveToFirst(), SuRF::Iter());
+    EXPECT_EQ(words.size(), estimate.count);
+    estimate = surf_->approxCount(words[words.size() - 1] + "\x01", std::string("zzzzzzzz"));
+    EXPECT_EQ(0u, estimate.lower);
+    surf_->destroy();
+    delete surf_;
+  }
+}
+
+TEST_F(SuRFUnitTest, concurrentLookupRangeTest) {
+  static const int kNumThreads = 4;
+  newSuRFWordsRaw(kReal);
+  const SuRF *filter = surf_;
+  std::vector<int> num_misses(kNumThreads, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; t++) {
+    threads.push_back(std::thread([&, t]() {
+      for (int i = t; i < (int)words.size() - 1; i += kNumThreads) {
+        if (!filter->lookupRange(words[i], true, words[i + 1], false)) num_misses[t]++;
+        if (!filter->moveToKeyGreaterThan(words[i], true).isValid()) num_misses[t]++;
+      }
+    }));
+  }
+  for (int t = 0; t < kNumThreads; t++) {
+    threads[t].join();
+    EXPECT_EQ(0, num_misses[t]);
+  }
+  surf_->destroy();
+  delete surf_;
+}
+
+TEST_F(SuRFUnitTest, fileTest) {
+  static const char kSuRFFilePath[] = "surf_test_file.bin";
+  for (int t = 0; t < kNumSuffixType; t++) {
+    newSuRFWordsRaw(kSuffixTypeList[t]);
+    ASSERT_TRUE(surf_->writeFile(kSuRFFilePath));
+    SuRF *surf_file = SuRF::openFile(kSuRFFilePath, true);
+    ASSERT_TRUE(surf_file != nullptr);
+    EXPECT_EQ(surf_->serializedSize(), surf_file->serializedSize());
+    for (int i = 0; i < (int)words.size(); i++) {
+      ASSERT_TRUE(surf_file->lookupKey(words[i]));
+      std::string absent_key = words[i] + "\x01";
+      ASSERT_EQ(surf_->lookupKey(absent_key), surf_file->lookupKey(absent_key));
+    }
+    for (int i = 0; i < (int)words.size() - 1; i += 5) {
+      ASSERT_TRUE(surf_file->lookupRange(words[i], true, words[i + 1], false));
+    }
+    delete surf_file;
+    surf_->destroy();
+    delete surf_;
+  }
+
+  // a corrupted filter fails the checksum
+  std::fstream file(kSuRFFilePath, std::ios::in | std::ios::out | std::ios::binary);
+  file.seekp(sizeof(FileHeader) + 100);
+  file.put('\x5a');
+  file.close();
+  EXPECT_TRUE(SuRF::openFile(kSuRFFilePath, true) == nullptr);
+  EXPECT_TRUE(SuRF::openFile(std::string(kSuRFFilePath) + ".missing") == nullptr);
+  remove(kSuRFFilePath);
+}
+
 void loadWordList() {
   std::ifstream infile(kFilePath);
   std::string key;
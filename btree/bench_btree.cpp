@@ -8,6 +8,7 @@
 #include "btree_map.hpp"
 #include "encoder_factory.hpp"
 #include "parameters.h"
+#include "string_btree.hpp"
 
 static const uint64_t kNumEmailRecords = 25000000;
 static const uint64_t kNumWikiRecords = 14000;
@@ -33,6 +34,9 @@ static int kRunALM = 1;
 static int kRunEmail = 0;
 static int kRunWiki = 0;
 static bool kRunUrl = 0;
+// Expt IDs 2 and 3 rerun 0 and 1 on tlx::string_btree_map, whose inner
+// nodes hold suffix-truncated separators
+static bool kRunSeparatorTree = false;
 static const double kSamplePercent = 1;
 static std::string endStr = std::string(255, char(255));
 
@@ -170,10 +174,39 @@ void loadWorkload(int wkld_id, std::vector<std::string> &insert_keys, std::vecto
   std::cout << "scan_key_lens size = " << scan_key_lens.size() << std::endl;
 }
 
-void exec(const int expt_id, const int wkld_id, const bool is_point, const bool is_compressed, const int encoder_type,
-          const int64_t dict_size_id, const std::vector<std::string> &insert_keys,
-          const std::vector<std::string> &insert_keys_sample, const std::vector<std::string> &txn_keys,
-          const std::vector<int> &scan_key_lens) {
+typedef tlx::btree_map<std::string, uint64_t, std::less<std::string> > btree_type;
+typedef tlx::string_btree_map<uint64_t> separator_btree_type;
+
+template <class Iter>
+uint64_t iterData(const Iter &iter) {
+  return iter->second;
+}
+
+uint64_t iterData(const separator_btree_type::const_iterator &iter) { return iter.data(); }
+
+// Nodes are estimated at 256 bytes each. Both trees have nodes of the
+// same size, except for the key prefixes in separator tree leaves; that
+// tree also owns its out-of-line separators
+int64_t btreeSize(const btree_type &bt) { return 256 * bt.get_stats().nodes(); }
+
+int64_t btreeSize(const separator_btree_type &bt) {
+  return 256 * bt.get_stats().nodes() +
+         bt.get_stats().leaves * separator_btree_type::leaf_prefix_slots * sizeof(uint64_t) +
+         bt.get_stats().overflow_bytes;
+}
+
+// Results files of the separator tree get a "sep_" prefix
+std::string resultFile(const std::string &file_name) {
+  if (!kRunSeparatorTree) return file_name;
+  size_t pos = file_name.rfind('/') + 1;
+  return file_name.substr(0, pos) + "sep_" + file_name.substr(pos);
+}
+
+template <class BTreeType>
+void exec_tree(const int expt_id, const int wkld_id, const bool is_point, const bool is_compressed,
+               const int encoder_type, const int64_t dict_size_id, const std::vector<std::string> &insert_keys,
+               const std::vector<std::string> &insert_keys_sample, const std::vector<std::string> &txn_keys,
+               const std::vector<int> &scan_key_lens) {
   hope::Encoder *encoder = nullptr;
   uint8_t *buffer = new uint8_t[8192];
   std::vector<std::pair<std::string, std::string> > enc_insert_keys;
@@ -210,8 +243,7 @@ void exec(const int expt_id, const int wkld_id, const bool is_point, const bool
     enc_insert_keys.push_back(std::make_pair(insert_keys[i], encode_str));
   }
 
-  typedef tlx::btree_map<std::string, uint64_t, std::less<std::string> > btree_type;
-  btree_type *bt = new btree_type();
+  BTreeType *bt = new BTreeType();
   double insert_start_time = getNow();
   for (int i = 0; i < (int)enc_insert_keys.size(); i++) {
     std::pair<std::string, std::string> *tmp_pair = &enc_insert_keys[i];
@@ -231,10 +263,10 @@ void exec(const int expt_id, const int wkld_id, const bool is_point, const bool
   std::cout << "leaves = " << bt->get_stats().leaves << std::endl;
   std::cout << "inner_nodes = " << bt->get_stats().inner_nodes << std::endl;
   std::cout << "avgfill = " << bt->get_stats().avgfill_leaves() << std::endl;
-  std::cout << "btree size = " << (256 * bt->get_stats().nodes()) << std::endl;
+  int64_t btree_size = btreeSize(*bt);
+  std::cout << "btree size = " << btree_size << std::endl;
   std::cout << "total key size = " << total_key_size << std::endl;
 
-  int64_t btree_size = 256 * bt->get_stats().nodes();
   double encoder_mem = 0;
   if (encoder != nullptr) encoder_mem = encoder->memoryUse();
   double mem = (btree_size + total_key_size + encoder_mem) / 1000000.0;
@@ -250,13 +282,13 @@ void exec(const int expt_id, const int wkld_id, const bool is_point, const bool
         int enc_len = encoder->encode(txn_keys[i], buffer);
         int enc_len_round = (enc_len + 7) >> 3;
         std::string enc_key = std::string((const char *)buffer, enc_len_round);
-        btree_type::const_iterator iter = bt->find(enc_key);
-        sum += (iter->second);
+        typename BTreeType::const_iterator iter = bt->find(enc_key);
+        sum += iterData(iter);
       }
     } else {
       for (int i = 0; i < (int)txn_keys.size(); i++) {
-        btree_type::const_iterator iter = bt->find(txn_keys[i]);
-        sum += (iter->second);
+        typename BTreeType::const_iterator iter = bt->find(txn_keys[i]);
+        sum += iterData(iter);
       }
     }
   } else {  // range query
@@ -266,10 +298,10 @@ void exec(const int expt_id, const int wkld_id, const bool is_point, const bool
         enc_len = encoder->encode(txn_keys[i], buffer);
         int enc_len_round = (enc_len + 7) >> 3;
         std::string left_key = std::string((const char *)buffer, enc_len_round);
-        btree_type::const_iterator iter = bt->lower_bound(left_key);
+        typename BTreeType::const_iterator iter = bt->lower_bound(left_key);
         int cnt = 0;
         while (iter != bt->end() && iter.key().compare(endStr) < 0 && cnt < scan_key_lens[i]) {
-          TIDs[cnt] = iter->second;
+          TIDs[cnt] = iterData(iter);
           ++iter;
           ++cnt;
         }
@@ -277,10 +309,10 @@ void exec(const int expt_id, const int wkld_id, const bool is_point, const bool
       std::cout << "Finish Uncompressed Range Query" << std::endl;
     } else {
       for (int i = 0; i < (int)txn_keys.size(); i++) {
-        btree_type::const_iterator iter = bt->lower_bound(txn_keys[i]);
+        typename BTreeType::const_iterator iter = bt->lower_bound(txn_keys[i]);
         int cnt = 0;
         while (iter != bt->end() && iter.key().compare(endStr) < 0 && cnt < scan_key_lens[i]) {
-          TIDs[cnt] = iter->second;
+          TIDs[cnt] = iterData(iter);
           ++iter;
           ++cnt;
         }
@@ -333,6 +365,18 @@ void exec(const int expt_id, const int wkld_id, const bool is_point, const bool
   }
 }
 
+void exec(const int expt_id, const int wkld_id, const bool is_point, const bool is_compressed, const int encoder_type,
+          const int64_t dict_size_id, const std::vector<std::string> &insert_keys,
+          const std::vector<std::string> &insert_keys_sample, const std::vector<std::string> &txn_keys,
+          const std::vector<int> &scan_key_lens) {
+  if (kRunSeparatorTree)
+    exec_tree<separator_btree_type>(expt_id, wkld_id, is_point, is_compressed, encoder_type, dict_size_id,
+                                    insert_keys, insert_keys_sample, txn_keys, scan_key_lens);
+  else
+    exec_tree<btree_type>(expt_id, wkld_id, is_point, is_compressed, encoder_type, dict_size_id, insert_keys,
+                          insert_keys_sample, txn_keys, scan_key_lens);
+}
+
 void exec_group(const int expt_id, const bool is_point, int &expt_num, const int total_num_expt,
                 const std::vector<std::string> &insert_emails, const std::vector<std::string> &insert_emails_sample,
                 const std::vector<std::string> &txn_emails, const std::vector<int> &upper_bound_emails,
@@ -446,6 +490,10 @@ int main(int argc, char *argv[]) {
   kRunEmail = (int)atoi(argv[3]);
   kRunWiki = (int)atoi(argv[4]);
   kRunUrl = (int)atoi(argv[5]);
+  if (expt_id >= 2) {
+    kRunSeparatorTree = true;
+    expt_id -= 2;
+  }
 
   //-------------------------------------------------------------
   // Init Workloads
@@ -477,21 +525,21 @@ int main(int argc, char *argv[]) {
     std::cout << "====================================" << std::endl;
 
     if (kRunEmail) {
-      output_lookuplat_email_btree.open(file_lookuplat_email_btree, std::ofstream::app);
-      output_insertlat_email_btree.open(file_insertlat_email_btree, std::ofstream::app);
-      output_mem_email_btree.open(file_mem_email_btree, std::ofstream::app);
+      output_lookuplat_email_btree.open(resultFile(file_lookuplat_email_btree), std::ofstream::app);
+      output_insertlat_email_btree.open(resultFile(file_insertlat_email_btree), std::ofstream::app);
+      output_mem_email_btree.open(resultFile(file_mem_email_btree), std::ofstream::app);
     }
 
     if (kRunWiki) {
-      output_lookuplat_wiki_btree.open(file_lookuplat_wiki_btree, std::ofstream::app);
-      output_insertlat_wiki_btree.open(file_insertlat_wiki_btree, std::ofstream::app);
-      output_mem_wiki_btree.open(file_mem_wiki_btree, std::ofstream::app);
+      output_lookuplat_wiki_btree.open(resultFile(file_lookuplat_wiki_btree), std::ofstream::app);
+      output_insertlat_wiki_btree.open(resultFile(file_insertlat_wiki_btree), std::ofstream::app);
+      output_mem_wiki_btree.open(resultFile(file_mem_wiki_btree), std::ofstream::app);
     }
 
     if (kRunUrl) {
-      output_lookuplat_url_btree.open(file_lookuplat_url_btree, std::ofstream::app);
-      output_insertlat_url_btree.open(file_insertlat_url_btree, std::ofstream::app);
-      output_mem_url_btree.open(file_mem_url_btree, std::ofstream::app);
+      output_lookuplat_url_btree.open(resultFile(file_lookuplat_url_btree), std::ofstream::app);
+      output_insertlat_url_btree.open(resultFile(file_insertlat_url_btree), std::ofstream::app);
+      output_mem_url_btree.open(resultFile(file_mem_url_btree), std::ofstream::app);
     }
 
     bool is_point = true;
@@ -548,21 +596,21 @@ int main(int argc, char *argv[]) {
     std::cout << "====================================" << std::endl;
 
     if (kRunEmail) {
-      output_lookuplat_email_btree_range.open(file_lookuplat_email_btree_range, std::ofstream::app);
-      output_insertlat_email_btree_range.open(file_insertlat_email_btree_range, std::ofstream::app);
-      output_mem_email_btree_range.open(file_mem_email_btree_range, std::ofstream::app);
+      output_lookuplat_email_btree_range.open(resultFile(file_lookuplat_email_btree_range), std::ofstream::app);
+      output_insertlat_email_btree_range.open(resultFile(file_insertlat_email_btree_range), std::ofstream::app);
+      output_mem_email_btree_range.open(resultFile(file_mem_email_btree_range), std::ofstream::app);
     }
 
     if (kRunWiki) {
-      output_lookuplat_wiki_btree_range.open(file_lookuplat_wiki_btree_range, std::ofstream::app);
-      output_insertlat_wiki_btree_range.open(file_insertlat_wiki_btree_range, std::ofstream::app);
-      output_mem_wiki_btree_range.open(file_mem_wiki_btree_range, std::ofstream::app);
+      output_lookuplat_wiki_btree_range.open(resultFile(file_lookuplat_wiki_btree_range), std::ofstream::app);
+      output_insertlat_wiki_btree_range.open(resultFile(file_insertlat_wiki_btree_range), std::ofstream::app);
+      output_mem_wiki_btree_range.open(resultFile(file_mem_wiki_btree_range), std::ofstream::app);
     }
 
     if (kRunUrl) {
-      output_lookuplat_url_btree_range.open(file_lookuplat_url_btree_range, std::ofstream::app);
-      output_insertlat_url_btree_range.open(file_insertlat_url_btree_range, std::ofstream::app);
-      output_mem_url_btree_range.open(file_mem_url_btree_range, std::ofstream::app);
+      output_lookuplat_url_btree_range.open(resultFile(file_lookuplat_url_btree_range), std::ofstream::app);
+      output_insertlat_url_btree_range.open(resultFile(file_insertlat_url_btree_range), std::ofstream::app);
+      output_mem_url_btree_range.open(resultFile(file_mem_url_btree_range), std::ofstream::app);
     }
 
     bool is_point = false;
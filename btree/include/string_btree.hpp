@@ -0,0 +1,740 @@
+/*******************************************************************************
+ * string_btree.hpp
+ *
+ * A B+ tree map from std::string keys to fixed-size data, laid out for
+ * (HOPE-encoded) byte-string keys.
+ ******************************************************************************/
+
+#ifndef TLX_CONTAINER_STRING_BTREE_HEADER
+#define TLX_CONTAINER_STRING_BTREE_HEADER
+
+#include "btree.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace tlx {
+
+//! \addtogroup tlx_container_btree
+//! \{
+
+/*!
+ * Default node parameters of string_btree_map. Leaves hold as many slots as
+ * those of tlx::btree_map<std::string, Data>; inner nodes have the same size
+ * as its inner nodes (336 bytes on 64-bit) but hold twice as many separators.
+ */
+template <typename Data>
+struct string_btree_default_traits {
+    //! Number of key/data slots in each leaf.
+    static const int leaf_slots =
+        TLX_BTREE_MAX(8, 256 / (sizeof(std::string) + sizeof(Data)));
+
+    //! Maximum number of separators in each inner node.
+    static const int inner_slots = 16;
+
+    //! Size of the byte area holding the separators of an inner node.
+    static const int inner_key_bytes = 128;
+
+    //! Separators longer than this are stored out of line and the byte area
+    //! holds a pointer to them. Must be at most inner_key_bytes / 4.
+    static const int inner_inline_max = 32;
+};
+
+/*!
+ * B+ tree map with std::string keys whose inner nodes store suffix-truncated
+ * separators. A separator between two children is the shortest prefix of the
+ * right child's first key that is greater than the left child's last key, so
+ * for keys with long shared prefixes (or short encoded keys) it is usually a
+ * few bytes long. Separators are packed into a byte area inside the inner
+ * node instead of being held as std::string objects, and an inner node splits
+ * when either its slots or its byte area run out.
+ *
+ * Leaves keep the first 8 bytes of each key as a big-endian integer in a
+ * contiguous array next to the std::string keys. Leaf searches compare these
+ * prefixes (4 at a time with AVX2) and only read a full key, which may live
+ * on the heap, when its prefix ties with the search key's.
+ *
+ * The map supports unique-key insertion, lookups and ordered iteration; it
+ * has no erase.
+ */
+template <typename Data,
+          typename Traits = string_btree_default_traits<Data> >
+class string_btree_map
+{
+public:
+    //! \name Template Parameter Types
+    //! \{
+
+    typedef std::string key_type;
+    typedef Data data_type;
+    typedef Traits traits;
+    typedef size_t size_type;
+
+    //! \}
+
+    static const unsigned short leaf_slotmax = traits::leaf_slots;
+    static const unsigned short inner_slotmax = traits::inner_slots;
+    static const unsigned short inner_key_bytes = traits::inner_key_bytes;
+    static const unsigned short inner_inline_max = traits::inner_inline_max;
+
+    //! Key prefix slots in each leaf, rounded up to whole 4-slot vectors
+    static const unsigned short leaf_prefix_slots = (leaf_slotmax + 3) / 4 * 4;
+
+    // splitting a full inner node by bytes leaves room for one more separator
+    // in either half only if every entry is at most a quarter of the area
+    static_assert(inner_slotmax >= 4, "inner nodes need at least 4 slots");
+    static_assert(inner_inline_max >= sizeof(char*),
+                  "the byte area must be able to hold a pointer");
+    static_assert(4 * inner_inline_max <= inner_key_bytes,
+                  "inner_inline_max must be at most inner_key_bytes / 4");
+
+private:
+    //! \name Node Classes for In-Memory Nodes
+    //! \{
+
+    struct node {
+        //! Level in the b-tree, if level == 0 -> leaf node
+        unsigned short level;
+
+        //! Number of keys in use
+        unsigned short slotuse;
+
+        bool is_leafnode() const {
+            return (level == 0);
+        }
+    };
+
+    //! Inner node: slotuse separators and slotuse + 1 children. Separator s
+    //! occupies keybytes[slotoff[s], slotoff[s + 1]) and the entries are kept
+    //! in slot order, so inserting one shifts the bytes after it.
+    struct InnerNode : public node {
+        //! Bytes of keybytes in use
+        unsigned short bytesuse;
+
+        //! Start of each separator in keybytes
+        unsigned short slotoff[inner_slotmax + 1]; // NOLINT
+
+        //! Length of each separator
+        unsigned short slotlen[inner_slotmax]; // NOLINT
+
+        //! Pointers to children
+        node* childid[inner_slotmax + 1]; // NOLINT
+
+        //! Inline separators, or pointers to long out-of-line ones
+        char keybytes[inner_key_bytes]; // NOLINT
+
+        explicit InnerNode(const unsigned short l) {
+            node::level = l;
+            node::slotuse = 0;
+            bytesuse = 0;
+            slotoff[0] = 0;
+        }
+
+        ~InnerNode() {
+            for (unsigned short s = 0; s < node::slotuse; s++) {
+                if (slotlen[s] > inner_inline_max) delete[] key_data(s);
+            }
+        }
+
+        static unsigned short entry_size(size_t len) {
+            return (len > inner_inline_max) ? sizeof(char*) : len;
+        }
+
+        //! Bytes of separator s
+        const char * key_data(unsigned short s) const {
+            if (slotlen[s] <= inner_inline_max) return keybytes + slotoff[s];
+            const char* ptr;
+            memcpy(&ptr, keybytes + slotoff[s], sizeof(ptr));
+            return ptr;
+        }
+
+        size_t key_len(unsigned short s) const {
+            return slotlen[s];
+        }
+
+        //! True if a separator of length len can be added.
+        bool has_room(size_t len) const {
+            return node::slotuse < inner_slotmax &&
+                   bytesuse + entry_size(len) <= inner_key_bytes;
+        }
+
+        //! Insert separator key at slot and child right of it.
+        void insert_slot(unsigned short slot, const std::string& key,
+                         node* child) {
+            TLX_BTREE_ASSERT(has_room(key.size()));
+            unsigned short size = entry_size(key.size());
+            memmove(keybytes + slotoff[slot] + size, keybytes + slotoff[slot],
+                    bytesuse - slotoff[slot]);
+            for (unsigned short s = node::slotuse; s > slot; s--) {
+                slotoff[s + 1] = slotoff[s] + size;
+                slotlen[s] = slotlen[s - 1];
+                childid[s + 1] = childid[s];
+            }
+            slotoff[slot + 1] = slotoff[slot] + size;
+            slotlen[slot] = key.size();
+            childid[slot + 1] = child;
+            if (key.size() > inner_inline_max) {
+                char* ptr = new char[key.size()];
+                memcpy(ptr, key.data(), key.size());
+                memcpy(keybytes + slotoff[slot], &ptr, sizeof(ptr));
+            }
+            else {
+                memcpy(keybytes + slotoff[slot], key.data(), key.size());
+            }
+            node::slotuse++;
+            bytesuse += size;
+        }
+
+        //! Slot at which to split a node whose slots or bytes are exhausted:
+        //! the first slot at which half of the bytes are used, clamped so
+        //! that both halves keep a separator.
+        unsigned short split_slot() const {
+            unsigned short mid = 0;
+            while (2 * slotoff[mid] < bytesuse) mid++;
+            return std::max<unsigned short>(
+                1, std::min<unsigned short>(mid, node::slotuse - 2));
+        }
+    };
+
+    //! Leaf node: sorted keys and their data, linked to its neighbours.
+    struct LeafNode : public node {
+        LeafNode* prev_leaf;
+        LeafNode* next_leaf;
+
+        //! key_prefix() of each key; unused slots hold the maximum so that
+        //! they never count as less than a search key
+        uint64_t slotprefix[leaf_prefix_slots]; // NOLINT
+
+        key_type slotkey[leaf_slotmax]; // NOLINT
+        data_type slotdata[leaf_slotmax]; // NOLINT
+
+        LeafNode() : prev_leaf(nullptr), next_leaf(nullptr) {
+            node::level = 0;
+            node::slotuse = 0;
+            std::fill(slotprefix, slotprefix + leaf_prefix_slots, UINT64_MAX);
+        }
+
+        //! Number of used slots whose prefix is less than prefix.
+        unsigned short count_less(uint64_t prefix) const {
+#ifdef __AVX2__
+            // flip the sign bits to compare unsigned with signed compares
+            const __m256i flip = _mm256_set1_epi64x(INT64_MIN);
+            const __m256i p =
+                _mm256_xor_si256(_mm256_set1_epi64x(prefix), flip);
+            unsigned count = 0;
+            for (unsigned short s = 0; s < leaf_prefix_slots; s += 4) {
+                __m256i v = _mm256_xor_si256(
+                    _mm256_loadu_si256((const __m256i*)(slotprefix + s)), flip);
+                count += __builtin_popcount(_mm256_movemask_pd(
+                    _mm256_castsi256_pd(_mm256_cmpgt_epi64(p, v))));
+            }
+            return count;
+#else
+            unsigned short count = 0;
+            while (count < node::slotuse && slotprefix[count] < prefix) count++;
+            return count;
+#endif
+        }
+
+        bool is_full() const {
+            return (node::slotuse == leaf_slotmax);
+        }
+    };
+
+    //! \}
+
+public:
+    //! \name Iterators
+    //! \{
+
+    //! Read-only iterator pointing to a slot in a leaf. end() points one past
+    //! the last slot of the last leaf.
+    class const_iterator
+    {
+    public:
+        const_iterator() : curr_leaf(nullptr), curr_slot(0) { }
+
+        const_iterator(const LeafNode* l, unsigned short s)
+            : curr_leaf(l), curr_slot(s) { }
+
+        const key_type& key() const {
+            return curr_leaf->slotkey[curr_slot];
+        }
+
+        const data_type& data() const {
+            return curr_leaf->slotdata[curr_slot];
+        }
+
+        const_iterator& operator ++ () {
+            if (curr_slot + 1u < curr_leaf->slotuse) {
+                ++curr_slot;
+            }
+            else if (curr_leaf->next_leaf != nullptr) {
+                curr_leaf = curr_leaf->next_leaf;
+                curr_slot = 0;
+            }
+            else {
+                // this is end()
+                curr_slot = curr_leaf->slotuse;
+            }
+            return *this;
+        }
+
+        bool operator == (const const_iterator& x) const {
+            return (x.curr_leaf == curr_leaf) && (x.curr_slot == curr_slot);
+        }
+
+        bool operator != (const const_iterator& x) const {
+            return (x.curr_leaf != curr_leaf) || (x.curr_slot != curr_slot);
+        }
+
+    private:
+        const LeafNode* curr_leaf;
+        unsigned short curr_slot;
+    };
+
+    //! \}
+
+    //! \name Small Statistics Structure
+    //! \{
+
+    struct tree_stats {
+        //! Number of items in the B+ tree
+        size_type size;
+
+        //! Number of leaves in the B+ tree
+        size_type leaves;
+
+        //! Number of inner nodes in the B+ tree
+        size_type inner_nodes;
+
+        //! Total length of the separators in inner nodes
+        size_type separator_bytes;
+
+        //! Bytes of separators stored out of line
+        size_type overflow_bytes;
+
+        static const unsigned short leaf_slots = leaf_slotmax;
+
+        tree_stats()
+            : size(0), leaves(0), inner_nodes(0),
+              separator_bytes(0), overflow_bytes(0)
+        { }
+
+        size_type nodes() const {
+            return inner_nodes + leaves;
+        }
+
+        double avgfill_leaves() const {
+            return static_cast<double>(size) / (leaves * leaf_slots);
+        }
+    };
+
+    //! \}
+
+private:
+    node* root_;
+    LeafNode* head_leaf_;
+    LeafNode* tail_leaf_;
+    tree_stats stats_;
+
+public:
+    //! \name Constructors and Destructor
+    //! \{
+
+    string_btree_map()
+        : root_(nullptr), head_leaf_(nullptr), tail_leaf_(nullptr)
+    { }
+
+    ~string_btree_map() {
+        clear();
+    }
+
+    string_btree_map(const string_btree_map&) = delete;
+    string_btree_map& operator = (const string_btree_map&) = delete;
+
+    //! Frees all nodes.
+    void clear() {
+        if (root_) free_recursive(root_);
+        root_ = nullptr;
+        head_leaf_ = tail_leaf_ = nullptr;
+        stats_ = tree_stats();
+    }
+
+    //! \}
+
+    //! \name Access Functions
+    //! \{
+
+    size_type size() const {
+        return stats_.size;
+    }
+
+    bool empty() const {
+        return (size() == size_type(0));
+    }
+
+    const tree_stats& get_stats() const {
+        return stats_;
+    }
+
+    //! Bytes used by nodes and out-of-line separators. Heap buffers of long
+    //! std::string keys in the leaves are not counted.
+    size_type memory_use() const {
+        return stats_.leaves * sizeof(LeafNode) +
+               stats_.inner_nodes * sizeof(InnerNode) + stats_.overflow_bytes;
+    }
+
+    const_iterator begin() const {
+        return const_iterator(head_leaf_, 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(tail_leaf_, tail_leaf_ ? tail_leaf_->slotuse : 0);
+    }
+
+    //! \}
+
+    //! \name Lookups
+    //! \{
+
+    const_iterator find(const key_type& key) const {
+        if (!root_) return end();
+        const LeafNode* leaf = find_leaf(key);
+        uint64_t prefix = key_prefix(key);
+        unsigned short slot = find_lower(leaf, key, prefix);
+        if (slot < leaf->slotuse && leaf->slotprefix[slot] == prefix &&
+            leaf->slotkey[slot] == key)
+            return const_iterator(leaf, slot);
+        return end();
+    }
+
+    //! Iterator to the first key not less than key.
+    const_iterator lower_bound(const key_type& key) const {
+        if (!root_) return end();
+        const LeafNode* leaf = find_leaf(key);
+        unsigned short slot = find_lower(leaf, key, key_prefix(key));
+        if (slot == leaf->slotuse && leaf->next_leaf != nullptr)
+            return const_iterator(leaf->next_leaf, 0);
+        return const_iterator(leaf, slot);
+    }
+
+    //! \}
+
+    //! \name Insertion
+    //! \{
+
+    //! Insert key with data unless the key is already present. Returns the
+    //! iterator to the key and whether it was inserted.
+    std::pair<const_iterator, bool> insert2(const key_type& key,
+                                            const data_type& data) {
+        if (!root_) {
+            root_ = head_leaf_ = tail_leaf_ = new LeafNode();
+            stats_.leaves++;
+        }
+
+        std::string newkey;
+        node* newchild = nullptr;
+        std::pair<const_iterator, bool> r =
+            insert_descend(root_, key, data, &newkey, &newchild);
+
+        if (newchild) {
+            InnerNode* newroot = new InnerNode(root_->level + 1);
+            newroot->childid[0] = root_;
+            newroot->insert_slot(0, newkey, newchild);
+            add_separator_stats(newkey.size());
+            root_ = newroot;
+            stats_.inner_nodes++;
+        }
+
+        if (r.second) stats_.size++;
+        return r;
+    }
+
+    //! \}
+
+    //! \name Verification of B+ Tree Invariants
+    //! \{
+
+    //! Check key order, separator bounds, leaf links and counters. Aborts via
+    //! tlx_die_unless() if something is wrong.
+    void verify() const {
+        tree_stats vstats;
+        if (root_) {
+            verify_node(root_, nullptr, nullptr, vstats);
+
+            const LeafNode* leaf = head_leaf_;
+            size_type count = 0;
+            tlx_die_unless(leaf->prev_leaf == nullptr);
+            while (leaf) {
+                count += leaf->slotuse;
+                if (leaf->next_leaf) {
+                    tlx_die_unless(leaf->next_leaf->prev_leaf == leaf);
+                    tlx_die_unless(leaf->slotkey[leaf->slotuse - 1] <
+                                   leaf->next_leaf->slotkey[0]);
+                }
+                else {
+                    tlx_die_unless(leaf == tail_leaf_);
+                }
+                leaf = leaf->next_leaf;
+            }
+            tlx_die_unless(count == stats_.size);
+        }
+        tlx_die_unless(vstats.size == stats_.size);
+        tlx_die_unless(vstats.leaves == stats_.leaves);
+        tlx_die_unless(vstats.inner_nodes == stats_.inner_nodes);
+        tlx_die_unless(vstats.separator_bytes == stats_.separator_bytes);
+        tlx_die_unless(vstats.overflow_bytes == stats_.overflow_bytes);
+    }
+
+    //! \}
+
+private:
+    static int compare(const char* a, size_t alen, const char* b, size_t blen) {
+        int cmp = memcmp(a, b, std::min(alen, blen));
+        if (cmp != 0) return cmp;
+        return (alen < blen) ? -1 : (alen > blen);
+    }
+
+    //! Shortest s with left < s <= right, a prefix of right.
+    static std::string shortest_separator(const std::string& left,
+                                          const std::string& right) {
+        size_t len = 0;
+        while (len < left.size() && left[len] == right[len]) len++;
+        return right.substr(0, len + 1);
+    }
+
+    //! Child slot for key: the number of separators not greater than key.
+    static unsigned short find_child(const InnerNode* inner,
+                                     const key_type& key) {
+        unsigned short lo = 0, hi = inner->slotuse;
+        while (lo < hi) {
+            unsigned short mid = (lo + hi) >> 1;
+            if (compare(key.data(), key.size(), inner->key_data(mid),
+                        inner->key_len(mid)) < 0)
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        return lo;
+    }
+
+    //! First 8 bytes of key, zero-padded, as a big-endian integer. Prefixes
+    //! order like their keys but may tie for different keys.
+    static uint64_t key_prefix(const key_type& key) {
+        uint64_t word = 0;
+        memcpy(&word, key.data(), std::min<size_t>(key.size(), sizeof(word)));
+        return __builtin_bswap64(word);
+    }
+
+    //! First slot in leaf whose key is not less than key. Full keys are only
+    //! compared among the slots whose prefix equals key's.
+    static unsigned short find_lower(const LeafNode* leaf, const key_type& key,
+                                     uint64_t prefix) {
+        unsigned short slot = leaf->count_less(prefix);
+        while (slot < leaf->slotuse && leaf->slotprefix[slot] == prefix &&
+               leaf->slotkey[slot] < key)
+            slot++;
+        return slot;
+    }
+
+    const LeafNode * find_leaf(const key_type& key) const {
+        const node* n = root_;
+        while (!n->is_leafnode()) {
+            const InnerNode* inner = static_cast<const InnerNode*>(n);
+            n = inner->childid[find_child(inner, key)];
+        }
+        return static_cast<const LeafNode*>(n);
+    }
+
+    void add_separator_stats(size_t len) {
+        stats_.separator_bytes += len;
+        if (len > inner_inline_max) stats_.overflow_bytes += len;
+    }
+
+    //! Insert into the subtree of n. If n splits, *splitnode is its new right
+    //! sibling and *splitkey the separator between the two.
+    std::pair<const_iterator, bool> insert_descend(
+        node* n, const key_type& key, const data_type& data,
+        std::string* splitkey, node** splitnode) {
+        if (!n->is_leafnode()) {
+            InnerNode* inner = static_cast<InnerNode*>(n);
+            unsigned short slot = find_child(inner, key);
+
+            std::string newkey;
+            node* newchild = nullptr;
+            std::pair<const_iterator, bool> r = insert_descend(
+                inner->childid[slot], key, data, &newkey, &newchild);
+
+            if (newchild) {
+                add_separator_stats(newkey.size());
+                if (!inner->has_room(newkey.size())) {
+                    unsigned short mid = inner->split_slot();
+                    split_inner_node(inner, mid, splitkey, splitnode);
+                    if (slot > mid) {
+                        inner = static_cast<InnerNode*>(*splitnode);
+                        slot -= mid + 1;
+                    }
+                }
+                inner->insert_slot(slot, newkey, newchild);
+            }
+            return r;
+        }
+
+        LeafNode* leaf = static_cast<LeafNode*>(n);
+        uint64_t prefix = key_prefix(key);
+        unsigned short slot = find_lower(leaf, key, prefix);
+        if (slot < leaf->slotuse && leaf->slotprefix[slot] == prefix &&
+            leaf->slotkey[slot] == key)
+            return std::make_pair(const_iterator(leaf, slot), false);
+
+        if (leaf->is_full()) {
+            split_leaf_node(leaf, splitkey, splitnode);
+            if (key >= *splitkey) {
+                slot -= leaf->slotuse;
+                leaf = static_cast<LeafNode*>(*splitnode);
+            }
+        }
+
+        for (unsigned short s = leaf->slotuse; s > slot; s--) {
+            leaf->slotprefix[s] = leaf->slotprefix[s - 1];
+            leaf->slotkey[s].swap(leaf->slotkey[s - 1]);
+            leaf->slotdata[s] = leaf->slotdata[s - 1];
+        }
+        leaf->slotprefix[slot] = prefix;
+        leaf->slotkey[slot] = key;
+        leaf->slotdata[slot] = data;
+        leaf->slotuse++;
+        return std::make_pair(const_iterator(leaf, slot), true);
+    }
+
+    //! Move the upper half of leaf into a new right sibling.
+    void split_leaf_node(LeafNode* leaf, std::string* splitkey,
+                         node** splitnode) {
+        unsigned short mid = leaf->slotuse >> 1;
+        LeafNode* newleaf = new LeafNode();
+        for (unsigned short s = mid; s < leaf->slotuse; s++) {
+            newleaf->slotprefix[s - mid] = leaf->slotprefix[s];
+            leaf->slotprefix[s] = UINT64_MAX;
+            newleaf->slotkey[s - mid].swap(leaf->slotkey[s]);
+            newleaf->slotdata[s - mid] = leaf->slotdata[s];
+        }
+        newleaf->slotuse = leaf->slotuse - mid;
+        leaf->slotuse = mid;
+
+        newleaf->next_leaf = leaf->next_leaf;
+        if (newleaf->next_leaf)
+            newleaf->next_leaf->prev_leaf = newleaf;
+        else
+            tail_leaf_ = newleaf;
+        leaf->next_leaf = newleaf;
+        newleaf->prev_leaf = leaf;
+        stats_.leaves++;
+
+        *splitkey = shortest_separator(leaf->slotkey[mid - 1],
+                                       newleaf->slotkey[0]);
+        *splitnode = newleaf;
+    }
+
+    //! Move the separators after mid and their children into a new right
+    //! sibling; separator mid moves up into *splitkey.
+    void split_inner_node(InnerNode* inner, unsigned short mid,
+                          std::string* splitkey, node** splitnode) {
+        InnerNode* newinner = new InnerNode(inner->level);
+        unsigned short base = inner->slotoff[mid + 1];
+        memcpy(newinner->keybytes, inner->keybytes + base,
+               inner->bytesuse - base);
+        for (unsigned short s = mid + 1; s < inner->slotuse; s++) {
+            newinner->slotoff[s - mid] = inner->slotoff[s + 1] - base;
+            newinner->slotlen[s - mid - 1] = inner->slotlen[s];
+        }
+        for (unsigned short s = mid + 1; s <= inner->slotuse; s++)
+            newinner->childid[s - mid - 1] = inner->childid[s];
+        newinner->slotuse = inner->slotuse - mid - 1;
+        newinner->bytesuse = inner->bytesuse - base;
+
+        // the middle separator moves up and leaves this level
+        splitkey->assign(inner->key_data(mid), inner->key_len(mid));
+        stats_.separator_bytes -= inner->key_len(mid);
+        if (inner->key_len(mid) > inner_inline_max) {
+            stats_.overflow_bytes -= inner->key_len(mid);
+            delete[] inner->key_data(mid);
+        }
+        inner->slotuse = mid;
+        inner->bytesuse = inner->slotoff[mid];
+
+        stats_.inner_nodes++;
+        *splitnode = newinner;
+    }
+
+    void free_recursive(node* n) {
+        if (n->is_leafnode()) {
+            delete static_cast<LeafNode*>(n);
+            return;
+        }
+        InnerNode* inner = static_cast<InnerNode*>(n);
+        for (unsigned short s = 0; s <= inner->slotuse; s++)
+            free_recursive(inner->childid[s]);
+        delete inner;
+    }
+
+    //! Verify the subtree of n, whose keys must lie in [*lower, *upper).
+    //! A null bound is unbounded.
+    void verify_node(const node* n, const std::string* lower,
+                     const std::string* upper, tree_stats& vstats) const {
+        if (n->is_leafnode()) {
+            const LeafNode* leaf = static_cast<const LeafNode*>(n);
+            tlx_die_unless(leaf == root_ || leaf->slotuse > 0);
+            for (unsigned short s = 0; s < leaf->slotuse; s++) {
+                if (s > 0)
+                    tlx_die_unless(leaf->slotkey[s - 1] < leaf->slotkey[s]);
+                tlx_die_unless(leaf->slotprefix[s] ==
+                               key_prefix(leaf->slotkey[s]));
+                if (lower) tlx_die_unless(*lower <= leaf->slotkey[s]);
+                if (upper) tlx_die_unless(leaf->slotkey[s] < *upper);
+            }
+            for (unsigned short s = leaf->slotuse; s < leaf_prefix_slots; s++)
+                tlx_die_unless(leaf->slotprefix[s] == UINT64_MAX);
+            vstats.size += leaf->slotuse;
+            vstats.leaves++;
+            return;
+        }
+
+        const InnerNode* inner = static_cast<const InnerNode*>(n);
+        tlx_die_unless(inner->slotuse > 0);
+        tlx_die_unless(inner->slotoff[inner->slotuse] == inner->bytesuse);
+        tlx_die_unless(inner->bytesuse <= inner_key_bytes);
+        for (unsigned short s = 0; s <= inner->slotuse; s++) {
+            tlx_die_unless(inner->childid[s]->level == inner->level - 1);
+            std::string lo, hi;
+            if (s > 0) lo.assign(inner->key_data(s - 1), inner->key_len(s - 1));
+            if (s < inner->slotuse) {
+                hi.assign(inner->key_data(s), inner->key_len(s));
+                tlx_die_unless(inner->slotoff[s + 1] - inner->slotoff[s] ==
+                               InnerNode::entry_size(hi.size()));
+                vstats.separator_bytes += hi.size();
+                if (hi.size() > inner_inline_max)
+                    vstats.overflow_bytes += hi.size();
+                if (s > 0) tlx_die_unless(lo < hi);
+            }
+            verify_node(inner->childid[s], (s > 0) ? &lo : lower,
+                        (s < inner->slotuse) ? &hi : upper, vstats);
+        }
+        vstats.inner_nodes++;
+    }
+};
+
+//! \}
+
+} // namespace tlx
+
+#endif // !TLX_CONTAINER_STRING_BTREE_HEADER
@@ -35,11 +35,13 @@ int main() {
     // compress all keys
     std::vector<std::string> enc_keys;
     int64_t total_enc_len = 0;
-    uint8_t *buffer = new uint8_t[1024];
     for (int i = 0; i < (int)keys.size(); i++) {
-	int bit_len = encoder->encode(keys[i], buffer);
+	// size the destination exactly and encode straight into it
+	int bit_len = encoder->encodedBitLen(keys[i]);
+	std::string enc_key((bit_len + 7) / 8, 0);
+	encoder->encodeInto(keys[i], (uint8_t *)&enc_key[0], (int)enc_key.size());
 	total_enc_len += bit_len;
-	enc_keys.push_back(std::string((const char *)buffer, (bit_len + 7) / 8));
+	enc_keys.push_back(enc_key);
     }
 
     double cpr_rate =  total_key_len / (total_enc_len + 0.0);
@@ -37,6 +37,12 @@ typedef struct {
   Code code;
 } IntervalCode;
 
+// A borrowed key, e.g., pointing into an mmaped page or an index node
+typedef struct {
+  const char *data;
+  int len;
+} KeySlice;
+
 typedef typename std::pair<std::string, int64_t> SymbolFreq;
 
 typedef typename std::pair<std::string, Code> SymbolCode;
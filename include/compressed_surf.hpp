@@ -0,0 +1,237 @@
+#ifndef COMPRESSED_SURF_H
+#define COMPRESSED_SURF_H
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "encoder_factory.hpp"
+#include "surf.hpp"
+
+namespace hope {
+
+// A SuRF filter over HOPE-encoded keys. Queries take raw keys; the
+// encoder and the filter are built, serialized and freed together.
+//
+// Encoded keys are rounded up to whole labels with zero padding, so two
+// keys may map to the same encoded string. An exclusive bound cannot be
+// told apart from a stored key that encodes like it, so range queries
+// take no inclusive flags: the encoded bounds are always inclusive. A
+// filter may return false positives, never false negatives.
+//
+// With label_bits = surf::kNibbleLabelBits, the encoded bit stream is
+// split into 4-bit labels (one per key byte) and the trie stores two
+// labels per byte. This avoids padding every trie level to a byte and
+// shrinks the filter when codes are short; real suffixes then carry
+// only 4 useful bits per key byte.
+class CompressedSuRF {
+ public:
+  //------------------------------------------------------------------
+  // Input keys must be SORTED. The encoder is built on every
+  // (100 / sample_percent)-th key
+  //------------------------------------------------------------------
+  CompressedSuRF(const std::vector<std::string> &keys, const int encoder_type,
+                 const int64_t dict_size_limit, const int sample_percent,
+                 const surf::SuffixType suffix_type = surf::kNone,
+                 const surf::level_t hash_suffix_len = 0, const surf::level_t real_suffix_len = 0,
+                 const int W = 10000, const surf::level_t label_bits = surf::kByteLabelBits);
+
+  ~CompressedSuRF();
+
+  bool lookupKey(const std::string &key) const { return filter_->lookupKey(encodeKey(key)); }
+  // The iterator walks the encoded keys, starting at the first one
+  // greater than or equal to encodeKey(key)
+  surf::SuRF::Iter moveToKeyGreaterThan(const std::string &key) const;
+  // May any key lie in [left_key, right_key]?
+  bool lookupRange(const std::string &left_key, const std::string &right_key) const;
+  // Estimated number of keys in [left_key, right_key]. A stored key may
+  // encode like a bound, so the bounds are one wider on each side than
+  // those of surf::SuRF::approxCount
+  surf::CountEstimate approxCount(const std::string &left_key, const std::string &right_key) const;
+
+  std::string encodeKey(const std::string &key) const;
+
+  uint64_t serializedSize() const;
+  uint64_t getMemoryUsage() const;
+  const Encoder *getEncoder() const { return encoder_; }
+  const surf::SuRF *getFilter() const { return filter_; }
+
+  // The encoder is stored as its symbol -> code table; deSerialize
+  // rebuilds the lookup structure from it without sampling keys again
+  char *serialize() const;
+  // As with surf::SuRF, the filter points into src, which must
+  // outlive the returned object. Returns nullptr if the encoder
+  // cannot be rebuilt from the stored table
+  static CompressedSuRF *deSerialize(char *src);
+
+ private:
+  CompressedSuRF() : encoder_(nullptr), filter_(nullptr), is_deserialized_(false) {}
+
+  uint64_t headerSize(const std::vector<SymbolCode> &symbol_code_list) const;
+
+  int encoder_type_;
+  int W_;
+  surf::level_t label_bits_;
+  Encoder *encoder_;
+  surf::SuRF *filter_;
+  bool is_deserialized_;
+};
+
+CompressedSuRF::CompressedSuRF(const std::vector<std::string> &keys, const int encoder_type,
+                               const int64_t dict_size_limit, const int sample_percent,
+                               const surf::SuffixType suffix_type,
+                               const surf::level_t hash_suffix_len, const surf::level_t real_suffix_len,
+                               const int W, const surf::level_t label_bits)
+    : encoder_type_(encoder_type),
+      W_(W),
+      label_bits_(label_bits),
+      is_deserialized_(false) {
+  std::vector<std::string> sample_keys;
+  int stride = sample_percent > 0 && sample_percent < 100 ? 100 / sample_percent : 1;
+  for (int i = 0; i < (int)keys.size(); i += stride) {
+    sample_keys.push_back(keys[i]);
+  }
+  encoder_ = EncoderFactory::createEncoder(encoder_type_, W_);
+  encoder_->build(sample_keys, dict_size_limit);
+
+  std::vector<std::string> enc_keys;
+  for (int i = 0; i < (int)keys.size(); i++) {
+    enc_keys.push_back(encodeKey(keys[i]));
+  }
+  filter_ = new surf::SuRF(enc_keys, surf::kIncludeDense, surf::kSparseDenseRatio,
+                           suffix_type, hash_suffix_len, real_suffix_len, label_bits_);
+}
+
+CompressedSuRF::~CompressedSuRF() {
+  if (filter_ != nullptr && !is_deserialized_) filter_->destroy();
+  delete filter_;
+  delete encoder_;
+}
+
+std::string CompressedSuRF::encodeKey(const std::string &key) const {
+  int bit_len = encoder_->encodedBitLen(key);
+  std::string enc_key((bit_len + 7) >> 3, '\0');
+  encoder_->encodeInto(key, (uint8_t *)&enc_key[0], (int)enc_key.size());
+  if (label_bits_ == surf::kByteLabelBits) return enc_key;
+  std::string nibbles((bit_len + 3) >> 2, '\0');
+  for (size_t i = 0; i < nibbles.size(); i++) {
+    nibbles[i] = (char)(((uint8_t)enc_key[i >> 1] >> ((~i & 1) << 2)) & 0xF);
+  }
+  return nibbles;
+}
+
+surf::SuRF::Iter CompressedSuRF::moveToKeyGreaterThan(const std::string &key) const {
+  return filter_->moveToKeyGreaterThan(encodeKey(key), true);
+}
+
+bool CompressedSuRF::lookupRange(const std::string &left_key, const std::string &right_key) const {
+  return filter_->lookupRange(encodeKey(left_key), true, encodeKey(right_key), true);
+}
+
+surf::CountEstimate CompressedSuRF::approxCount(const std::string &left_key, const std::string &right_key) const {
+  surf::CountEstimate estimate = filter_->approxCount(encodeKey(left_key), encodeKey(right_key));
+  if (estimate.lower > 0) estimate.lower--;
+  estimate.upper++;
+  return estimate;
+}
+
+uint64_t CompressedSuRF::headerSize(const std::vector<SymbolCode> &symbol_code_list) const {
+  uint64_t size = sizeof(encoder_type_) + sizeof(W_) + sizeof(label_bits_) + sizeof(uint64_t);
+  for (int i = 0; i < (int)symbol_code_list.size(); i++) {
+    size += sizeof(uint32_t) + symbol_code_list[i].first.length() + sizeof(symbol_code_list[i].second.code) +
+            sizeof(symbol_code_list[i].second.len);
+  }
+  surf::sizeAlign(size);
+  return size;
+}
+
+uint64_t CompressedSuRF::serializedSize() const {
+  std::vector<SymbolCode> symbol_code_list;
+  encoder_->getSymbolCodes(&symbol_code_list);
+  return headerSize(symbol_code_list) + filter_->serializedSize();
+}
+
+uint64_t CompressedSuRF::getMemoryUsage() const {
+  return sizeof(CompressedSuRF) + filter_->getMemoryUsage() + encoder_->memoryUse();
+}
+
+char *CompressedSuRF::serialize() const {
+  std::vector<SymbolCode> symbol_code_list;
+  encoder_->getSymbolCodes(&symbol_code_list);
+  uint64_t size = headerSize(symbol_code_list) + filter_->serializedSize();
+  char *data = new char[size];
+  char *cur_data = data;
+  memcpy(cur_data, &encoder_type_, sizeof(encoder_type_));
+  cur_data += sizeof(encoder_type_);
+  memcpy(cur_data, &W_, sizeof(W_));
+  cur_data += sizeof(W_);
+  memcpy(cur_data, &label_bits_, sizeof(label_bits_));
+  cur_data += sizeof(label_bits_);
+  uint64_t num_codes = symbol_code_list.size();
+  memcpy(cur_data, &num_codes, sizeof(num_codes));
+  cur_data += sizeof(num_codes);
+  for (int i = 0; i < (int)num_codes; i++) {
+    const std::string &symbol = symbol_code_list[i].first;
+    const Code &code = symbol_code_list[i].second;
+    uint32_t symbol_len = (uint32_t)symbol.length();
+    memcpy(cur_data, &symbol_len, sizeof(symbol_len));
+    cur_data += sizeof(symbol_len);
+    memcpy(cur_data, symbol.data(), symbol_len);
+    cur_data += symbol_len;
+    memcpy(cur_data, &code.code, sizeof(code.code));
+    cur_data += sizeof(code.code);
+    memcpy(cur_data, &code.len, sizeof(code.len));
+    cur_data += sizeof(code.len);
+  }
+  surf::align(cur_data);
+
+  char *filter_data = filter_->serialize();
+  uint64_t filter_size = filter_->serializedSize();
+  memcpy(cur_data, filter_data, filter_size);
+  cur_data += filter_size;
+  delete[] filter_data;
+  assert(cur_data - data == (int64_t)size);
+  return data;
+}
+
+CompressedSuRF *CompressedSuRF::deSerialize(char *src) {
+  CompressedSuRF *compressed_surf = new CompressedSuRF();
+  memcpy(&(compressed_surf->encoder_type_), src, sizeof(compressed_surf->encoder_type_));
+  src += sizeof(compressed_surf->encoder_type_);
+  memcpy(&(compressed_surf->W_), src, sizeof(compressed_surf->W_));
+  src += sizeof(compressed_surf->W_);
+  memcpy(&(compressed_surf->label_bits_), src, sizeof(compressed_surf->label_bits_));
+  src += sizeof(compressed_surf->label_bits_);
+  uint64_t num_codes = 0;
+  memcpy(&num_codes, src, sizeof(num_codes));
+  src += sizeof(num_codes);
+  std::vector<SymbolCode> symbol_code_list;
+  for (uint64_t i = 0; i < num_codes; i++) {
+    uint32_t symbol_len = 0;
+    memcpy(&symbol_len, src, sizeof(symbol_len));
+    src += sizeof(symbol_len);
+    std::string symbol(src, symbol_len);
+    src += symbol_len;
+    Code code;
+    memcpy(&code.code, src, sizeof(code.code));
+    src += sizeof(code.code);
+    memcpy(&code.len, src, sizeof(code.len));
+    src += sizeof(code.len);
+    symbol_code_list.push_back(std::make_pair(symbol, code));
+  }
+  surf::align(src);
+
+  compressed_surf->encoder_ = EncoderFactory::createEncoder(compressed_surf->encoder_type_, compressed_surf->W_);
+  if (compressed_surf->encoder_ == nullptr || !compressed_surf->encoder_->buildFromCodes(symbol_code_list)) {
+    delete compressed_surf;
+    return nullptr;
+  }
+  compressed_surf->filter_ = surf::SuRF::deSerialize(src);
+  compressed_surf->is_deserialized_ = true;
+  return compressed_surf;
+}
+
+}  // namespace hope
+
+#endif  // COMPRESSED_SURF_H
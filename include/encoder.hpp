@@ -2,11 +2,125 @@
 #define ENCODER_H
 
 #include <assert.h>
+#include <string.h>
 #include <string>
 #include <vector>
 
+#include "symbol_selector.hpp"
+
 namespace hope {
 
+// Appends codes to caller memory (e.g., an index node) without
+// writing past capacity bytes. Unlike the word buffers in encode,
+// dst needs no alignment or slack after the last byte.
+class BoundedCodeWriter {
+ public:
+  BoundedCodeWriter() : BoundedCodeWriter(nullptr, 0) {}
+
+  BoundedCodeWriter(uint8_t *dst, const int capacity)
+      : dst_(dst), capacity_(capacity), pos_(0), acc_(0), acc_len_(0) {}
+
+  // Restarts at dst with the codes written so far by prefix
+  // (used by batch encoding to share a common prefix)
+  void resume(uint8_t *dst, const int capacity, const BoundedCodeWriter &prefix) {
+    dst_ = dst;
+    capacity_ = capacity;
+    pos_ = prefix.pos_;
+    acc_ = prefix.acc_;
+    acc_len_ = prefix.acc_len_;
+    memcpy(dst_, prefix.dst_, pos_);
+  }
+
+  // Returns false if the code does not fit.
+  // Bits are collected in acc_ and stored one full 64-bit word at a
+  // time; every stored byte is then part of the code, so nothing past
+  // (bit_len + 7) / 8 bytes is ever written
+  inline bool append(const int64_t s_buf, const int s_len) {
+    if (s_len > 56) {
+      return appendBits((uint64_t)s_buf >> 32, s_len - 32) && appendBits(s_buf & 0xFFFFFFFF, 32);
+    }
+    return appendBits(s_buf, s_len);
+  }
+
+  // Flushes the last partial word byte by byte; returns the bit length or -1
+  inline int finish() {
+    int num_bytes = (acc_len_ + 7) >> 3;
+    if (pos_ + num_bytes > capacity_) return -1;
+    if (acc_len_ > 0) {
+      uint64_t out = acc_ << (64 - acc_len_);
+      for (int i = 0; i < num_bytes; i++) {
+        dst_[pos_ + i] = (uint8_t)(out >> (56 - 8 * i));
+      }
+    }
+    return (pos_ << 3) + acc_len_;
+  }
+
+ private:
+  // s_len <= 56 and acc_ holds fewer than 64 pending bits
+  inline bool appendBits(const uint64_t s_buf, const int s_len) {
+    if (acc_len_ + s_len < 64) {
+      acc_ = (acc_ << s_len) | s_buf;
+      acc_len_ += s_len;
+      return true;
+    }
+    // the word is complete, and acc_len_ >= 8 here
+    int rest = acc_len_ + s_len - 64;
+    if (pos_ + 8 > capacity_) return false;
+    uint64_t out = __builtin_bswap64((acc_ << (64 - acc_len_)) | (s_buf >> rest));
+    memcpy(dst_ + pos_, &out, 8);
+    pos_ += 8;
+    acc_ = s_buf;
+    acc_len_ = rest;
+    return true;
+  }
+
+  uint8_t *dst_;
+  int capacity_;
+  int pos_;
+  uint64_t acc_;
+  int acc_len_;
+};
+
+// Appends codes to the 64-bit word buffer of encode: writes whole
+// words only, i.e., 8 * (bit_len / 64 + 1) bytes, and never fails
+class WordCodeWriter {
+ public:
+  explicit WordCodeWriter(uint8_t *buffer)
+      : int_buf_((int64_t *)buffer), idx_(0), int_buf_len_(0) {
+    int_buf_[0] = 0;
+  }
+
+  // s_len <= 63
+  inline bool append(const int64_t s_buf, const int s_len) {
+    if (int_buf_len_ + s_len > 63) {
+      int num_bits_left = 64 - int_buf_len_;
+      int_buf_len_ = s_len - num_bits_left;
+      int_buf_[idx_] <<= num_bits_left;
+      int_buf_[idx_] |= (s_buf >> int_buf_len_);
+      int_buf_[idx_] = __builtin_bswap64(int_buf_[idx_]);
+      int_buf_[idx_ + 1] = s_buf;
+      idx_++;
+    } else {
+      int_buf_[idx_] <<= s_len;
+      int_buf_[idx_] |= s_buf;
+      int_buf_len_ += s_len;
+    }
+    return true;
+  }
+
+  // Returns the bit length
+  inline int finish() {
+    int_buf_[idx_] <<= (64 - int_buf_len_);
+    int_buf_[idx_] = __builtin_bswap64(int_buf_[idx_]);
+    return (idx_ << 6) + int_buf_len_;
+  }
+
+ private:
+  int64_t *int_buf_;
+  int idx_;
+  int int_buf_len_;
+};
+
 class Encoder {
  public:
   virtual ~Encoder(){};
@@ -14,19 +128,89 @@ class Encoder {
   virtual bool build(const std::vector<std::string> &key_list,
 		     const int64_t dict_size_limit) = 0;
 
-  virtual int encode(const std::string &key, uint8_t *buffer) const = 0;
+  // Build with a caller-owned symbol selector, which may already
+  // hold statistics accumulated through countKey (see EncoderBuilder)
+  virtual bool build(SymbolSelector *symbol_selector,
+		     const std::vector<std::string> &key_list,
+		     const int64_t dict_size_limit) = 0;
+
+  // Build on keys that are not std::strings (e.g., packed in a page).
+  // Selectors that count keys incrementally never copy them; the
+  // others copy the slices into a sample first
+  bool build(const KeySlice *keys, const int num_keys,
+	     const int64_t dict_size_limit) {
+    SymbolSelector *symbol_selector = createSymbolSelector();
+    std::vector<std::string> key_list;
+    symbol_selector->countKeys(keys, num_keys, &key_list);
+    bool ret_val = build(symbol_selector, key_list, dict_size_limit);
+    delete symbol_selector;
+    return ret_val;
+  }
+
+  // The selector build uses when the caller does not pass one
+  virtual SymbolSelector *createSymbolSelector() const = 0;
+
+  // The symbol -> code table chosen by build. buildFromCodes restores
+  // an encoder of the same type from it without keys or symbol
+  // selection (e.g., when a serialized filter is opened)
+  virtual void getSymbolCodes(std::vector<SymbolCode> *symbol_code_list) const = 0;
+
+  virtual bool buildFromCodes(const std::vector<SymbolCode> &symbol_code_list) = 0;
+
+  int encode(const std::string &key, uint8_t *buffer) const {
+    return encode(key.data(), (int)key.length(), buffer);
+  }
+
+  virtual int encode(const char *key, const int key_len, uint8_t *buffer) const = 0;
+
+  // Exact number of bits encode produces, computed from the code
+  // lengths only (nothing is written)
+  int encodedBitLen(const std::string &key) const {
+    return encodedBitLen(key.data(), (int)key.length());
+  }
+
+  virtual int encodedBitLen(const char *key, const int key_len) const = 0;
+
+  // Writes exactly (bit_len + 7) / 8 bytes to dst and returns bit_len,
+  // or returns -1 (dst content undefined) if they exceed capacity.
+  // encode instead writes whole 64-bit words and needs a scratch buffer.
+  int encodeInto(const std::string &key, uint8_t *dst, const int capacity) const {
+    return encodeInto(key.data(), (int)key.length(), dst, capacity);
+  }
+
+  virtual int encodeInto(const char *key, const int key_len,
+			 uint8_t *dst, const int capacity) const = 0;
 
   // Encode a pair of keys at the same time
-  virtual void encodePair(const std::string &l_key, const std::string &r_key,
+  void encodePair(const std::string &l_key, const std::string &r_key,
+		  uint8_t *l_buffer, uint8_t *r_buffer,
+		  int &l_enc_len, int &r_enc_len) const {
+    encodePair(l_key.data(), (int)l_key.length(), r_key.data(), (int)r_key.length(),
+	       l_buffer, r_buffer, l_enc_len, r_enc_len);
+  }
+
+  virtual void encodePair(const char *l_key, const int l_key_len,
+			  const char *r_key, const int r_key_len,
 			  uint8_t *l_buffer, uint8_t *r_buffer,
                           int &l_enc_len, int &r_enc_len) const = 0;
 
   // Encode a batch of keys
   // The algorithm is faster than encoding the keys individually
   // because the common prefixes of the keys are only encoded once
-  virtual int64_t encodeBatch(const std::vector<std::string> &ori_keys,
-			      int start_id, int batch_size,
-                              std::vector<std::string> &enc_keys) = 0;
+  int64_t encodeBatch(const std::vector<std::string> &ori_keys,
+		      int start_id, int batch_size,
+		      std::vector<std::string> &enc_keys) {
+    int end_id = (int)ori_keys.size() < (start_id + batch_size) ? (int)ori_keys.size()
+					: (start_id + batch_size);
+    std::vector<KeySlice> keys;
+    for (int i = start_id; i < end_id; i++) {
+      keys.push_back({ori_keys[i].data(), (int)ori_keys[i].length()});
+    }
+    return encodeBatch(keys.data(), (int)keys.size(), enc_keys);
+  }
+
+  virtual int64_t encodeBatch(const KeySlice *keys, const int num_keys,
+			      std::vector<std::string> &enc_keys) = 0;
 
   virtual int decode(const std::string &enc_key,
 		     const int bit_len, uint8_t *buffer) const = 0;
@@ -13,18 +13,31 @@ namespace hope {
 class ALMImprovedEncoder : public Encoder {
  public:
   static const int kCaType = 0;
-  ALMImprovedEncoder(int _W = 10000) { W = _W; };
+  ALMImprovedEncoder(int _W = 10000) : dict_(nullptr) { W = _W; };
 
   ~ALMImprovedEncoder() { delete dict_; };
 
   bool build(const std::vector<std::string> &key_list, const int64_t dict_size_limit);
-  int encode(const std::string &key, uint8_t *buffer) const;
-
-  void encodePair(const std::string &l_key, const std::string &r_key,
+  bool build(SymbolSelector *symbol_selector, const std::vector<std::string> &key_list,
+	     const int64_t dict_size_limit);
+  using Encoder::build;
+  SymbolSelector *createSymbolSelector() const {
+    return SymbolSelectorFactory::createSymbolSelector(6);
+  }
+  using Encoder::encode;
+  int encode(const char *key, const int key_len, uint8_t *buffer) const;
+  using Encoder::encodedBitLen;
+  int encodedBitLen(const char *key, const int key_len) const;
+  using Encoder::encodeInto;
+  int encodeInto(const char *key, const int key_len, uint8_t *dst, const int capacity) const;
+
+  using Encoder::encodePair;
+  void encodePair(const char *l_key, const int l_key_len,
+		  const char *r_key, const int r_key_len,
 		  uint8_t *l_buffer, uint8_t *r_buffer,
                   int &l_enc_len, int &r_enc_len) const;
-  int64_t encodeBatch(const std::vector<std::string> &ori_keys,
-		      int start_id, int batch_size,
+  using Encoder::encodeBatch;
+  int64_t encodeBatch(const KeySlice *keys, const int num_keys,
                       std::vector<std::string> &enc_keys);
 
   int decode(const std::string &enc_key, const int bit_len, uint8_t *buffer) const;
@@ -32,6 +45,9 @@ class ALMImprovedEncoder : public Encoder {
   int numEntries() const;
   int64_t memoryUse() const;
 
+  void getSymbolCodes(std::vector<SymbolCode> *symbol_code_list) const;
+  bool buildFromCodes(const std::vector<SymbolCode> &symbol_code_list);
+
   std::vector<SymbolCode> getSymbolCodeList(); // for test
 
  private:
@@ -46,11 +62,19 @@ std::vector<SymbolCode> ALMImprovedEncoder::getSymbolCodeList() { return symbol_
 
 bool ALMImprovedEncoder::build(const std::vector<std::string> &key_list,
 			       const int64_t dict_size_limit) {
+  SymbolSelector *symbol_selector = createSymbolSelector();
+  bool ret_val = build(symbol_selector, key_list, dict_size_limit);
+  delete symbol_selector;
+  return ret_val;
+}
+
+bool ALMImprovedEncoder::build(SymbolSelector *symbol_selector,
+			       const std::vector<std::string> &key_list,
+			       const int64_t dict_size_limit) {
   double cur_time = 0;
   setStopWatch(cur_time, 6);
 
   std::vector<SymbolFreq> symbol_freq_list;
-  SymbolSelector *symbol_selector = SymbolSelectorFactory::createSymbolSelector(6);
   reinterpret_cast<ALMImprovedSS *>(symbol_selector)->setW(W);
   symbol_selector->selectSymbols(key_list, dict_size_limit, &symbol_freq_list);
   printElapsedTime(cur_time, 0);
@@ -59,25 +83,34 @@ bool ALMImprovedEncoder::build(const std::vector<std::string> &key_list,
   code_assigner->assignCodes(symbol_freq_list, &symbol_code_list);
   printElapsedTime(cur_time, 1);
 
-  dict_ = DictionaryFactory::createDictionary(5);
-  bool ret_val = dict_->build(symbol_code_list);
+  bool ret_val = buildFromCodes(symbol_code_list);
   printElapsedTime(cur_time, 2);
 
-  delete symbol_selector;
   delete code_assigner;
   return ret_val;
 }
 
-int ALMImprovedEncoder::encode(const std::string &key, uint8_t *buffer) const {
+void ALMImprovedEncoder::getSymbolCodes(std::vector<SymbolCode> *symbol_code_list) const {
+  symbol_code_list->insert(symbol_code_list->end(), this->symbol_code_list.begin(),
+			   this->symbol_code_list.end());
+}
+
+bool ALMImprovedEncoder::buildFromCodes(const std::vector<SymbolCode> &symbol_code_list) {
+  this->symbol_code_list = symbol_code_list;
+  delete dict_;
+  dict_ = DictionaryFactory::createDictionary(5);
+  return dict_->build(this->symbol_code_list);
+}
+
+int ALMImprovedEncoder::encode(const char *key, const int key_len, uint8_t *buffer) const {
   int64_t *int_buf = (int64_t *)buffer;
   int idx = 0;
   int_buf[0] = 0;
   int int_buf_len = 0;
-  const char *key_str = key.c_str();
   int pos = 0;
-  while (pos < (int)key.length()) {
+  while (pos < key_len) {
     int prefix_len = 0;
-    Code code = dict_->lookup(key_str + pos, key.size() - pos, prefix_len);
+    Code code = dict_->lookup(key + pos, key_len - pos, prefix_len);
     int64_t s_buf = code.code;
     int s_len = code.len;
     if (int_buf_len + s_len > 63) {
@@ -100,21 +133,45 @@ int ALMImprovedEncoder::encode(const std::string &key, uint8_t *buffer) const {
   return ((idx << 6) + int_buf_len);
 }
 
-void ALMImprovedEncoder::encodePair(const std::string &l_key, const std::string &r_key,
+int ALMImprovedEncoder::encodedBitLen(const char *key, const int key_len) const {
+  int bit_len = 0;
+  int pos = 0;
+  while (pos < key_len) {
+    int prefix_len = 0;
+    bit_len += dict_->lookup(key + pos, key_len - pos, prefix_len).len;
+    pos += prefix_len;
+  }
+  return bit_len;
+}
+
+int ALMImprovedEncoder::encodeInto(const char *key, const int key_len,
+                                   uint8_t *dst, const int capacity) const {
+  BoundedCodeWriter writer(dst, capacity);
+  int pos = 0;
+  while (pos < key_len) {
+    int prefix_len = 0;
+    Code code = dict_->lookup(key + pos, key_len - pos, prefix_len);
+    if (!writer.append(code.code, code.len)) return -1;
+    pos += prefix_len;
+  }
+  return writer.finish();
+}
+
+void ALMImprovedEncoder::encodePair(const char *l_key, const int l_key_len,
+				    const char *r_key, const int r_key_len,
 				    uint8_t *l_buffer, uint8_t *r_buffer,
 				    int &l_enc_len, int &r_enc_len) const {
-  l_enc_len = encode(l_key, l_buffer);
-  r_enc_len = encode(r_key, r_buffer);
+  l_enc_len = encode(l_key, l_key_len, l_buffer);
+  r_enc_len = encode(r_key, r_key_len, r_buffer);
   return;
 }
 
-int64_t ALMImprovedEncoder::encodeBatch(const std::vector<std::string> &ori_keys,
-					int start_id, int batch_size,
+int64_t ALMImprovedEncoder::encodeBatch(const KeySlice *keys, const int num_keys,
                                         std::vector<std::string> &enc_keys) {
   uint8_t key_buffer[8192];
   int64_t batch_code_size = 0;
-  for (int i = 0; i < batch_size; i++) {
-    int enc_len = GetByteLen(encode(ori_keys[start_id + i], key_buffer));
+  for (int i = 0; i < num_keys; i++) {
+    int enc_len = GetByteLen(encode(keys[i].data, keys[i].len, key_buffer));
 #ifndef BATCH_DRY_ENCODE
     enc_keys.push_back(std::string((const char *)key_buffer, enc_len));
 #endif
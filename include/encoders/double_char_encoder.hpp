@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <vector>
+
 #include "code_assigner_factory.hpp"
 #include "encoder.hpp"
 #include "sbt.hpp"
@@ -18,13 +20,26 @@ class DoubleCharEncoder : public Encoder {
   ~DoubleCharEncoder() = default;
 
   bool build(const std::vector<std::string> &key_list, const int64_t dict_size_limit);
-  int encode(const std::string &key, uint8_t *buffer) const;
-
-  void encodePair(const std::string &l_key, const std::string &r_key,
+  bool build(SymbolSelector *symbol_selector, const std::vector<std::string> &key_list,
+	     const int64_t dict_size_limit);
+  using Encoder::build;
+  SymbolSelector *createSymbolSelector() const {
+    return SymbolSelectorFactory::createSymbolSelector(2);
+  }
+  using Encoder::encode;
+  int encode(const char *key, const int key_len, uint8_t *buffer) const;
+  using Encoder::encodedBitLen;
+  int encodedBitLen(const char *key, const int key_len) const;
+  using Encoder::encodeInto;
+  int encodeInto(const char *key, const int key_len, uint8_t *dst, const int capacity) const;
+
+  using Encoder::encodePair;
+  void encodePair(const char *l_key, const int l_key_len,
+		  const char *r_key, const int r_key_len,
 		  uint8_t *l_buffer, uint8_t *r_buffer,
                   int &l_enc_len, int &r_enc_len) const;
-  int64_t encodeBatch(const std::vector<std::string> &ori_keys,
-		      int start_id, int batch_size,
+  using Encoder::encodeBatch;
+  int64_t encodeBatch(const KeySlice *keys, const int num_keys,
                       std::vector<std::string> &enc_keys);
 
   int decode(const std::string &enc_key, const int bit_len, uint8_t *buffer) const;
@@ -32,20 +47,38 @@ class DoubleCharEncoder : public Encoder {
   int numEntries() const;
   int64_t memoryUse() const;
 
+  void getSymbolCodes(std::vector<SymbolCode> *symbol_code_list) const;
+  bool buildFromCodes(const std::vector<SymbolCode> &symbol_code_list);
+
  private:
-  bool buildDict(const std::vector<SymbolCode> &symbol_code_list);
+  // Codes of up to kMaxPackedLen bits are stored inline;
+  // longer ones (rare) are escaped into long_codes_
+  static const int kMaxPackedLen = 24;
+  static const uint32_t kLongCodeTag = 0xFF;
 
-  Code dict_[kNumDoubleChar];
+  inline Code lookup(const unsigned s_idx) const;
+
+  // (len << 24 | code): 256KB instead of 512KB for an array of Code
+  uint32_t dict_[kNumDoubleChar];
+  std::vector<Code> long_codes_;
   SBT *decode_dict_;
 };
 
 bool DoubleCharEncoder::build(const std::vector<std::string> &key_list,
 			      const int64_t dict_size_limit) {
+  SymbolSelector *symbol_selector = createSymbolSelector();
+  bool ret = build(symbol_selector, key_list, dict_size_limit);
+  delete symbol_selector;
+  return ret;
+}
+
+bool DoubleCharEncoder::build(SymbolSelector *symbol_selector,
+			      const std::vector<std::string> &key_list,
+			      const int64_t dict_size_limit) {
   double cur_time = 0;
   setStopWatch(cur_time, 2);
 
   std::vector<SymbolFreq> symbol_freq_list;
-  SymbolSelector *symbol_selector = SymbolSelectorFactory::createSymbolSelector(2);
   symbol_selector->selectSymbols(key_list, dict_size_limit, &symbol_freq_list);
   printElapsedTime(cur_time, 0);
 
@@ -54,25 +87,33 @@ bool DoubleCharEncoder::build(const std::vector<std::string> &key_list,
   code_assigner->assignCodes(symbol_freq_list, &symbol_code_list);
   printElapsedTime(cur_time, 1);
 
-  bool ret = buildDict(symbol_code_list);
+  bool ret = buildFromCodes(symbol_code_list);
   printElapsedTime(cur_time, 2);
 
-  delete symbol_selector;
   delete code_assigner;
   return ret;
 }
 
-int DoubleCharEncoder::encode(const std::string &key, uint8_t *buffer) const {
+Code DoubleCharEncoder::lookup(const unsigned s_idx) const {
+  uint32_t entry = dict_[s_idx];
+  if ((entry >> 24) == kLongCodeTag) return long_codes_[entry & 0xFFFFFF];
+  Code code;
+  code.code = entry & 0xFFFFFF;
+  code.len = entry >> 24;
+  return code;
+}
+
+int DoubleCharEncoder::encode(const char *key, const int key_len, uint8_t *buffer) const {
   int64_t *int_buf = (int64_t *)buffer;
   int idx = 0;
   int_buf[0] = 0;
   int int_buf_len = 0;
-  int key_len = (int)key.length();
   for (int i = 0; i < key_len; i += 2) {
     unsigned s_idx = 256 * (uint8_t)key[i];
     if (i + 1 < key_len) s_idx += (uint8_t)key[i + 1];
-    int64_t s_buf = dict_[s_idx].code;
-    int s_len = dict_[s_idx].len;
+    Code code = lookup(s_idx);
+    int64_t s_buf = code.code;
+    int s_len = code.len;
     if (int_buf_len + s_len > 63) {
       int num_bits_left = 64 - int_buf_len;
       int_buf_len = s_len - num_bits_left;
@@ -92,7 +133,30 @@ int DoubleCharEncoder::encode(const std::string &key, uint8_t *buffer) const {
   return ((idx << 6) + int_buf_len);
 }
 
-void DoubleCharEncoder::encodePair(const std::string &l_key, const std::string &r_key,
+int DoubleCharEncoder::encodedBitLen(const char *key, const int key_len) const {
+  int bit_len = 0;
+  for (int i = 0; i < key_len; i += 2) {
+    unsigned s_idx = 256 * (uint8_t)key[i];
+    if (i + 1 < key_len) s_idx += (uint8_t)key[i + 1];
+    bit_len += lookup(s_idx).len;
+  }
+  return bit_len;
+}
+
+int DoubleCharEncoder::encodeInto(const char *key, const int key_len,
+				  uint8_t *dst, const int capacity) const {
+  BoundedCodeWriter writer(dst, capacity);
+  for (int i = 0; i < key_len; i += 2) {
+    unsigned s_idx = 256 * (uint8_t)key[i];
+    if (i + 1 < key_len) s_idx += (uint8_t)key[i + 1];
+    Code code = lookup(s_idx);
+    if (!writer.append(code.code, code.len)) return -1;
+  }
+  return writer.finish();
+}
+
+void DoubleCharEncoder::encodePair(const char *l_key, const int key_len_l,
+				   const char *r_key, const int key_len_r,
 				   uint8_t *l_buffer, uint8_t *r_buffer,
 				   int &l_enc_len, int &r_enc_len) const {
   int64_t *int_buf_l = (int64_t *)l_buffer;
@@ -100,8 +164,6 @@ void DoubleCharEncoder::encodePair(const std::string &l_key, const std::string &
   int idx_l = 0, idx_r = 0;
   int_buf_l[0] = 0;
   int int_buf_len_l = 0, int_buf_len_r = 0;
-  int key_len_l = (int)l_key.length();
-  int key_len_r = (int)r_key.length();
   bool found_mismatch = false;
   int r_start_pos = 0;
   for (int i = 0; i < key_len_l; i += 2) {
@@ -109,7 +171,8 @@ void DoubleCharEncoder::encodePair(const std::string &l_key, const std::string &
     if (i + 1 < key_len_l) s_idx += (uint8_t)l_key[i + 1];
 
     if (!found_mismatch) {
-      unsigned s_idx_r = 256 * (uint8_t)r_key[i];
+      unsigned s_idx_r = 0;
+      if (i < key_len_r) s_idx_r = 256 * (uint8_t)r_key[i];
       if (i + 1 < key_len_r) s_idx_r += (uint8_t)r_key[i + 1];
 
       if (s_idx < s_idx_r) {
@@ -120,8 +183,9 @@ void DoubleCharEncoder::encodePair(const std::string &l_key, const std::string &
         found_mismatch = true;
       }
     }
-    int64_t s_buf = dict_[s_idx].code;
-    int s_len = dict_[s_idx].len;
+    Code code = lookup(s_idx);
+    int64_t s_buf = code.code;
+    int s_len = code.len;
     if (int_buf_len_l + s_len > 63) {
       int num_bits_left = 64 - int_buf_len_l;
       int_buf_len_l = s_len - num_bits_left;
@@ -145,8 +209,9 @@ void DoubleCharEncoder::encodePair(const std::string &l_key, const std::string &
     unsigned s_idx = 256 * (uint8_t)r_key[i];
     if (i + 1 < key_len_r) s_idx += (uint8_t)r_key[i + 1];
 
-    int64_t s_buf = dict_[s_idx].code;
-    int s_len = dict_[s_idx].len;
+    Code code = lookup(s_idx);
+    int64_t s_buf = code.code;
+    int s_len = code.len;
     if (int_buf_len_r + s_len > 63) {
       int num_bits_left = 64 - int_buf_len_r;
       int_buf_len_r = s_len - num_bits_left;
@@ -166,29 +231,28 @@ void DoubleCharEncoder::encodePair(const std::string &l_key, const std::string &
   r_enc_len = (idx_r << 6) + int_buf_len_r;
 }
 
-int64_t DoubleCharEncoder::encodeBatch(const std::vector<std::string> &ori_keys,
-				       int start_id, int batch_size,
+int64_t DoubleCharEncoder::encodeBatch(const KeySlice *keys, const int num_keys,
                                        std::vector<std::string> &enc_keys) {
   int64_t batch_code_size = 0;
-  int end_id = start_id + batch_size;
+  if (num_keys <= 0) return 0;
 
   // Get batch common prefix
-  int cp_len = 0;
-  std::string start_string = ori_keys[start_id];
-  int last_len = start_string.length();
-  for (int i = start_id + 1; i < end_id; i++) {
-    const auto &cur_key = ori_keys[i];
+  const char *start_string = keys[0].data;
+  int cp_len = keys[0].len;
+  for (int i = 1; i < num_keys; i++) {
+    const char *cur_key = keys[i].data;
+    int last_len = cp_len < keys[i].len ? cp_len : keys[i].len;
     cp_len = 0;
-    while ((cp_len < last_len) && *(int *)(cur_key.c_str() + cp_len) == *(int *)(start_string.c_str() + cp_len)) {
+    while ((cp_len + 4 <= last_len) && *(int *)(cur_key + cp_len) == *(int *)(start_string + cp_len)) {
       cp_len += 4;
     }
     while (cp_len < last_len && cur_key[cp_len] == start_string[cp_len]) cp_len++;
-    last_len = cp_len;
   }
 
   uint8_t buffer[8192];
   int64_t *int_buf = (int64_t *)buffer;
   int idx = 0;
+  int_buf[0] = 0;
   int int_buf_len = 0;
   // Encode common prefix
   int cp_pos = 0;
@@ -198,8 +262,9 @@ int64_t DoubleCharEncoder::encodeBatch(const std::vector<std::string> &ori_keys,
   while (cp_pos + 2 <= cp_len) {
     unsigned s_idx = 256 * (uint8_t)start_string[cp_pos];
     s_idx += (uint8_t)start_string[cp_pos + 1];
-    s_buf = dict_[s_idx].code;
-    s_len = dict_[s_idx].len;
+    Code code = lookup(s_idx);
+    s_buf = code.code;
+    s_len = code.len;
     if (int_buf_len + s_len > 63) {
       num_bits_left = 64 - int_buf_len;
       int_buf_len = s_len - num_bits_left;
@@ -219,16 +284,19 @@ int64_t DoubleCharEncoder::encodeBatch(const std::vector<std::string> &ori_keys,
   // Encode left part
   uint8_t key_buffer[8192];
   int64_t *int_key_buf = (int64_t *)key_buffer;
-  for (int i = start_id; i < end_id; i++) {
+  for (int i = 0; i < num_keys; i++) {
     int int_key_len = int_buf_len;
     int key_idx = idx;
     memcpy(key_buffer, buffer, 8 * (idx + 1));
-    const auto &cur_key = ori_keys[i];
+    const char *cur_key = keys[i].data;
+    int cur_key_len = keys[i].len;
     int pos = cp_pos;
-    while (pos < (int)cur_key.length()) {
-      unsigned s_idx = 256 * (uint8_t)cur_key[pos] + (uint8_t)cur_key[pos + 1];
-      int64_t s_buf = dict_[s_idx].code;
-      int s_len = dict_[s_idx].len;
+    while (pos < cur_key_len) {
+      unsigned s_idx = 256 * (uint8_t)cur_key[pos];
+      if (pos + 1 < cur_key_len) s_idx += (uint8_t)cur_key[pos + 1];
+      Code code = lookup(s_idx);
+      int64_t s_buf = code.code;
+      int s_len = code.len;
       if (int_key_len + s_len > 63) {
         int num_bits_left = 64 - int_key_len;
         int_key_len = s_len - num_bits_left;
@@ -286,22 +354,37 @@ int DoubleCharEncoder::numEntries() const { return kNumDoubleChar; }
 
 int64_t DoubleCharEncoder::memoryUse() const {
 #ifdef INCLUDE_DECODE
-  return sizeof(Code) * kNumDoubleChar + decode_dict_->memory();
+  return sizeof(uint32_t) * kNumDoubleChar + sizeof(Code) * long_codes_.size()
+         + decode_dict_->memory();
 #else
-  return sizeof(Code) * kNumDoubleChar;
+  return sizeof(uint32_t) * kNumDoubleChar + sizeof(Code) * long_codes_.size();
 #endif
 }
 
-bool DoubleCharEncoder::buildDict(const std::vector<SymbolCode> &symbol_code_list) {
+void DoubleCharEncoder::getSymbolCodes(std::vector<SymbolCode> *symbol_code_list) const {
+  for (int i = 0; i < kNumDoubleChar; i++) {
+    char symbol[2] = {(char)(i >> 8), (char)(i & 0xFF)};
+    symbol_code_list->push_back(std::make_pair(std::string(symbol, 2), lookup(i)));
+  }
+}
+
+bool DoubleCharEncoder::buildFromCodes(const std::vector<SymbolCode> &symbol_code_list) {
   if (symbol_code_list.size() < kNumDoubleChar) return false;
+  long_codes_.clear();
   for (int i = 0; i < kNumDoubleChar; i++) {
-    dict_[i] = symbol_code_list[i].second;
+    Code code = symbol_code_list[i].second;
+    if (code.len <= kMaxPackedLen) {
+      dict_[i] = ((uint32_t)code.len << 24) | (uint32_t)code.code;
+    } else {
+      dict_[i] = (kLongCodeTag << 24) | (uint32_t)long_codes_.size();
+      long_codes_.push_back(code);
+    }
   }
 
 #ifdef INCLUDE_DECODE
   std::vector<Code> codes;
   for (int i = 0; i < kNumDoubleChar; i++) {
-    codes.push_back(dict_[i]);
+    codes.push_back(symbol_code_list[i].second);
   }
   decode_dict_ = new SBT(codes);
 #else
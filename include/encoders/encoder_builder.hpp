@@ -0,0 +1,84 @@
+#ifndef ENCODER_BUILDER_H
+#define ENCODER_BUILDER_H
+
+#include <random>
+
+#include "encoder_factory.hpp"
+#include "symbol_selector_factory.hpp"
+
+namespace hope {
+
+// Builds an encoder from a stream of keys (e.g., an index scan or an
+// SSTable iterator) without materializing the full key list.
+// Single-Char and Double-Char count their symbol statistics on all
+// keys seen; the n-gram selectors count ngrams on all keys but still
+// need a sample to compute the interval frequencies; ALM selectors
+// work on the sample only. The sample is a bounded reservoir.
+// A builder is single-use: call build() once after the last addKey().
+class EncoderBuilder {
+ public:
+  static const uint64_t kSeed = 0x5eed;
+
+  EncoderBuilder(const int encoder_type, const int64_t sample_size_limit, const int W = 10000);
+  ~EncoderBuilder() { delete symbol_selector_; }
+
+  void addKey(const std::string &key) { addKey(key.data(), (int)key.length()); }
+  void addKey(const char *key, const int key_len);
+
+  // Returns nullptr if the encoder fails to build
+  Encoder *build(const int64_t dict_size_limit);
+
+  int64_t numKeys() const { return num_keys_; }
+  const std::vector<std::string> &sample() const { return sample_; }
+
+ private:
+  void sampleKey(const char *key, const int key_len);
+
+  int encoder_type_;
+  int W_;
+  int64_t sample_size_limit_;
+  int64_t num_keys_;
+  bool keep_sample_;
+  SymbolSelector *symbol_selector_;
+  std::vector<std::string> sample_;
+  std::mt19937_64 gen_;
+};
+
+EncoderBuilder::EncoderBuilder(const int encoder_type, const int64_t sample_size_limit, const int W)
+    : encoder_type_(encoder_type), W_(W), sample_size_limit_(sample_size_limit), num_keys_(0), gen_(kSeed) {
+  // same default as EncoderFactory
+  if (encoder_type_ < 1 || encoder_type_ > 6) encoder_type_ = 2;
+  symbol_selector_ = SymbolSelectorFactory::createSymbolSelector(encoder_type_);
+  keep_sample_ = symbol_selector_->needsSample();
+}
+
+void EncoderBuilder::addKey(const char *key, const int key_len) {
+  num_keys_++;
+  bool counted = symbol_selector_->countKey(key, key_len);
+  if (!counted || keep_sample_) sampleKey(key, key_len);
+}
+
+// Reservoir sampling (Algorithm R): after n keys, each key is in
+// the sample with probability sample_size_limit_ / n
+void EncoderBuilder::sampleKey(const char *key, const int key_len) {
+  if ((int64_t)sample_.size() < sample_size_limit_) {
+    sample_.push_back(std::string(key, key_len));
+    return;
+  }
+  std::uniform_int_distribution<int64_t> dis(0, num_keys_ - 1);
+  int64_t pos = dis(gen_);
+  if (pos < sample_size_limit_) sample_[pos].assign(key, key_len);
+}
+
+Encoder *EncoderBuilder::build(const int64_t dict_size_limit) {
+  Encoder *encoder = EncoderFactory::createEncoder(encoder_type_, W_);
+  if (!encoder->build(symbol_selector_, sample_, dict_size_limit)) {
+    delete encoder;
+    return nullptr;
+  }
+  return encoder;
+}
+
+}  // namespace hope
+
+#endif  // ENCODER_BUILDER_H
@@ -12,17 +12,30 @@ namespace hope {
 class NGramEncoder : public Encoder {
  public:
   static const int kCaType = 0;
-  NGramEncoder(int n) : n_(n){};
+  NGramEncoder(int n) : n_(n), dict_(nullptr){};
   ~NGramEncoder() { delete dict_; };
 
   bool build(const std::vector<std::string> &key_list, const int64_t dict_size_limit);
-  int encode(const std::string &key, uint8_t *buffer) const;
+  bool build(SymbolSelector *symbol_selector, const std::vector<std::string> &key_list,
+	     const int64_t dict_size_limit);
+  using Encoder::build;
+  SymbolSelector *createSymbolSelector() const {
+    return SymbolSelectorFactory::createSymbolSelector(n_);
+  }
+  using Encoder::encode;
+  int encode(const char *key, const int key_len, uint8_t *buffer) const;
+  using Encoder::encodedBitLen;
+  int encodedBitLen(const char *key, const int key_len) const;
+  using Encoder::encodeInto;
+  int encodeInto(const char *key, const int key_len, uint8_t *dst, const int capacity) const;
 
-  void encodePair(const std::string &l_key, const std::string &r_key,
+  using Encoder::encodePair;
+  void encodePair(const char *l_key, const int l_key_len,
+		  const char *r_key, const int r_key_len,
 		  uint8_t *l_buffer, uint8_t *r_buffer,
                   int &l_enc_len, int &r_enc_len) const;
-  int64_t encodeBatch(const std::vector<std::string> &ori_keys,
-		      int start_id, int batch_size,
+  using Encoder::encodeBatch;
+  int64_t encodeBatch(const KeySlice *keys, const int num_keys,
                       std::vector<std::string> &enc_keys);
 
   int decode(const std::string &enc_key, const int bit_len, uint8_t *buffer) const;
@@ -30,49 +43,102 @@ class NGramEncoder : public Encoder {
   int numEntries() const;
   int64_t memoryUse() const;
 
+  void getSymbolCodes(std::vector<SymbolCode> *symbol_code_list) const;
+  bool buildFromCodes(const std::vector<SymbolCode> &symbol_code_list);
+
  private:
+  // Dictionary lookups read n_ + 1 bytes; near the end of the key
+  // the missing bytes are zero-padded
+  Code lookup(const char *key, const int key_len, const int pos, int &prefix_len) const;
+
   int n_;
   int code_len_; // -1 means variable length
   Dictionary *dict_;
+  // kept for getSymbolCodes, which the dictionaries cannot answer;
+  // packed (symbols of up to n_ + 1 bytes back to back) and counted
+  // in memoryUse
+  std::string symbols_;
+  std::vector<uint8_t> symbol_lens_;
+  std::vector<Code> codes_;
 };
 
 bool NGramEncoder::build(const std::vector<std::string> &key_list,
 			 const int64_t dict_size_limit) {
+  SymbolSelector *symbol_selector = createSymbolSelector();
+  bool ret_val = build(symbol_selector, key_list, dict_size_limit);
+  delete symbol_selector;
+  return ret_val;
+}
+
+bool NGramEncoder::build(SymbolSelector *symbol_selector,
+			 const std::vector<std::string> &key_list,
+			 const int64_t dict_size_limit) {
   double cur_time = 0;
   setStopWatch(cur_time, n_);
 
   std::vector<SymbolFreq> symbol_freq_list;
-  SymbolSelector *symbol_selector = SymbolSelectorFactory::createSymbolSelector(n_);
   symbol_selector->selectSymbols(key_list, dict_size_limit, &symbol_freq_list);
-  delete symbol_selector;
   printElapsedTime(cur_time, 0);
 
   std::vector<SymbolCode> symbol_code_list;
   CodeAssigner *code_assigner = CodeAssignerFactory::createCodeAssigner(kCaType);
   code_assigner->assignCodes(symbol_freq_list, &symbol_code_list);
-  code_len_ = code_assigner->getCodeLen();
   printElapsedTime(cur_time, 1);
 
-  dict_ = DictionaryFactory::createDictionary(n_);
-  bool ret_val = dict_->build(symbol_code_list);
+  bool ret_val = buildFromCodes(symbol_code_list);
   printElapsedTime(cur_time, 2);
 
   delete code_assigner;
   return ret_val;
 }
 
+void NGramEncoder::getSymbolCodes(std::vector<SymbolCode> *symbol_code_list) const {
+  int pos = 0;
+  for (int i = 0; i < (int)codes_.size(); i++) {
+    symbol_code_list->push_back(std::make_pair(symbols_.substr(pos, symbol_lens_[i]), codes_[i]));
+    pos += symbol_lens_[i];
+  }
+}
+
+bool NGramEncoder::buildFromCodes(const std::vector<SymbolCode> &symbol_code_list) {
+  symbols_.clear();
+  symbol_lens_.clear();
+  codes_.clear();
+  for (int i = 0; i < (int)symbol_code_list.size(); i++) {
+    symbols_ += symbol_code_list[i].first;
+    symbol_lens_.push_back((uint8_t)symbol_code_list[i].first.length());
+    codes_.push_back(symbol_code_list[i].second);
+  }
+  symbols_.shrink_to_fit();
+  // only the fixed-length assigner gives every symbol the same length
+#ifdef USE_FIXED_LEN_DICT_CODE
+  code_len_ = symbol_code_list.empty() ? -1 : symbol_code_list[0].second.len;
+#else
+  code_len_ = -1;
+#endif
+  delete dict_;
+  dict_ = DictionaryFactory::createDictionary(n_);
+  return dict_->build(symbol_code_list);
+}
+
+Code NGramEncoder::lookup(const char *key, const int key_len, const int pos, int &prefix_len) const {
+  if (pos + n_ + 1 <= key_len) return dict_->lookup(key + pos, n_ + 1, prefix_len);
+  char symbol[8] = {0};
+  memcpy(symbol, key + pos, key_len - pos);
+  return dict_->lookup(symbol, n_ + 1, prefix_len);
+}
+
 #ifdef USE_FIXED_LEN_DICT_CODE
-int NGramEncoder::encode(const std::string &key, uint8_t *buffer) const {
+int NGramEncoder::encode(const char *key, const int key_len, uint8_t *buffer) const {
   int64_t *int_buf = (int64_t *)buffer;
   int int_buf_len = 0;
   int idx = 0;
   int_buf[0] = 0;
-  const char *key_str = key.c_str();
   int pos = 0;
   if (code_len_ == 16 || code_len_ == 8) {
-    while (pos < (int)key.length()) {
+    while (pos < key_len) {
       int prefix_len = 0;
-      Code code = dict_->lookup(key_str + pos, n_ + 1, prefix_len);
+      Code code = lookup(key, key_len, pos, prefix_len);
       int_buf[idx] <<= code_len_;
       int_buf[idx] += code.code;
       int_buf_len += code_len_;
@@ -85,9 +151,9 @@ int NGramEncoder::encode(const std::string &key, uint8_t *buffer) const {
       pos += prefix_len;
     }
   } else {
-    while (pos < (int)key.length()) {
+    while (pos < key_len) {
       int prefix_len = 0;
-      Code code = dict_->lookup(key_str + pos, n_ + 1, prefix_len);
+      Code code = lookup(key, key_len, pos, prefix_len);
       int64_t s_buf = code.code;
       int s_len = code.len;
       if (int_buf_len + s_len > 63) {
@@ -111,16 +177,15 @@ int NGramEncoder::encode(const std::string &key, uint8_t *buffer) const {
   return ((idx << 6) + int_buf_len);
 }
 #else
-int NGramEncoder::encode(const std::string &key, uint8_t *buffer) const {
+int NGramEncoder::encode(const char *key, const int key_len, uint8_t *buffer) const {
   int64_t *int_buf = (int64_t *)buffer;
   int idx = 0;
   int_buf[0] = 0;
   int int_buf_len = 0;
-  const char *key_str = key.c_str();
   int pos = 0;
-  while (pos < (int)key.length()) {
+  while (pos < key_len) {
     int prefix_len = 0;
-    Code code = dict_->lookup(key_str + pos, n_ + 1, prefix_len);
+    Code code = lookup(key, key_len, pos, prefix_len);
     int64_t s_buf = code.code;
     int s_len = code.len;
     if (int_buf_len + s_len > 63) {
@@ -144,24 +209,46 @@ int NGramEncoder::encode(const std::string &key, uint8_t *buffer) const {
 }
 #endif
 
-void NGramEncoder::encodePair(const std::string &l_key, const std::string &r_key, uint8_t *l_buffer, uint8_t *r_buffer,
+int NGramEncoder::encodedBitLen(const char *key, const int key_len) const {
+  int bit_len = 0;
+  int pos = 0;
+  while (pos < key_len) {
+    int prefix_len = 0;
+    bit_len += lookup(key, key_len, pos, prefix_len).len;
+    pos += prefix_len;
+  }
+  return bit_len;
+}
+
+int NGramEncoder::encodeInto(const char *key, const int key_len,
+			     uint8_t *dst, const int capacity) const {
+  BoundedCodeWriter writer(dst, capacity);
+  int pos = 0;
+  while (pos < key_len) {
+    int prefix_len = 0;
+    Code code = lookup(key, key_len, pos, prefix_len);
+    if (!writer.append(code.code, code.len)) return -1;
+    pos += prefix_len;
+  }
+  return writer.finish();
+}
+
+void NGramEncoder::encodePair(const char *l_key, const int key_len_l,
+                              const char *r_key, const int key_len_r,
+                              uint8_t *l_buffer, uint8_t *r_buffer,
                               int &l_enc_len, int &r_enc_len) const {
   int64_t *int_buf_l = (int64_t *)l_buffer;
   int64_t *int_buf_r = (int64_t *)r_buffer;
   int idx_l = 0, idx_r = 0;
   int_buf_l[0] = 0;
   int int_buf_len_l = 0, int_buf_len_r = 0;
-  int key_len_l = (int)l_key.length();
-  int key_len_r = (int)r_key.length();
 
   // compute common prefix len
   int cp_len = 0;
-  while ((cp_len < key_len_l) && (l_key[cp_len] == r_key[cp_len])) {
+  while ((cp_len < key_len_l) && (cp_len < key_len_r) && (l_key[cp_len] == r_key[cp_len])) {
     cp_len++;
   }
 
-  const char *l_key_str = l_key.c_str();
-  const char *r_key_str = r_key.c_str();
   int pos = 0;
 
   bool found_mismatch = false;
@@ -178,7 +265,7 @@ void NGramEncoder::encodePair(const std::string &l_key, const std::string &r_key
     }
 
     int prefix_len = 0;
-    Code code = dict_->lookup(l_key_str + pos, n_ + 1, prefix_len);
+    Code code = lookup(l_key, key_len_l, pos, prefix_len);
     int64_t s_buf = code.code;
     int s_len = code.len;
     if (int_buf_len_l + s_len > 63) {
@@ -204,7 +291,7 @@ void NGramEncoder::encodePair(const std::string &l_key, const std::string &r_key
   pos = r_start_pos;
   while (pos < key_len_r) {
     int prefix_len = 0;
-    Code code = dict_->lookup(r_key_str + pos, n_ + 1, prefix_len);
+    Code code = lookup(r_key, key_len_r, pos, prefix_len);
     int64_t s_buf = code.code;
     int s_len = code.len;
     if (int_buf_len_r + s_len > 63) {
@@ -227,30 +314,26 @@ void NGramEncoder::encodePair(const std::string &l_key, const std::string &r_key
   r_enc_len = (idx_r << 6) + int_buf_len_r;
 }
 
-int64_t NGramEncoder::encodeBatch(const std::vector<std::string> &ori_keys, int start_id, int batch_size,
+int64_t NGramEncoder::encodeBatch(const KeySlice *keys, const int num_keys,
                                   std::vector<std::string> &enc_keys) {
   int64_t batch_code_size = 0;
-  int end_id = start_id + batch_size;
+  if (num_keys <= 0) return 0;
   // Get batch common prefix
-  int cp_len = 0;
-  std::string start_string = ori_keys[start_id];
-  const char *key_str = start_string.c_str();
-  int last_len = start_string.length();
-  for (int i = start_id + 1; i < end_id; i++) {
-    const auto &cur_key = ori_keys[i];
-    const char *cur_key_str = cur_key.c_str();
+  const char *key_str = keys[0].data;
+  int cp_len = keys[0].len;
+  for (int i = 1; i < num_keys; i++) {
+    const char *cur_key_str = keys[i].data;
+    int last_len = cp_len < keys[i].len ? cp_len : keys[i].len;
     cp_len = 0;
-    while ((cp_len + 4 < last_len) && *(int *)(cur_key_str + cp_len) == *(int *)(key_str + cp_len)) {
+    while ((cp_len + 4 <= last_len) && *(int *)(cur_key_str + cp_len) == *(int *)(key_str + cp_len)) {
       cp_len += 4;
     }
-    while (cp_len < last_len && cur_key[cp_len] == start_string[cp_len]) cp_len++;
-    last_len = cp_len;
-    // com_prefix = com_prefix.substr(0, cp_len);
+    while (cp_len < last_len && cur_key_str[cp_len] == key_str[cp_len]) cp_len++;
   }
-  // cp_len = (int)com_prefix.length();
   uint8_t buffer[8192];
   int64_t *int_buf = (int64_t *)buffer;
   int idx = 0;
+  int_buf[0] = 0;
   int int_buf_len = 0;
   int prefix_len = 0;
   // Encode common prefix
@@ -259,7 +342,7 @@ int64_t NGramEncoder::encodeBatch(const std::vector<std::string> &ori_keys, int
   int s_len = 0;
   int num_bits_left = 0;
   while (cp_pos + n_ <= cp_len) {
-    Code code = dict_->lookup(key_str + cp_pos, n_ + 1, prefix_len);
+    Code code = lookup(key_str, keys[0].len, cp_pos, prefix_len);
     s_buf = code.code;
     s_len = code.len;
     if (int_buf_len + s_len > 63) {
@@ -279,15 +362,15 @@ int64_t NGramEncoder::encodeBatch(const std::vector<std::string> &ori_keys, int
   }
   uint8_t key_buffer[8192];
   int64_t *int_key_buf = (int64_t *)key_buffer;
-  for (int i = start_id; i < end_id; i++) {
+  for (int i = 0; i < num_keys; i++) {
     int int_key_len = int_buf_len;
     int key_idx = idx;
     memcpy(key_buffer, buffer, 8 * (idx + 1));
-    const auto &cur_key = ori_keys[i];
-    const char *cur_key_str = cur_key.c_str();
+    const char *cur_key_str = keys[i].data;
+    int cur_key_len = keys[i].len;
     int pos = cp_pos;
-    while (pos < (int)cur_key.length()) {
-      Code code = dict_->lookup(cur_key_str + pos, n_ + 1, prefix_len);
+    while (pos < cur_key_len) {
+      Code code = lookup(cur_key_str, cur_key_len, pos, prefix_len);
       int64_t s_buf = code.code;
       int s_len = code.len;
       if (int_key_len + s_len > 63) {
@@ -321,7 +404,9 @@ int NGramEncoder::decode(const std::string &enc_key, const int bit_len, uint8_t
 
 int NGramEncoder::numEntries() const { return dict_->numEntries(); }
 
-int64_t NGramEncoder::memoryUse() const { return dict_->memoryUse(); }
+int64_t NGramEncoder::memoryUse() const {
+  return dict_->memoryUse() + symbols_.size() + symbol_lens_.size() + codes_.size() * sizeof(Code);
+}
 
 }  // namespace hope
 
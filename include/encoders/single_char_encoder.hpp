@@ -2,6 +2,9 @@
 #define SINGLE_CHAR_ENCODER_H
 
 #include <string.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 #include "encoder.hpp"
 
@@ -21,13 +24,26 @@ class SingleCharEncoder : public Encoder {
   }
 
   bool build(const std::vector<std::string> &key_list, const int64_t dict_size_limit);
-  int encode(const std::string &key, uint8_t *buffer) const;
+  bool build(SymbolSelector *symbol_selector, const std::vector<std::string> &key_list,
+	     const int64_t dict_size_limit);
+  using Encoder::build;
+  SymbolSelector *createSymbolSelector() const {
+    return SymbolSelectorFactory::createSymbolSelector(1);
+  }
+  using Encoder::encode;
+  int encode(const char *key, const int key_len, uint8_t *buffer) const;
+  using Encoder::encodedBitLen;
+  int encodedBitLen(const char *key, const int key_len) const;
+  using Encoder::encodeInto;
+  int encodeInto(const char *key, const int key_len, uint8_t *dst, const int capacity) const;
 
-  void encodePair(const std::string &l_key, const std::string &r_key,
+  using Encoder::encodePair;
+  void encodePair(const char *l_key, const int l_key_len,
+		  const char *r_key, const int r_key_len,
 		  uint8_t *l_buffer, uint8_t *r_buffer,
                   int &l_enc_len, int &r_enc_len) const;
-  int64_t encodeBatch(const std::vector<std::string> &ori_keys,
-		      int start_id, int batch_size,
+  using Encoder::encodeBatch;
+  int64_t encodeBatch(const KeySlice *keys, const int num_keys,
                       std::vector<std::string> &enc_keys);
 
   int decode(const std::string &enc_key, const int bit_len, uint8_t *buffer) const;
@@ -35,20 +51,48 @@ class SingleCharEncoder : public Encoder {
   int numEntries() const;
   int64_t memoryUse() const;
 
+  void getSymbolCodes(std::vector<SymbolCode> *symbol_code_list) const;
+  bool buildFromCodes(const std::vector<SymbolCode> &symbol_code_list);
+
  private:
-  bool buildDict(const std::vector<SymbolCode> &symbol_code_list);
+  // Shorter keys are encoded byte by byte; the gather kernel
+  // only pays off once its setup is amortized
+  static const int kMinSimdKeyLen = 16;
+  static const int kMaxPackedLen = 24;
+
+  // Writer is a BoundedCodeWriter or a WordCodeWriter; both return
+  // false if writer runs out of capacity
+  template <typename Writer>
+  bool appendCodes(const char *key, const int key_len, Writer &writer) const;
+#ifdef __AVX2__
+  // Appends the codes of 8 consecutive bytes
+  template <typename Writer>
+  bool appendBlock8(const char *block, Writer &writer) const;
+#endif
 
   Code dict_[kNumSingleChar];
+  // (code | len << 24) for the SIMD gathers; symbols with codes longer
+  // than kMaxPackedLen get len 0xFF so that their groups fall back
+  // to the byte loop
+  uint32_t packed_dict_[kNumSingleChar];
   SBT *decode_dict_;
 };
 
 bool SingleCharEncoder::build(const std::vector<std::string> &key_list,
 			      const int64_t dict_size_limit) {
+  SymbolSelector *symbol_selector = createSymbolSelector();
+  bool ret_val = build(symbol_selector, key_list, dict_size_limit);
+  delete symbol_selector;
+  return ret_val;
+}
+
+bool SingleCharEncoder::build(SymbolSelector *symbol_selector,
+			      const std::vector<std::string> &key_list,
+			      const int64_t dict_size_limit) {
   double cur_time = 0;
   setStopWatch(cur_time, 1);
   
   std::vector<SymbolFreq> symbol_freq_list;
-  SymbolSelector *symbol_selector = SymbolSelectorFactory::createSymbolSelector(1);
   symbol_selector->selectSymbols(key_list, dict_size_limit, &symbol_freq_list);
   printElapsedTime(cur_time, 0);
   
@@ -57,20 +101,27 @@ bool SingleCharEncoder::build(const std::vector<std::string> &key_list,
   code_assigner->assignCodes(symbol_freq_list, &symbol_code_list);
   printElapsedTime(cur_time, 1);
   
-  bool ret_val = buildDict(symbol_code_list);
+  bool ret_val = buildFromCodes(symbol_code_list);
   printElapsedTime(cur_time, 2);
 
-  delete symbol_selector;
   delete code_assigner;
   return ret_val;
 }
 
-int SingleCharEncoder::encode(const std::string &key, uint8_t *buffer) const {
+int SingleCharEncoder::encode(const char *key, const int key_len, uint8_t *buffer) const {
+#ifdef __AVX2__
+  // the word writer keeps the buffer contract of the byte loop below
+  if (key_len >= kMinSimdKeyLen) {
+    WordCodeWriter writer(buffer);
+    appendCodes(key, key_len, writer);
+    return writer.finish();
+  }
+#endif
   int64_t *int_buf = (int64_t *)buffer;
   int idx = 0;
   int_buf[0] = 0;
   int int_buf_len = 0;
-  for (int i = 0; i < (int)key.length(); i++) {
+  for (int i = 0; i < key_len; i++) {
     uint8_t s = (uint8_t)key[i];
     int64_t s_buf = dict_[s].code;
     int s_len = dict_[s].len;
@@ -93,7 +144,83 @@ int SingleCharEncoder::encode(const std::string &key, uint8_t *buffer) const {
   return ((idx << 6) + int_buf_len);
 }
 
-void SingleCharEncoder::encodePair(const std::string &l_key, const std::string &r_key,
+int SingleCharEncoder::encodedBitLen(const char *key, const int key_len) const {
+  int bit_len = 0;
+  for (int i = 0; i < key_len; i++) {
+    bit_len += dict_[(uint8_t)key[i]].len;
+  }
+  return bit_len;
+}
+
+int SingleCharEncoder::encodeInto(const char *key, const int key_len,
+				  uint8_t *dst, const int capacity) const {
+  BoundedCodeWriter writer(dst, capacity);
+  if (!appendCodes(key, key_len, writer)) return -1;
+  return writer.finish();
+}
+
+template <typename Writer>
+inline bool SingleCharEncoder::appendCodes(const char *key, const int key_len,
+					   Writer &writer) const {
+  int i = 0;
+#ifdef __AVX2__
+  if (key_len >= kMinSimdKeyLen) {
+    for (; i + 8 <= key_len; i += 8) {
+      if (!appendBlock8(key + i, writer)) return false;
+    }
+  }
+#endif
+  for (; i < key_len; i++) {
+    uint8_t s = (uint8_t)key[i];
+    if (!writer.append(dict_[s].code, dict_[s].len)) return false;
+  }
+  return true;
+}
+
+#ifdef __AVX2__
+// One gather fetches the 8 packed entries. 64-bit lane k then holds
+// symbols 2k and 2k + 1, which are merged with a variable shift;
+// pairs are merged again into two groups of 4 codes (lanes 0 and 2)
+template <typename Writer>
+inline bool SingleCharEncoder::appendBlock8(const char *block, Writer &writer) const {
+  const __m256i code_mask = _mm256_set1_epi64x(0xFFFFFF);
+  const __m256i len_mask = _mm256_set1_epi64x(0xFF);
+  __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)block));
+  __m256i entries = _mm256_i32gather_epi32((const int *)packed_dict_, idx, 4);
+
+  __m256i even_code = _mm256_and_si256(entries, code_mask);
+  __m256i even_len = _mm256_and_si256(_mm256_srli_epi64(entries, 24), len_mask);
+  __m256i odd_code = _mm256_and_si256(_mm256_srli_epi64(entries, 32), code_mask);
+  __m256i odd_len = _mm256_srli_epi64(entries, 56);
+  __m256i pair_code = _mm256_or_si256(_mm256_sllv_epi64(even_code, odd_len), odd_code);
+  __m256i pair_len = _mm256_add_epi64(even_len, odd_len);
+
+  __m256i hi_pair_len = _mm256_unpackhi_epi64(pair_len, pair_len);
+  __m256i group_code = _mm256_or_si256(
+      _mm256_sllv_epi64(_mm256_unpacklo_epi64(pair_code, pair_code), hi_pair_len),
+      _mm256_unpackhi_epi64(pair_code, pair_code));
+  __m256i group_len = _mm256_add_epi64(_mm256_unpacklo_epi64(pair_len, pair_len), hi_pair_len);
+
+  int64_t group_codes[4];
+  int64_t group_lens[4];
+  _mm256_storeu_si256((__m256i *)group_codes, group_code);
+  _mm256_storeu_si256((__m256i *)group_lens, group_len);
+  for (int g = 0; g < 2; g++) {
+    if (group_lens[2 * g] <= 63) {
+      if (!writer.append(group_codes[2 * g], (int)group_lens[2 * g])) return false;
+    } else {
+      for (int i = 4 * g; i < 4 * g + 4; i++) {
+        uint8_t s = (uint8_t)block[i];
+        if (!writer.append(dict_[s].code, dict_[s].len)) return false;
+      }
+    }
+  }
+  return true;
+}
+#endif
+
+void SingleCharEncoder::encodePair(const char *l_key, const int l_key_len,
+				   const char *r_key, const int r_key_len,
 				   uint8_t *l_buffer, uint8_t *r_buffer,
 				   int &l_enc_len, int &r_enc_len) const {
   int64_t *int_buf_l = (int64_t *)l_buffer;
@@ -103,9 +230,9 @@ void SingleCharEncoder::encodePair(const std::string &l_key, const std::string &
   int int_buf_len_l = 0, int_buf_len_r = 0;
   bool found_mismatch = false;
   int r_start_pos = 0;
-  for (int i = 0; i < (int)l_key.length(); i++) {
+  for (int i = 0; i < l_key_len; i++) {
     if (!found_mismatch) {
-      if ((uint8_t)l_key[i] < (uint8_t)r_key[i]) {
+      if (i < r_key_len && (uint8_t)l_key[i] < (uint8_t)r_key[i]) {
         r_start_pos = i;
         memcpy((void *)r_buffer, (const void *)l_buffer, 8 * (idx_l + 1));
         idx_r = idx_l;
@@ -135,7 +262,7 @@ void SingleCharEncoder::encodePair(const std::string &l_key, const std::string &
   l_enc_len = (idx_l << 6) + int_buf_len_l;
 
   // continue encoding right key
-  for (int i = r_start_pos; i < (int)r_key.length(); i++) {
+  for (int i = r_start_pos; i < r_key_len; i++) {
     uint8_t s = (uint8_t)r_key[i];
     int64_t s_buf = dict_[s].code;
     int s_len = dict_[s].len;
@@ -158,80 +285,36 @@ void SingleCharEncoder::encodePair(const std::string &l_key, const std::string &
   r_enc_len = (idx_r << 6) + int_buf_len_r;
 }
 
-int64_t SingleCharEncoder::encodeBatch(const std::vector<std::string> &ori_keys,
-				       int start_id, int batch_size,
+int64_t SingleCharEncoder::encodeBatch(const KeySlice *keys, const int num_keys,
                                        std::vector<std::string> &enc_keys) {
   int64_t batch_code_size = 0;
-  int end_id = (int)ori_keys.size() < (start_id + batch_size) ? (int)ori_keys.size()
-				      : (start_id + batch_size);
+  if (num_keys <= 0) return 0;
   // Get batch common prefix
-  int cp_len = 0;
-  std::string start_string = ori_keys[start_id];
-  int last_len = start_string.length();
-  for (int i = start_id + 1; i < end_id; i++) {
-    const auto &cur_key = ori_keys[i];
+  const char *start_string = keys[0].data;
+  int cp_len = keys[0].len;
+  for (int i = 1; i < num_keys; i++) {
+    const char *cur_key = keys[i].data;
+    int last_len = cp_len < keys[i].len ? cp_len : keys[i].len;
     cp_len = 0;
-    while ((cp_len < last_len) && *(int *)(cur_key.c_str() + cp_len) == *(int *)(start_string.c_str() + cp_len)) {
+    while ((cp_len + 4 <= last_len) && *(int *)(cur_key + cp_len) == *(int *)(start_string + cp_len)) {
       cp_len += 4;
     }
     while (cp_len < last_len && cur_key[cp_len] == start_string[cp_len]) cp_len++;
-    last_len = cp_len;
   }
 
   uint8_t buffer[8192];
-  int64_t *int_buf = (int64_t *)buffer;
-  int idx = 0;
-  int int_buf_len = 0;
+  BoundedCodeWriter prefix_writer(buffer, sizeof(buffer));
   // Encoder common prefix
-  for (int i = 0; i < cp_len; i++) {
-    uint8_t s = (uint8_t)start_string[i];
-    int64_t s_buf = dict_[s].code;
-    int s_len = dict_[s].len;
-    if (int_buf_len + s_len > 63) {
-      int num_bits_left = 64 - int_buf_len;
-      int_buf_len = s_len - num_bits_left;
-      int_buf[idx] <<= num_bits_left;
-      int_buf[idx] |= (s_buf >> int_buf_len);
-      int_buf[idx] = __builtin_bswap64(int_buf[idx]);
-      int_buf[idx + 1] = s_buf;
-      idx++;
-    } else {
-      int_buf[idx] <<= s_len;
-      int_buf[idx] |= s_buf;
-      int_buf_len += s_len;
-    }
-  }
+  appendCodes(start_string, cp_len, prefix_writer);
 
   uint8_t key_buffer[8192];
-  int64_t *int_key_buf = (int64_t *)key_buffer;
-  for (int i = start_id; i < end_id; i++) {
-    int int_key_len = int_buf_len;
-    int key_idx = idx;
-    memcpy(key_buffer, buffer, 8 * (idx + 1));
-    const auto &cur_key = ori_keys[i];
-    for (int pos = cp_len; pos < (int)cur_key.length(); pos++) {
-      uint8_t s = (uint8_t)cur_key[pos];
-      int64_t s_buf = dict_[s].code;
-      int s_len = dict_[s].len;
-      if (int_key_len + s_len > 63) {
-        int num_bits_left = 64 - int_key_len;
-        int_key_len = s_len - num_bits_left;
-        int_key_buf[key_idx] <<= num_bits_left;
-        int_key_buf[key_idx] |= (s_buf >> int_key_len);
-        int_key_buf[key_idx] = __builtin_bswap64(int_key_buf[key_idx]);
-        int_key_buf[key_idx + 1] = s_buf;
-        key_idx++;
-      } else {
-        int_key_buf[key_idx] <<= s_len;
-        int_key_buf[key_idx] |= s_buf;
-        int_key_len += s_len;
-      }
-    }
-    int_key_buf[key_idx] <<= (64 - int_key_len);
-    int_key_buf[key_idx] = __builtin_bswap64(int_key_buf[key_idx]);
-    int64_t cur_size = (key_idx << 6) + int_key_len;
+  BoundedCodeWriter writer;
+  for (int i = 0; i < num_keys; i++) {
+    writer.resume(key_buffer, sizeof(key_buffer), prefix_writer);
+    appendCodes(keys[i].data + cp_len, keys[i].len - cp_len, writer);
+    int64_t cur_size = writer.finish();
 #ifndef BATCH_DRY_ENCODE
-    int enc_len = ((key_idx << 6) + int_key_len + 7) >> 3;
+    int enc_len = (cur_size + 7) >> 3;
     enc_keys.push_back(std::string((const char *)key_buffer, enc_len));
 #endif
     batch_code_size += cur_size;
@@ -265,16 +348,26 @@ int SingleCharEncoder::numEntries() const { return kNumSingleChar; }
 
 int64_t SingleCharEncoder::memoryUse() const {
 #ifdef INCLUDE_DECODE
-  return sizeof(Code) * kNumSingleChar + decode_dict_->memory();
+  return (sizeof(Code) + sizeof(uint32_t)) * kNumSingleChar + decode_dict_->memory();
 #else
-  return sizeof(Code) * kNumSingleChar;
+  return (sizeof(Code) + sizeof(uint32_t)) * kNumSingleChar;
 #endif
 }
 
-bool SingleCharEncoder::buildDict(const std::vector<SymbolCode> &symbol_code_list) {
+void SingleCharEncoder::getSymbolCodes(std::vector<SymbolCode> *symbol_code_list) const {
+  for (int i = 0; i < kNumSingleChar; i++) {
+    symbol_code_list->push_back(std::make_pair(std::string(1, (char)i), dict_[i]));
+  }
+}
+
+bool SingleCharEncoder::buildFromCodes(const std::vector<SymbolCode> &symbol_code_list) {
   if (symbol_code_list.size() < kNumSingleChar) return false;
   for (int i = 0; i < kNumSingleChar; i++) {
     dict_[i] = symbol_code_list[i].second;
+    if (dict_[i].len <= kMaxPackedLen)
+      packed_dict_[i] = (uint32_t)dict_[i].code | ((uint32_t)dict_[i].len << 24);
+    else
+      packed_dict_[i] = 0xFF000000;
   }
 
 #ifdef INCLUDE_DECODE
@@ -19,6 +19,38 @@ class SymbolSelector {
   virtual bool selectSymbols(const std::vector<std::string> &key_list,
 			     const int64_t num_limit,
                              std::vector<SymbolFreq> *symbol_freq_list) = 0;
+
+  // Selectors that count keys incrementally never copy them;
+  // the others copy the slices into a sample first
+  bool selectSymbols(const KeySlice *keys, const int num_keys,
+		     const int64_t num_limit,
+		     std::vector<SymbolFreq> *symbol_freq_list) {
+    std::vector<std::string> key_list;
+    countKeys(keys, num_keys, &key_list);
+    return selectSymbols(key_list, num_limit, symbol_freq_list);
+  }
+
+  // Counts the slices and copies into sample only the keys that
+  // selectSymbols still needs as strings
+  void countKeys(const KeySlice *keys, const int num_keys,
+		 std::vector<std::string> *sample) {
+    for (int i = 0; i < num_keys; i++) {
+      if (!countKey(keys[i].data, keys[i].len) || needsSample())
+	sample->push_back(std::string(keys[i].data, keys[i].len));
+    }
+  }
+
+  // Streaming build (see EncoderBuilder): accumulate the symbol
+  // statistics of one key at a time. Returns false if the selector
+  // can only count on a materialized sample. Once keys are counted
+  // here, selectSymbols no longer recounts key_list.
+  virtual bool countKey(const char *key, const int key_len) { return false; }
+
+  bool countKey(const std::string &key) { return countKey(key.data(), (int)key.length()); }
+
+  // Whether selectSymbols still needs the sampled keys after all
+  // keys have been passed to countKey
+  virtual bool needsSample() const { return true; }
 };
 
 }  // namespace hope
@@ -24,6 +24,7 @@ class ALMImprovedSS : public SymbolSelector {
  public:
   ALMImprovedSS();
 
+  using SymbolSelector::selectSymbols;
   bool selectSymbols(const std::vector<std::string> &key_list, const int64_t num_limit,
                      std::vector<SymbolFreq> *symbol_freq_list);
 
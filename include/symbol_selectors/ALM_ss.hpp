@@ -16,6 +16,7 @@ class ALMSS : public SymbolSelector {
  public:
   ALMSS();
 
+  using SymbolSelector::selectSymbols;
   bool selectSymbols(const std::vector<std::string> &key_list, const int64_t num_limit,
                      std::vector<SymbolFreq> *symbol_freq_list);
 
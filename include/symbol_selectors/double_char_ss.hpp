@@ -10,17 +10,23 @@ class DoubleCharSS : public SymbolSelector {
   DoubleCharSS();
   ~DoubleCharSS(){};
 
+  using SymbolSelector::selectSymbols;
   bool selectSymbols(const std::vector<std::string> &key_list,
 		     const int64_t num_limit,
                      std::vector<SymbolFreq> *symbol_freq_list);
 
+  using SymbolSelector::countKey;
+  bool countKey(const char *key, const int key_len);
+  bool needsSample() const { return false; }
+
  private:
   void countSymbolFreq(const std::vector<std::string> &key_list);
 
   int64_t freq_list_[kNumDoubleChar];
+  int64_t num_counted_keys_;
 };
 
-DoubleCharSS::DoubleCharSS() {
+DoubleCharSS::DoubleCharSS() : num_counted_keys_(0) {
   for (int i = 0; i < kNumDoubleChar; i++) {
     freq_list_[i] = 1;
   }
@@ -29,8 +35,8 @@ DoubleCharSS::DoubleCharSS() {
 bool DoubleCharSS::selectSymbols(const std::vector<std::string> &key_list,
 				 const int64_t num_limit,
                                  std::vector<SymbolFreq> *symbol_freq_list) {
-  if (key_list.empty()) return false;
-  countSymbolFreq(key_list);
+  if (key_list.empty() && num_counted_keys_ == 0) return false;
+  if (num_counted_keys_ == 0) countSymbolFreq(key_list);
   for (int i = 0; i < kNumDoubleChar; i++) {
     std::string symbol;
     symbol += (char)(i / 256);
@@ -40,6 +46,16 @@ bool DoubleCharSS::selectSymbols(const std::vector<std::string> &key_list,
   return true;
 }
 
+bool DoubleCharSS::countKey(const char *key, const int key_len) {
+  for (int j = 0; j < key_len; j++) {
+    unsigned idx = 256 * (uint8_t)key[j];
+    if (j + 1 < key_len) idx += (uint8_t)key[j + 1];
+    freq_list_[idx]++;
+  }
+  num_counted_keys_++;
+  return true;
+}
+
 void DoubleCharSS::countSymbolFreq(const std::vector<std::string> &key_list) {
   for (int i = 0; i < (int)key_list.size(); i++) {
     int key_len = (int)key_list[i].length();
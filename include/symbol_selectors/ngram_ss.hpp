@@ -9,16 +9,23 @@ namespace hope {
 
 class NGramSS : public SymbolSelector {
  public:
-  NGramSS(int n) : n_(n){};
+  NGramSS(int n) : n_(n), num_counted_keys_(0){};
   ~NGramSS() { freq_map_.clear(); };
 
+  using SymbolSelector::selectSymbols;
   bool selectSymbols(const std::vector<std::string> &key_list,
 		     const int64_t num_limit,
                      std::vector<SymbolFreq> *symbol_freq_list);
 
+  // ngram frequencies can be counted on the fly, but the interval
+  // frequencies still come from a test encoding of the sample
+  using SymbolSelector::countKey;
+  bool countKey(const char *key, const int key_len);
+
  private:
   // count the frequency of every ngram appeared in the sampled keys
   void countSymbolFreq(const std::vector<std::string> &key_list);
+  void countKeySymbolFreq(const char *key, const int key_len);
   void pickMostFreqSymbols(const int64_t num_limit,
 			   std::vector<std::string> *most_freq_symbols);
 
@@ -40,13 +47,14 @@ class NGramSS : public SymbolSelector {
   std::vector<std::string> interval_prefixes_;
   std::vector<std::string> interval_boundaries_; // left boundaries
   std::vector<int64_t> interval_freqs_;
+  int64_t num_counted_keys_;
 };
 
 bool NGramSS::selectSymbols(const std::vector<std::string> &key_list,
 			    const int64_t num_limit,
                             std::vector<SymbolFreq> *symbol_freq_list) {
   if (key_list.empty()) return false;
-  countSymbolFreq(key_list);
+  if (num_counted_keys_ == 0) countSymbolFreq(key_list);
   std::vector<std::string> most_freq_symbols;
   int64_t adjust_num_limit = num_limit;
   if (num_limit > (int64_t)freq_map_.size() * 2) {
@@ -66,19 +74,29 @@ bool NGramSS::selectSymbols(const std::vector<std::string> &key_list,
   return true;
 }
 
+bool NGramSS::countKey(const char *key, const int key_len) {
+  countKeySymbolFreq(key, key_len);
+  num_counted_keys_++;
+  return true;
+}
+
 void NGramSS::countSymbolFreq(const std::vector<std::string> &key_list) {
   freq_map_.clear();
+  for (int i = 0; i < (int)key_list.size(); i++) {
+    countKeySymbolFreq(key_list[i].data(), (int)key_list[i].length());
+  }
+}
+
+void NGramSS::countKeySymbolFreq(const char *key, const int key_len) {
   // std::unordered_map<std::string, int64_t>::iterator iter;
   std::map<std::string, int64_t>::iterator iter;
-  for (int i = 0; i < (int)key_list.size(); i++) {
-    for (int j = 0; j < (int)key_list[i].length() - n_ + 1; j++) {
-      std::string ngram = key_list[i].substr(j, n_);
-      iter = freq_map_.find(ngram);
-      if (iter == freq_map_.end()) {
-        freq_map_.insert(std::pair<std::string, int64_t>(ngram, 1));
-      } else {
-        iter->second += 1;
-      }
+  for (int j = 0; j < key_len - n_ + 1; j++) {
+    std::string ngram = std::string(key + j, n_);
+    iter = freq_map_.find(ngram);
+    if (iter == freq_map_.end()) {
+      freq_map_.insert(std::pair<std::string, int64_t>(ngram, 1));
+    } else {
+      iter->second += 1;
     }
   }
 }
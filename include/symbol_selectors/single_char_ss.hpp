@@ -10,17 +10,23 @@ class SingleCharSS : public SymbolSelector {
   SingleCharSS();
   ~SingleCharSS(){};
 
+  using SymbolSelector::selectSymbols;
   bool selectSymbols(const std::vector<std::string> &key_list,
 		     const int64_t num_limit,
                      std::vector<SymbolFreq> *symbol_freq_list);
 
+  using SymbolSelector::countKey;
+  bool countKey(const char *key, const int key_len);
+  bool needsSample() const { return false; }
+
  private:
   void countSymbolFreq(const std::vector<std::string> &key_list);
 
   int64_t freq_list_[kNumSingleChar];
+  int64_t num_counted_keys_;
 };
 
-SingleCharSS::SingleCharSS() {
+SingleCharSS::SingleCharSS() : num_counted_keys_(0) {
   for (int i = 0; i < kNumSingleChar; i++) {
     freq_list_[i] = 1;
   }
@@ -29,14 +35,23 @@ SingleCharSS::SingleCharSS() {
 bool SingleCharSS::selectSymbols(const std::vector<std::string> &key_list,
 				 const int64_t num_limit,
                                  std::vector<SymbolFreq> *symbol_freq_list) {
-  if (key_list.empty() || num_limit < kNumSingleChar) return false;
-  countSymbolFreq(key_list);
+  if ((key_list.empty() && num_counted_keys_ == 0) || num_limit < kNumSingleChar)
+    return false;
+  if (num_counted_keys_ == 0) countSymbolFreq(key_list);
   for (int i = 0; i < kNumSingleChar; i++) {
     symbol_freq_list->push_back(std::make_pair(std::string(1, (char)i), freq_list_[i]));
   }
   return true;
 }
 
+bool SingleCharSS::countKey(const char *key, const int key_len) {
+  for (int j = 0; j < key_len; j++) {
+    freq_list_[(uint8_t)key[j]]++;
+  }
+  num_counted_keys_++;
+  return true;
+}
+
 void SingleCharSS::countSymbolFreq(const std::vector<std::string> &key_list) {
   for (int i = 0; i < (int)key_list.size(); i++) {
     for (int j = 0; j < (int)key_list[i].length(); j++) {
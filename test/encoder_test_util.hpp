@@ -0,0 +1,102 @@
+#ifndef ENCODER_TEST_UTIL_H
+#define ENCODER_TEST_UTIL_H
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "encoder.hpp"
+#include "gtest/gtest.h"
+
+namespace hope {
+
+namespace encodertestutil {
+
+static const int kBufferLen = 4096;
+
+inline int GetByteLen(const int bitlen) { return ((bitlen + 7) & ~7) / 8; }
+
+// Builds encoder from keys and slice_encoder from the same keys packed
+// back-to-back without terminators (as in a page), then checks that
+// encode, encodePair and encodeBatch on the slices match the std::string
+// entry points byte for byte
+inline void CheckSliceEncoding(Encoder *encoder, Encoder *slice_encoder,
+                               const std::vector<std::string> &keys, const int64_t dict_size_limit) {
+  std::string page;
+  std::vector<KeySlice> slices;
+  for (int i = 0; i < static_cast<int>(keys.size()); i++) page += keys[i];
+  int offset = 0;
+  for (int i = 0; i < static_cast<int>(keys.size()); i++) {
+    slices.push_back({page.data() + offset, static_cast<int>(keys[i].length())});
+    offset += keys[i].length();
+  }
+  ASSERT_TRUE(encoder->build(keys, dict_size_limit));
+  ASSERT_TRUE(slice_encoder->build(slices.data(), static_cast<int>(slices.size()), dict_size_limit));
+  ASSERT_EQ(encoder->numEntries(), slice_encoder->numEntries());
+
+  std::vector<uint8_t> buffer(kBufferLen), slice_buffer(kBufferLen);
+  for (int i = 0; i < static_cast<int>(keys.size()); i++) {
+    int len = encoder->encode(keys[i], buffer.data());
+    int slice_len = slice_encoder->encode(slices[i].data, slices[i].len, slice_buffer.data());
+    ASSERT_EQ(len, slice_len);
+    ASSERT_EQ(0, memcmp(buffer.data(), slice_buffer.data(), GetByteLen(len)));
+  }
+  uint8_t *r_buffer = buffer.data() + kBufferLen / 2;
+  uint8_t *slice_r_buffer = slice_buffer.data() + kBufferLen / 2;
+  for (int i = 0; i < static_cast<int>(keys.size()) - 1; i++) {
+    int l_len = 0, r_len = 0, slice_l_len = 0, slice_r_len = 0;
+    encoder->encodePair(keys[i], keys[i + 1], buffer.data(), r_buffer, l_len, r_len);
+    slice_encoder->encodePair(slices[i].data, slices[i].len, slices[i + 1].data, slices[i + 1].len,
+                              slice_buffer.data(), slice_r_buffer, slice_l_len, slice_r_len);
+    ASSERT_EQ(l_len, slice_l_len);
+    ASSERT_EQ(r_len, slice_r_len);
+    ASSERT_EQ(0, memcmp(buffer.data(), slice_buffer.data(), GetByteLen(l_len)));
+    ASSERT_EQ(0, memcmp(r_buffer, slice_r_buffer, GetByteLen(r_len)));
+  }
+  std::vector<std::string> enc_keys;
+  std::vector<std::string> slice_enc_keys;
+  int batch_size = 10;
+  int ls = static_cast<int>(keys.size());
+  for (int i = 0; i < ls - batch_size; i += batch_size) {
+    encoder->encodeBatch(keys, i, batch_size, enc_keys);
+    slice_encoder->encodeBatch(slices.data() + i, batch_size, slice_enc_keys);
+  }
+  EXPECT_TRUE(enc_keys == slice_enc_keys);
+}
+
+// Checks encodedBitLen and encodeInto against encode on every key:
+// encodeInto writes exactly the encoded bytes, whatever the capacity,
+// and fails (returns -1) when capacity is one byte short
+inline void CheckEncodeInto(const Encoder *encoder, const std::vector<std::string> &keys) {
+  std::vector<uint8_t> buffer(kBufferLen), dst(kBufferLen);
+  for (int i = 0; i < static_cast<int>(keys.size()); i++) {
+    int len = encoder->encode(keys[i], buffer.data());
+    ASSERT_EQ(len, encoder->encodedBitLen(keys[i]));
+    int byte_len = GetByteLen(len);
+    memset(dst.data(), 0xAB, kBufferLen);
+    ASSERT_EQ(len, encoder->encodeInto(keys[i], dst.data(), byte_len));
+    ASSERT_EQ(0, memcmp(buffer.data(), dst.data(), byte_len));
+    // nothing is written past capacity
+    for (int j = byte_len; j < byte_len + 16; j++) {
+      ASSERT_EQ(0xAB, dst[j]);
+    }
+    // nor past the code when capacity is larger (e.g., a page with
+    // data after the write position)
+    memset(dst.data(), 0xAB, kBufferLen);
+    ASSERT_EQ(len, encoder->encodeInto(keys[i], dst.data(), kBufferLen));
+    ASSERT_EQ(0, memcmp(buffer.data(), dst.data(), byte_len));
+    for (int j = byte_len; j < byte_len + 16; j++) {
+      ASSERT_EQ(0xAB, dst[j]);
+    }
+    if (byte_len > 0) {
+      ASSERT_EQ(-1, encoder->encodeInto(keys[i], dst.data(), byte_len - 1));
+    }
+  }
+}
+
+}  // namespace encodertestutil
+
+}  // namespace hope
+
+#endif  // ENCODER_TEST_UTIL_H
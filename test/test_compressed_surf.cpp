@@ -0,0 +1,131 @@
+#include <assert.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "compressed_surf.hpp"
+#include "gtest/gtest.h"
+
+namespace hope {
+
+namespace compressedsurftest {
+
+static const char kWordFilePath[] = "../../datasets/words.txt";
+static const int kWordTestSize = 234369;
+static const int kSamplePercent = 1;
+static const int kDictSizeLimit = 10000;
+static const surf::level_t kSuffixLen = 8;
+static std::vector<std::string> words;
+
+class CompressedSuRFTest : public ::testing::Test {};
+
+TEST_F(CompressedSuRFTest, lookupWordTest) {
+  for (int encoder_type = 1; encoder_type <= 3; encoder_type += 2) {
+    CompressedSuRF *filter = new CompressedSuRF(words, encoder_type, kDictSizeLimit, kSamplePercent,
+                                                surf::kReal, 0, kSuffixLen);
+    for (int i = 0; i < (int)words.size(); i++) {
+      ASSERT_TRUE(filter->lookupKey(words[i]));
+    }
+    int num_positives = 0;
+    for (int i = 0; i < (int)words.size(); i++) {
+      num_positives += (int)filter->lookupKey(words[i] + "\x01\x02");
+    }
+    EXPECT_LT(num_positives, (int)words.size());
+    delete filter;
+  }
+}
+
+TEST_F(CompressedSuRFTest, lookupRangeWordTest) {
+  CompressedSuRF *filter = new CompressedSuRF(words, 3, kDictSizeLimit, kSamplePercent);
+  EXPECT_TRUE(filter->lookupRange(std::string("\1"), words[0]));
+  for (int i = 0; i < (int)words.size() - 1; i++) {
+    ASSERT_TRUE(filter->lookupRange(words[i], words[i + 1]));
+    ASSERT_TRUE(filter->lookupRange(words[i], words[i]));
+  }
+  EXPECT_TRUE(filter->lookupRange(words[words.size() - 1], std::string("zzzzzzzz")));
+
+  surf::SuRF::Iter iter = filter->moveToKeyGreaterThan(words[0]);
+  ASSERT_TRUE(iter.isValid());
+  int compare = iter.compare(filter->encodeKey(words[0]));
+  EXPECT_TRUE(compare == 0 || compare == surf::kCouldBePositive);
+  delete filter;
+}
+
+TEST_F(CompressedSuRFTest, serializeTest) {
+  // every encoder type must come back from its code table unchanged
+  for (int encoder_type = 1; encoder_type <= 6; encoder_type++) {
+    CompressedSuRF *filter = new CompressedSuRF(words, encoder_type, kDictSizeLimit, kSamplePercent,
+                                                surf::kHash, kSuffixLen, 0);
+    char *data = filter->serialize();
+    CompressedSuRF *filter_copy = CompressedSuRF::deSerialize(data);
+    EXPECT_EQ(filter->serializedSize(), filter_copy->serializedSize());
+    EXPECT_EQ(filter->getEncoder()->numEntries(), filter_copy->getEncoder()->numEntries());
+    for (int i = 0; i < (int)words.size(); i++) {
+      ASSERT_EQ(filter->encodeKey(words[i]), filter_copy->encodeKey(words[i]));
+      ASSERT_TRUE(filter_copy->lookupKey(words[i]));
+      std::string absent_key = words[i] + "\x01";
+      EXPECT_EQ(filter->lookupKey(absent_key), filter_copy->lookupKey(absent_key));
+    }
+    for (int i = 0; i < (int)words.size() - 1; i += 7) {
+      ASSERT_TRUE(filter_copy->lookupRange(words[i], words[i + 1]));
+    }
+    delete filter_copy;
+    delete[] data;
+    delete filter;
+  }
+}
+
+TEST_F(CompressedSuRFTest, nibbleLabelTest) {
+  CompressedSuRF *filter = new CompressedSuRF(words, 3, kDictSizeLimit, kSamplePercent, surf::kHash, kSuffixLen, 0,
+                                              10000, surf::kNibbleLabelBits);
+  char *data = filter->serialize();
+  CompressedSuRF *filter_copy = CompressedSuRF::deSerialize(data);
+  for (int i = 0; i < (int)words.size(); i++) {
+    ASSERT_TRUE(filter->lookupKey(words[i]));
+    ASSERT_TRUE(filter_copy->lookupKey(words[i]));
+  }
+  for (int i = 0; i < (int)words.size() - 1; i++) {
+    ASSERT_TRUE(filter->lookupRange(words[i], words[i + 1]));
+    ASSERT_TRUE(filter_copy->lookupRange(words[i], words[i + 1]));
+  }
+  delete filter_copy;
+  delete[] data;
+  delete filter;
+}
+
+TEST_F(CompressedSuRFTest, approxCountTest) {
+  for (surf::level_t label_bits = surf::kNibbleLabelBits; label_bits <= surf::kByteLabelBits; label_bits *= 2) {
+    CompressedSuRF *filter = new CompressedSuRF(words, 3, kDictSizeLimit, kSamplePercent, surf::kReal, 0,
+                                                kSuffixLen, 10000, label_bits);
+    for (int i = 0; i < (int)words.size(); i += 97) {
+      int j = std::min(i + i % 1000, (int)words.size() - 1);
+      surf::CountEstimate estimate = filter->approxCount(words[i], words[j]);
+      ASSERT_LE(estimate.lower, (uint64_t)(j - i + 1));
+      ASSERT_GE(estimate.upper, (uint64_t)(j - i + 1));
+    }
+    delete filter;
+  }
+}
+
+void LoadWords() {
+  std::ifstream infile(kWordFilePath);
+  std::string key;
+  int count = 0;
+  while (infile.good() && count < kWordTestSize) {
+    infile >> key;
+    words.push_back(key);
+    count++;
+  }
+}
+
+}  // namespace compressedsurftest
+}  // namespace hope
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  hope::compressedsurftest::LoadWords();
+  return RUN_ALL_TESTS();
+}
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "double_char_encoder.hpp"
+#include "encoder_test_util.hpp"
 #include "gtest/gtest.h"
 #include "symbol_selector_factory.hpp"
 #include "code_assigner_factory.hpp"
@@ -104,6 +105,21 @@ TEST_F(DoubleCharEncoderTest, wordTest) {
   delete encoder;
 }
 
+TEST_F(DoubleCharEncoderTest, wordSliceTest) {
+  DoubleCharEncoder *encoder = new DoubleCharEncoder();
+  DoubleCharEncoder *slice_encoder = new DoubleCharEncoder();
+  encodertestutil::CheckSliceEncoding(encoder, slice_encoder, words, 65536);
+  delete encoder;
+  delete slice_encoder;
+}
+
+TEST_F(DoubleCharEncoderTest, wordEncodeIntoTest) {
+  DoubleCharEncoder *encoder = new DoubleCharEncoder();
+  encoder->build(words, 65536);
+  encodertestutil::CheckEncodeInto(encoder, words);
+  delete encoder;
+}
+
 TEST_F(DoubleCharEncoderTest, wikiTest) {
   DoubleCharEncoder *encoder = new DoubleCharEncoder();
   encoder->build(wikis, 65536);
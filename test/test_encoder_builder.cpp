@@ -0,0 +1,141 @@
+#include <assert.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "encoder_builder.hpp"
+#include "gtest/gtest.h"
+
+namespace hope {
+
+namespace encoderbuildertest {
+
+static const char kWordFilePath[] = "../../datasets/words.txt";
+static const char kUrlFilePath[] = "../../datasets/urls.txt";
+static const int kWordTestSize = 234369;
+static const int kUrlTestSize = 5000;
+static const int kSampleSize = 2000;
+static std::vector<std::string> words;
+static std::vector<std::string> urls;
+static const int kLongestCodeLen = 4096;
+
+class EncoderBuilderTest : public ::testing::Test {};
+
+int GetByteLen(const int bitlen) { return ((bitlen + 7) & ~7) / 8; }
+
+void CheckOrder(const Encoder *encoder, const std::vector<std::string> &keys) {
+  uint8_t *buffer = new uint8_t[kLongestCodeLen];
+  for (int i = 0; i < static_cast<int>(keys.size()) - 1; i++) {
+    int len1 = encoder->encode(keys[i], buffer);
+    std::string str1 = std::string((const char *)buffer, GetByteLen(len1));
+    int len2 = encoder->encode(keys[i + 1], buffer);
+    std::string str2 = std::string((const char *)buffer, GetByteLen(len2));
+    EXPECT_LT(str1.compare(str2), 0);
+  }
+  delete[] buffer;
+}
+
+// Single-Char and Double-Char count on every streamed key, so the
+// result must match building on the full key list
+void CheckSameAsFullBuild(const int encoder_type, const std::vector<std::string> &keys) {
+  EncoderBuilder builder(encoder_type, kSampleSize);
+  for (int i = 0; i < static_cast<int>(keys.size()); i++) {
+    builder.addKey(keys[i]);
+  }
+  EXPECT_EQ(static_cast<int64_t>(keys.size()), builder.numKeys());
+  EXPECT_TRUE(builder.sample().empty());
+  Encoder *stream_encoder = builder.build(65536);
+  ASSERT_TRUE(stream_encoder != nullptr);
+
+  Encoder *encoder = EncoderFactory::createEncoder(encoder_type);
+  encoder->build(keys, 65536);
+
+  uint8_t *buffer = new uint8_t[kLongestCodeLen];
+  uint8_t *stream_buffer = new uint8_t[kLongestCodeLen];
+  for (int i = 0; i < static_cast<int>(keys.size()); i++) {
+    int len = encoder->encode(keys[i], buffer);
+    int stream_len = stream_encoder->encode(keys[i], stream_buffer);
+    ASSERT_EQ(len, stream_len);
+    EXPECT_EQ(0, memcmp(buffer, stream_buffer, GetByteLen(len)));
+  }
+  delete[] buffer;
+  delete[] stream_buffer;
+  delete encoder;
+  delete stream_encoder;
+}
+
+TEST_F(EncoderBuilderTest, singleCharTest) {
+  CheckSameAsFullBuild(1, words);
+  CheckSameAsFullBuild(1, urls);
+}
+
+TEST_F(EncoderBuilderTest, doubleCharTest) {
+  CheckSameAsFullBuild(2, urls);
+}
+
+TEST_F(EncoderBuilderTest, ngramTest) {
+  for (int n = 3; n <= 4; n++) {
+    EncoderBuilder builder(n, kSampleSize);
+    for (int i = 0; i < static_cast<int>(words.size()); i++) {
+      builder.addKey(words[i]);
+    }
+    EXPECT_EQ(kSampleSize, static_cast<int>(builder.sample().size()));
+    Encoder *encoder = builder.build(10000);
+    ASSERT_TRUE(encoder != nullptr);
+    CheckOrder(encoder, words);
+    delete encoder;
+  }
+}
+
+TEST_F(EncoderBuilderTest, reservoirTest) {
+  EncoderBuilder builder(5, kSampleSize);
+  for (int i = 0; i < kSampleSize / 2; i++) {
+    builder.addKey(words[i]);
+  }
+  EXPECT_EQ(kSampleSize / 2, static_cast<int>(builder.sample().size()));
+  for (int i = kSampleSize / 2; i < static_cast<int>(words.size()); i++) {
+    builder.addKey(words[i]);
+  }
+  EXPECT_EQ(kSampleSize, static_cast<int>(builder.sample().size()));
+  // the reservoir must not be biased towards the first keys seen
+  int num_late_keys = 0;
+  for (const auto &key : builder.sample()) {
+    if (key.compare(words[kWordTestSize / 2]) > 0) num_late_keys++;
+  }
+  EXPECT_GT(num_late_keys, kSampleSize / 4);
+  EXPECT_LT(num_late_keys, kSampleSize * 3 / 4);
+}
+
+void LoadWords() {
+  std::ifstream infile(kWordFilePath);
+  std::string key;
+  int count = 0;
+  while (infile.good() && count < kWordTestSize) {
+    infile >> key;
+    words.push_back(key);
+    count++;
+  }
+}
+
+void LoadUrls() {
+  std::ifstream infile(kUrlFilePath);
+  std::string key;
+  int count = 0;
+  while (infile.good() && count < kUrlTestSize) {
+    infile >> key;
+    urls.push_back(key);
+    count++;
+  }
+}
+
+}  // namespace encoderbuildertest
+}  // namespace hope
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  hope::encoderbuildertest::LoadWords();
+  hope::encoderbuildertest::LoadUrls();
+  return RUN_ALL_TESTS();
+}
@@ -7,6 +7,7 @@
 #include <string>
 #include <vector>
 
+#include "encoder_test_util.hpp"
 #include "gtest/gtest.h"
 #include "ngram_encoder.hpp"
 
@@ -150,6 +151,21 @@ TEST_F(NGramEncoderTest, word4BatchTest) {
   }
 }
 
+TEST_F(NGramEncoderTest, word3SliceTest) {
+  NGramEncoder *encoder = new NGramEncoder(3);
+  NGramEncoder *slice_encoder = new NGramEncoder(3);
+  encodertestutil::CheckSliceEncoding(encoder, slice_encoder, words, 10000);
+  delete encoder;
+  delete slice_encoder;
+}
+
+TEST_F(NGramEncoderTest, word4EncodeIntoTest) {
+  NGramEncoder *encoder = new NGramEncoder(4);
+  encoder->build(words, 10000);
+  encodertestutil::CheckEncodeInto(encoder, words);
+  delete encoder;
+}
+
 TEST_F(NGramEncoderTest, wiki3Test) {
   NGramEncoder *encoder = new NGramEncoder(3);
   encoder->build(wikis, 10000);
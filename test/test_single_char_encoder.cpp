@@ -7,6 +7,7 @@
 #include <string>
 #include <vector>
 
+#include "encoder_test_util.hpp"
 #include "gtest/gtest.h"
 #include "single_char_encoder.hpp"
 #include "symbol_selector_factory.hpp"
@@ -102,6 +103,114 @@ TEST_F(SingleCharEncoderTest, wordBatchTest) {
   }
 }
 
+TEST_F(SingleCharEncoderTest, wordSliceTest) {
+  SingleCharEncoder *encoder = new SingleCharEncoder();
+  SingleCharEncoder *slice_encoder = new SingleCharEncoder();
+  encodertestutil::CheckSliceEncoding(encoder, slice_encoder, words, 1000);
+  delete encoder;
+  delete slice_encoder;
+}
+
+TEST_F(SingleCharEncoderTest, wordEncodeIntoTest) {
+  SingleCharEncoder *encoder = new SingleCharEncoder();
+  encoder->build(words, 1000);
+  encodertestutil::CheckEncodeInto(encoder, words);
+  delete encoder;
+}
+
+// Keys of kMinSimdKeyLen bytes or more take the gather kernel;
+// their shorter prefixes are encoded byte by byte
+TEST_F(SingleCharEncoderTest, urlLongKeyTest) {
+  SingleCharEncoder *encoder = new SingleCharEncoder();
+  encoder->build(urls, 1000);
+  uint8_t *buffer = new uint8_t[kLongestCodeLen];
+  uint8_t *prefix_buffer = new uint8_t[kLongestCodeLen];
+  for (int i = 0; i < static_cast<int>(urls.size()); i++) {
+    int len = encoder->encode(urls[i], buffer);
+    EXPECT_EQ(len, encoder->encodedBitLen(urls[i]));
+    for (int prefix_len = 1; prefix_len < 16 && prefix_len < static_cast<int>(urls[i].length()); prefix_len++) {
+      int bit_len = encoder->encode(urls[i].data(), prefix_len, prefix_buffer);
+      EXPECT_EQ(0, memcmp(buffer, prefix_buffer, bit_len / 8));
+    }
+  }
+
+  std::vector<std::string> enc_keys;
+  for (int i = 0; i < static_cast<int>(urls.size()); i += 5) {
+    encoder->encodeBatch(urls, i, 5, enc_keys);
+  }
+  ASSERT_EQ(urls.size(), enc_keys.size());
+  for (int i = 0; i < static_cast<int>(urls.size()); i++) {
+    int len = encoder->encode(urls[i], buffer);
+    EXPECT_EQ(0, enc_keys[i].compare(std::string((const char *)buffer, GetByteLen(len))));
+  }
+  delete[] buffer;
+  delete[] prefix_buffer;
+  delete encoder;
+}
+
+// Bit string of key built from the codes of its single bytes, which
+// are always encoded by the byte loop
+std::string ReferenceBits(const SingleCharEncoder *encoder, const std::string &key) {
+  uint8_t buffer[kLongestCodeLen];
+  std::string bits;
+  for (int i = 0; i < static_cast<int>(key.length()); i++) {
+    int len = encoder->encode(key.data() + i, 1, buffer);
+    for (int j = 0; j < len; j++) bits += ((buffer[j / 8] >> (7 - j % 8)) & 1) ? '1' : '0';
+  }
+  return bits;
+}
+
+std::string ToBits(const uint8_t *buffer, const int bit_len) {
+  std::string bits;
+  for (int j = 0; j < bit_len; j++) bits += ((buffer[j / 8] >> (7 - j % 8)) & 1) ? '1' : '0';
+  return bits;
+}
+
+// Full keys of every length from 0 to 300 bytes, over all byte values
+// (long codes make the gather kernel fall back per group); encode,
+// encodeInto and encodeBatch must match the byte-by-byte reference, and
+// encode must write whole words only
+TEST_F(SingleCharEncoderTest, simdMatchesScalarTest) {
+  SingleCharEncoder *encoder = new SingleCharEncoder();
+  encoder->build(words, 1000);
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int> byte_dist(0, 255);
+  std::uniform_int_distribution<int> letter_dist('a', 'z');
+  std::vector<std::string> keys;
+  for (int len = 0; len <= 300; len++) {
+    std::string random_key, letter_key;
+    for (int i = 0; i < len; i++) {
+      random_key += (char)byte_dist(gen);
+      letter_key += (char)letter_dist(gen);
+    }
+    keys.push_back(random_key);
+    keys.push_back(letter_key);
+  }
+  uint8_t *buffer = new uint8_t[kLongestCodeLen];
+  for (int i = 0; i < static_cast<int>(keys.size()); i++) {
+    std::string ref = ReferenceBits(encoder, keys[i]);
+    memset(buffer, 0xAB, kLongestCodeLen);
+    int len = encoder->encode(keys[i], buffer);
+    ASSERT_EQ(static_cast<int>(ref.length()), len);
+    ASSERT_EQ(ref, ToBits(buffer, len));
+    for (int j = (len / 64 + 1) * 8; j < (len / 64 + 2) * 8; j++) {
+      ASSERT_EQ(0xAB, buffer[j]);
+    }
+    ASSERT_EQ(len, encoder->encodeInto(keys[i], buffer, kLongestCodeLen));
+    ASSERT_EQ(ref, ToBits(buffer, len));
+  }
+  std::vector<std::string> enc_keys;
+  for (int i = 0; i < static_cast<int>(keys.size()); i += 2) {
+    encoder->encodeBatch(keys, i, 2, enc_keys);
+  }
+  for (int i = 0; i < static_cast<int>(keys.size()); i++) {
+    std::string ref = ReferenceBits(encoder, keys[i]);
+    EXPECT_EQ(ref, ToBits((const uint8_t *)enc_keys[i].data(), ref.length()));
+  }
+  delete[] buffer;
+  delete encoder;
+}
+
 TEST_F(SingleCharEncoderTest, wikiTest) {
   SingleCharEncoder *encoder = new SingleCharEncoder();
   encoder->build(wikis, 1000);
@@ -0,0 +1,140 @@
+#include <assert.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "string_btree.hpp"
+
+namespace hope {
+
+namespace stringbtreetest {
+
+static const char kWordFilePath[] = "../../datasets/words.txt";
+static const int kWordTestSize = 234369;
+static std::vector<std::string> words;
+
+typedef tlx::string_btree_map<uint64_t> btree_type;
+
+class StringBTreeTest : public ::testing::Test {};
+
+// Inserts keys (sorted and unique) in random order, then checks point
+// lookups, lower_bound and ordered iteration
+void checkKeys(const std::vector<std::string> &keys) {
+  std::vector<int> order;
+  for (int i = 0; i < (int)keys.size(); i++) order.push_back(i);
+  std::shuffle(order.begin(), order.end(), std::mt19937(0));
+
+  btree_type bt;
+  for (int i = 0; i < (int)order.size(); i++) {
+    ASSERT_TRUE(bt.insert2(keys[order[i]], order[i]).second);
+  }
+  ASSERT_FALSE(bt.insert2(keys[0], 0).second);
+  bt.verify();
+  ASSERT_EQ(keys.size(), bt.size());
+
+  for (int i = 0; i < (int)keys.size(); i++) {
+    btree_type::const_iterator iter = bt.find(keys[i]);
+    ASSERT_TRUE(iter != bt.end());
+    ASSERT_EQ(keys[i], iter.key());
+    ASSERT_EQ((uint64_t)i, iter.data());
+    bool next_present = std::binary_search(keys.begin(), keys.end(), keys[i] + '\0');
+    ASSERT_EQ(next_present, bt.find(keys[i] + '\0') != bt.end());
+
+    iter = bt.lower_bound(keys[i] + '\0');
+    if (i + 1 < (int)keys.size()) {
+      ASSERT_EQ(keys[i + 1], iter.key());
+    } else {
+      ASSERT_TRUE(iter == bt.end());
+    }
+  }
+
+  int i = 0;
+  for (btree_type::const_iterator iter = bt.begin(); iter != bt.end(); ++iter, i++) {
+    ASSERT_EQ(keys[i], iter.key());
+  }
+  ASSERT_EQ((int)keys.size(), i);
+}
+
+TEST_F(StringBTreeTest, wordTest) {
+  checkKeys(words);
+
+  btree_type bt;
+  for (int i = 0; i < (int)words.size(); i++) bt.insert2(words[i], i);
+  // one separator per leaf but the first; truncated separators are
+  // shorter than the keys on average
+  uint64_t key_bytes = 0;
+  for (int i = 0; i < (int)words.size(); i++) key_bytes += words[i].size();
+  double avg_key_len = (double)key_bytes / words.size();
+  double avg_separator_len = (double)bt.get_stats().separator_bytes / (bt.get_stats().leaves - 1);
+  EXPECT_LT(avg_separator_len, avg_key_len);
+  EXPECT_EQ(0u, bt.get_stats().overflow_bytes);
+}
+
+TEST_F(StringBTreeTest, longSeparatorTest) {
+  // long shared prefixes force separators out of line; mixing in short
+  // keys gives inner nodes uneven entry sizes
+  std::vector<std::string> keys;
+  for (int i = 0; i < 20000; i++) {
+    std::string key = std::to_string(i);
+    if (i % 3 != 0) key = std::string(40 + i % 200, 'a' + i % 7) + key;
+    keys.push_back(key);
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  checkKeys(keys);
+
+  btree_type bt;
+  for (int i = 0; i < (int)keys.size(); i++) bt.insert2(keys[i], i);
+  EXPECT_GT(bt.get_stats().overflow_bytes, 0u);
+}
+
+TEST_F(StringBTreeTest, prefixTieTest) {
+  // keys whose 8-byte leaf prefixes tie: trailing zero bytes, and long
+  // keys that only differ after the first 8 bytes
+  std::vector<std::string> keys;
+  for (int i = 0; i < 2000; i++) {
+    std::string key = std::to_string(i % 50);
+    key.append(i / 50 % 4, '\0');
+    if (i >= 200) key = std::string(8, 'x') + std::to_string(i);
+    keys.push_back(key);
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  checkKeys(keys);
+}
+
+TEST_F(StringBTreeTest, emptyTest) {
+  btree_type bt;
+  EXPECT_TRUE(bt.empty());
+  EXPECT_TRUE(bt.begin() == bt.end());
+  EXPECT_TRUE(bt.find("a") == bt.end());
+  EXPECT_TRUE(bt.lower_bound("a") == bt.end());
+  bt.verify();
+}
+
+void LoadWords() {
+  std::ifstream infile(kWordFilePath);
+  std::string key;
+  int count = 0;
+  while (infile.good() && count < kWordTestSize) {
+    infile >> key;
+    words.push_back(key);
+    count++;
+  }
+  std::sort(words.begin(), words.end());
+  words.erase(std::unique(words.begin(), words.end()), words.end());
+}
+
+}  // namespace stringbtreetest
+}  // namespace hope
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  hope::stringbtreetest::LoadWords();
+  return RUN_ALL_TESTS();
+}